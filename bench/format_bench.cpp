@@ -0,0 +1,201 @@
+// Compares the in-memory sample formats (SampleFormat) on a bank of distinct
+// stereo zones, one per key, so every voice streams through its own sample
+// and mix() is bound by memory traffic rather than by cache hits. Each format
+// runs in its own forked process, which builds the bank zone by zone (for
+// int16 the float source of a zone is freed as soon as it is converted) and
+// reports the sample storage and peak RSS, then times VoiceManager::mix on
+// one thread. voices_per_core is how many voices one core mixes in real time
+// at that rate. Prints JSON lines (or CSV with --csv).
+
+#include "SampleBank.h"
+#include "VoiceManager.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int kChannels = 2;
+constexpr int kBufferFrames = 256;
+constexpr int kMidiNotes = 128;
+
+struct Options {
+    bool csv = false;
+    int zones = kMidiNotes;
+    double seconds = 4.0;
+    std::vector<int> voiceCounts{16, 64, 128};
+    std::vector<mix::Interpolation> modes{mix::Interpolation::Linear, mix::Interpolation::Hermite,
+                                          mix::Interpolation::Sinc};
+};
+
+double maxRssMiB() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#endif
+}
+
+// Noise on the 16-bit grid, so both formats hold exactly the same signal.
+std::vector<float> makeZoneData(size_t frames, unsigned seed) {
+    std::vector<float> data(frames * kChannels);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(-8192, 8192);
+    for (auto& value : data) {
+        value = static_cast<float>(dist(rng)) / 32768.0f;
+    }
+    return data;
+}
+
+// Zone i covers key i (wrapping when there are fewer zones than keys) at its
+// root, so every voice plays at unit step.
+void runFormat(SampleFormat format, const Options& options) {
+    const double baseRss = maxRssMiB();
+    const size_t frames = static_cast<size_t>(options.seconds * kSampleRate);
+    std::vector<std::vector<float>> floatStorage;
+    std::vector<std::vector<int16_t>> compactStorage;
+    std::vector<SampleZone> zones;
+    for (int i = 0; i < options.zones; ++i) {
+        std::vector<float> data = makeZoneData(frames, static_cast<unsigned>(i + 1));
+        SampleBank single = SampleBank::fromSample(data.data(), frames, kChannels, kSampleRate, i % kMidiNotes);
+        if (format == SampleFormat::Int16Planar) {
+            single = compactBank(single, compactStorage);
+        } else {
+            floatStorage.push_back(std::move(data));
+        }
+        SampleZone zone = single.zones().front();
+        zone.lowKey = zone.highKey = zone.rootNote;
+        zones.push_back(zone);
+    }
+    const SampleBank bank = SampleBank::fromZones(std::move(zones));
+
+    size_t storageBytes = 0;
+    for (const auto& zone : floatStorage) {
+        storageBytes += zone.size() * sizeof(float);
+    }
+    for (const auto& zone : compactStorage) {
+        storageBytes += zone.size() * sizeof(int16_t);
+    }
+    const double sampleMiB = static_cast<double>(storageBytes) / (1024.0 * 1024.0);
+    const double peakRss = maxRssMiB();
+
+    std::vector<float> output(static_cast<size_t>(kBufferFrames) * 2);
+    const int calls = std::max(8, static_cast<int>(0.5 * options.seconds * kSampleRate) / kBufferFrames);
+    for (mix::Interpolation mode : options.modes) {
+        for (int voices : options.voiceCounts) {
+            VoiceManager manager(bank, kSampleRate, 2, voices);
+            manager.setInterpolation(mode);
+            for (int i = 0; i < voices; ++i) {
+                manager.noteOn(i % kMidiNotes);
+            }
+            manager.mix(output.data(), kBufferFrames);
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < calls; ++i) {
+                manager.mix(output.data(), kBufferFrames);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double voiceFrames = static_cast<double>(calls) * kBufferFrames * manager.activeVoiceCount();
+            const double nsPerVoiceFrame = voiceFrames > 0.0 ? seconds * 1e9 / voiceFrames : 0.0;
+            const double voicesPerCore = nsPerVoiceFrame > 0.0 ? 1e9 / (nsPerVoiceFrame * kSampleRate) : 0.0;
+
+            if (options.csv) {
+                std::cout << sampleFormatName(format) << ',' << mix::interpolationName(mode) << ',' << voices << ','
+                          << sampleMiB << ',' << baseRss << ',' << peakRss << ',' << nsPerVoiceFrame << ','
+                          << voicesPerCore << '\n';
+            } else {
+                std::cout << "{\"format\":\"" << sampleFormatName(format) << "\",\"interpolation\":\""
+                          << mix::interpolationName(mode) << "\",\"voices\":" << voices
+                          << ",\"sample_mib\":" << sampleMiB << ",\"base_rss_mib\":" << baseRss
+                          << ",\"peak_rss_mib\":" << peakRss << ",\"ns_per_voice_frame\":" << nsPerVoiceFrame
+                          << ",\"voices_per_core\":" << voicesPerCore << "}\n";
+            }
+        }
+    }
+    std::cout.flush();
+}
+
+bool measure(SampleFormat format, const Options& options) {
+    std::cout.flush();
+    const pid_t child = fork();
+    if (child == 0) {
+        runFormat(format, options);
+        _exit(0);
+    }
+    int status = 0;
+    if (child > 0) {
+        waitpid(child, &status, 0);
+    }
+    return child > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::vector<int> parseList(const char* text) {
+    std::vector<int> values;
+    for (const char* p = text; *p;) {
+        values.push_back(std::max(1, std::atoi(p)));
+        p = std::strchr(p, ',');
+        if (!p) {
+            break;
+        }
+        ++p;
+    }
+    return values;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " [--csv] [--zones N] [--seconds S] [--voices 16,64,128] [--interp M]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--csv") {
+            options.csv = true;
+        } else if (option == "--zones" && i + 1 < argc) {
+            options.zones = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--seconds" && i + 1 < argc) {
+            options.seconds = std::max(0.1, std::atof(argv[++i]));
+        } else if (option == "--voices" && i + 1 < argc) {
+            options.voiceCounts = parseList(argv[++i]);
+        } else if (option == "--interp" && i + 1 < argc) {
+            mix::Interpolation mode;
+            if (!mix::parseInterpolation(argv[++i], mode)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.modes = {mode};
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.csv) {
+        std::cout << "format,interpolation,voices,sample_mib,base_rss_mib,peak_rss_mib,ns_per_voice_frame,"
+                     "voices_per_core\n";
+    }
+    for (SampleFormat format : {SampleFormat::Float32, SampleFormat::Int16Planar}) {
+        if (!measure(format, options)) {
+            std::cerr << sampleFormatName(format) << ": målingen fejlede\n";
+            return 1;
+        }
+    }
+    return 0;
+}
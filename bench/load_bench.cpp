@@ -0,0 +1,221 @@
+// Times WAV loading and measures its peak memory, one forked process per
+// loader so every run starts from the same resident set. Loaders:
+//   mapped   - readWav: memory-mapped, one SIMD conversion pass
+//   buffered - whole data chunk read into a byte buffer, then converted
+//   sdl      - SDL_LoadWAV + SDL_ConvertAudio as wave_player used to (when built with SDL2)
+//   progressive - ProgressiveSample: playable after its first chunk, the rest
+//                 decoded in the background
+// `seconds` is the time to the fully loaded sample and `first_note_seconds`
+// the time until it can be played, which differ only for progressive.
+// Prints one JSON object per file and loader (or CSV with --csv).
+
+#include "ProgressiveSample.h"
+#include "WavFile.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(WAVE_LOAD_BENCH_SDL)
+#include <SDL.h>
+#endif
+
+namespace {
+
+struct Options {
+    bool csv = false;
+    int repeats = 3;
+    std::vector<std::string> files;
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadResult {
+    double seconds = 0.0;   // fastest of the repeats
+    double firstNoteSeconds = 0.0;
+    double baseRssMiB = 0.0; // before the first load
+    double peakRssMiB = 0.0;
+    size_t samples = 0;
+};
+
+double maxRssMiB() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);
+#else
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#endif
+}
+
+// Loaders set `playable` when the sample could start sounding, if before
+// they return.
+size_t loadMapped(const std::string& path, Clock::time_point&) {
+    return readWav(path).samples.size();
+}
+
+size_t loadBuffered(const std::string& path, Clock::time_point&) {
+    const WavFormat format = readWavFormat(path);
+    std::ifstream in(path, std::ios::binary);
+    const size_t sampleCount = format.frames() * static_cast<size_t>(format.channels);
+    std::vector<unsigned char> bytes(sampleCount * static_cast<size_t>(format.bytesPerSample));
+    in.seekg(static_cast<std::streamoff>(format.dataOffset));
+    if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+        throw std::runtime_error("Kunne ikke læse WAV data: " + path);
+    }
+    std::vector<float> samples(sampleCount);
+    decodeWavSamples(bytes.data(), sampleCount, format, samples.data());
+    return samples.size();
+}
+
+#if defined(WAVE_LOAD_BENCH_SDL)
+size_t loadSdl(const std::string& path, Clock::time_point&) {
+    SDL_AudioSpec spec;
+    Uint8* buffer = nullptr;
+    Uint32 length = 0;
+    if (!SDL_LoadWAV(path.c_str(), &spec, &buffer, &length)) {
+        throw std::runtime_error(std::string("Kunne ikke loade WAV fil: ") + SDL_GetError());
+    }
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_F32, spec.channels, spec.freq) < 0) {
+        SDL_FreeWAV(buffer);
+        throw std::runtime_error(std::string("Kunne ikke konvertere lydformat: ") + SDL_GetError());
+    }
+    cvt.len = static_cast<int>(length);
+    cvt.buf = static_cast<Uint8*>(SDL_malloc(static_cast<size_t>(cvt.len) * static_cast<size_t>(cvt.len_mult)));
+    std::copy(buffer, buffer + length, cvt.buf);
+    SDL_ConvertAudio(&cvt);
+    SDL_FreeWAV(buffer);
+    std::vector<float> samples(static_cast<size_t>(cvt.len_cvt) / sizeof(float));
+    std::memcpy(samples.data(), cvt.buf, static_cast<size_t>(cvt.len_cvt));
+    SDL_free(cvt.buf);
+    return samples.size();
+}
+#endif
+
+size_t loadProgressive(const std::string& path, Clock::time_point& playable) {
+    ProgressiveSample sample(path, 60);
+    playable = Clock::now();
+    return sample.waitForData().samples.size();
+}
+
+using Loader = size_t (*)(const std::string&, Clock::time_point&);
+
+struct Method {
+    const char* name;
+    Loader load;
+};
+
+// Runs the loader in a child process and reads the result back over a pipe.
+bool measure(const Method& method, const std::string& path, int repeats, LoadResult& result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    const pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        LoadResult local;
+        local.baseRssMiB = maxRssMiB();
+        local.seconds = 1e30;
+        local.firstNoteSeconds = 1e30;
+        try {
+            for (int i = 0; i < repeats; ++i) {
+                const auto start = Clock::now();
+                Clock::time_point playable;
+                local.samples = method.load(path, playable);
+                const auto end = Clock::now();
+                if (playable == Clock::time_point{}) {
+                    playable = end;
+                }
+                local.seconds = std::min(local.seconds, std::chrono::duration<double>(end - start).count());
+                local.firstNoteSeconds =
+                    std::min(local.firstNoteSeconds, std::chrono::duration<double>(playable - start).count());
+            }
+        } catch (const std::exception& e) {
+            std::cerr << method.name << ": " << e.what() << "\n";
+            _exit(1);
+        }
+        local.peakRssMiB = maxRssMiB();
+        const ssize_t written = write(fds[1], &local, sizeof(local));
+        _exit(written == static_cast<ssize_t>(sizeof(local)) ? 0 : 1);
+    }
+    close(fds[1]);
+    const ssize_t got = child > 0 ? read(fds[0], &result, sizeof(result)) : -1;
+    close(fds[0]);
+    int status = 0;
+    if (child > 0) {
+        waitpid(child, &status, 0);
+    }
+    return got == static_cast<ssize_t>(sizeof(result)) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " [--csv] [--repeats N] <fil.wav>...\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            options.csv = true;
+        } else if (std::strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            options.repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            options.files.push_back(argv[i]);
+        }
+    }
+    if (options.files.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Method> methods{
+        {"mapped", &loadMapped}, {"buffered", &loadBuffered}, {"progressive", &loadProgressive}};
+#if defined(WAVE_LOAD_BENCH_SDL)
+    methods.push_back({"sdl", &loadSdl});
+#endif
+
+    if (options.csv) {
+        std::cout << "file,loader,file_mib,seconds,first_note_seconds,mib_per_second,base_rss_mib,peak_rss_mib,decoded_mib\n";
+    }
+    for (const std::string& path : options.files) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        const double fileMiB = static_cast<double>(file.tellg()) / (1024.0 * 1024.0);
+        for (const Method& method : methods) {
+            LoadResult r;
+            if (!measure(method, path, options.repeats, r)) {
+                continue;
+            }
+            const double decodedMiB = static_cast<double>(r.samples * sizeof(float)) / (1024.0 * 1024.0);
+            const double throughput = r.seconds > 0.0 ? fileMiB / r.seconds : 0.0;
+            if (options.csv) {
+                std::cout << path << ',' << method.name << ',' << fileMiB << ',' << r.seconds << ',' << r.firstNoteSeconds << ',' << throughput
+                          << ',' << r.baseRssMiB << ',' << r.peakRssMiB << ',' << decodedMiB << '\n';
+            } else {
+                std::cout << "{\"file\":\"" << path << "\",\"loader\":\"" << method.name << "\",\"file_mib\":" << fileMiB
+                          << ",\"seconds\":" << r.seconds << ",\"first_note_seconds\":" << r.firstNoteSeconds
+                          << ",\"mib_per_second\":" << throughput
+                          << ",\"base_rss_mib\":" << r.baseRssMiB << ",\"peak_rss_mib\":" << r.peakRssMiB
+                          << ",\"decoded_mib\":" << decodedMiB << "}\n";
+            }
+        }
+    }
+    return 0;
+}
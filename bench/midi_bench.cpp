@@ -0,0 +1,274 @@
+// Loopback test for MidiInput. A producer thread writes note-on/off pairs
+// (after the first message all in running status) into a FIFO or a Unix
+// socket; the MIDI thread stamps them onto a VoiceManager exactly as
+// wave_player does, one buffer ahead of the frame playing when their bytes
+// arrived; and a paced thread stands in for the audio callback. The sample is
+// DC with a zero-length attack, so every onset is the first non-zero output
+// frame of its note. Reports the transport time (write to handler) and the
+// input-to-onset time (write to the moment the onset frame is due, taking
+// each block to play from its callback's start; device output latency comes
+// on top). Prints JSON lines (or CSV with --csv).
+
+#include "AudioClock.h"
+#include "MidiInput.h"
+#include "VoiceManager.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = AudioClock::Clock;
+
+constexpr int kNote = 60;
+constexpr auto kNoteLength = std::chrono::milliseconds(3);
+
+struct Options {
+    bool csv = false;
+    std::vector<std::string> transports{"fifo", "socket"};
+    int notes = 200;
+    int bufferFrames = 256;
+    int sampleRate = 48000;
+    double gapMs = 10.0; // between note-ons, plus up to 2 ms of random jitter
+};
+
+struct Result {
+    std::string transport;
+    int sent = 0;
+    int received = 0;
+    int onsets = 0;
+    std::vector<double> transportMicros;
+    std::vector<double> onsetMillis;
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+    return values[index];
+}
+
+double micros(Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Opens the producer end once the reader is listening.
+int openProducer(const std::string& transport, const std::string& path) {
+    if (transport == "fifo") {
+        return ::open(path.c_str(), O_WRONLY);
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+Result runTransport(const std::string& transport, const Options& options) {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / ("wave_midi_bench_" + std::to_string(::getpid()) + "." + transport))
+            .string();
+    std::filesystem::remove(path);
+    if (transport == "fifo" && ::mkfifo(path.c_str(), 0600) != 0) {
+        throw std::runtime_error("Kunne ikke oprette FIFO: " + path);
+    }
+
+    const std::vector<float> sample(static_cast<size_t>(options.sampleRate), 0.5f);
+    VoiceManager manager(sample, options.sampleRate, 1, 1, kNote, 4);
+    EnvelopeSettings envelope;
+    envelope.attackSeconds = 0.0;
+    envelope.releaseSeconds = 0.0;
+    manager.setEnvelope(envelope);
+
+    const size_t notes = static_cast<size_t>(options.notes);
+    std::vector<Clock::time_point> sent(notes);
+    std::vector<Clock::time_point> received(notes);
+    std::vector<Clock::time_point> onsets;
+    onsets.reserve(notes);
+    std::atomic<int> sentCount{0};
+    std::atomic<int> receivedCount{0};
+
+    AudioClock clock;
+    const uint64_t eventLatency = static_cast<uint64_t>(options.bufferFrames);
+    MidiInput input(path, [&](const MidiMessage& message, MidiInput::Clock::time_point time) {
+        uint64_t frame = clock.frameAt(time, options.sampleRate);
+        frame = frame == VoiceManager::kNow ? VoiceManager::kNow : frame + eventLatency;
+        if (message.isNoteOn()) {
+            const int index = receivedCount.load(std::memory_order_relaxed);
+            if (index < options.notes) {
+                received[static_cast<size_t>(index)] = time;
+                receivedCount.store(index + 1, std::memory_order_release);
+            }
+            manager.noteOn(message.data1, message.data2, frame);
+        } else if (message.isNoteOff()) {
+            manager.noteOff(message.data1, frame);
+        }
+    });
+
+    // Stand-in for the device callback: one buffer per period, on schedule.
+    std::atomic<bool> rendering{true};
+    std::thread audio([&] {
+        std::vector<float> output(static_cast<size_t>(options.bufferFrames));
+        const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(options.bufferFrames) / options.sampleRate));
+        bool sounding = false;
+        Clock::time_point next = Clock::now();
+        while (rendering.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_until(next);
+            const Clock::time_point start = Clock::now();
+            clock.publish(manager.renderedFrames(), start);
+            manager.mix(output.data(), options.bufferFrames);
+            for (int k = 0; k < options.bufferFrames; ++k) {
+                const bool nonZero = output[static_cast<size_t>(k)] != 0.0f;
+                if (nonZero && !sounding && onsets.size() < notes) {
+                    onsets.push_back(start + std::chrono::duration_cast<Clock::duration>(
+                                                 std::chrono::duration<double>(static_cast<double>(k) / options.sampleRate)));
+                }
+                sounding = nonZero;
+            }
+            next += period;
+        }
+    });
+
+    const int fd = openProducer(transport, path);
+    if (fd < 0) {
+        rendering = false;
+        audio.join();
+        throw std::runtime_error("Kunne ikke forbinde til " + path);
+    }
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> jitter(0.0, 2.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // let the clock start
+    for (size_t i = 0; i < notes; ++i) {
+        // Running status: only the first note-on carries its status byte.
+        const uint8_t on[3] = {0x90, kNote, 100};
+        const uint8_t* bytes = i == 0 ? on : on + 1;
+        const size_t count = i == 0 ? 3 : 2;
+        sent[i] = Clock::now();
+        if (::write(fd, bytes, count) != static_cast<ssize_t>(count)) {
+            break;
+        }
+        sentCount.store(static_cast<int>(i + 1), std::memory_order_relaxed);
+        std::this_thread::sleep_for(kNoteLength);
+        const uint8_t off[2] = {kNote, 0}; // note-on with velocity 0
+        if (::write(fd, off, sizeof(off)) != static_cast<ssize_t>(sizeof(off))) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(options.gapMs + jitter(rng)));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    rendering = false;
+    audio.join();
+    ::close(fd);
+    if (transport == "fifo") {
+        std::filesystem::remove(path);
+    }
+
+    Result result;
+    result.transport = transport;
+    result.sent = sentCount.load();
+    result.received = receivedCount.load(std::memory_order_acquire);
+    result.onsets = static_cast<int>(onsets.size());
+    const int matched = std::min({result.sent, result.received, result.onsets});
+    for (int i = 0; i < matched; ++i) {
+        const size_t n = static_cast<size_t>(i);
+        result.transportMicros.push_back(micros(received[n] - sent[n]));
+        result.onsetMillis.push_back(micros(onsets[n] - sent[n]) / 1000.0);
+    }
+    return result;
+}
+
+void printResult(const Result& result, const Options& options) {
+    const double bufferMs = 1000.0 * options.bufferFrames / options.sampleRate;
+    const double transport50 = percentile(result.transportMicros, 0.5);
+    const double transport99 = percentile(result.transportMicros, 0.99);
+    const double transportMax = percentile(result.transportMicros, 1.0);
+    const double onsetMin = percentile(result.onsetMillis, 0.0);
+    const double onset50 = percentile(result.onsetMillis, 0.5);
+    const double onset99 = percentile(result.onsetMillis, 0.99);
+    const double onsetMax = percentile(result.onsetMillis, 1.0);
+    if (options.csv) {
+        std::cout << result.transport << ',' << options.bufferFrames << ',' << bufferMs << ',' << result.sent << ','
+                  << result.received << ',' << result.onsets << ',' << transport50 << ',' << transport99 << ','
+                  << transportMax << ',' << onsetMin << ',' << onset50 << ',' << onset99 << ',' << onsetMax << '\n';
+    } else {
+        std::cout << "{\"transport\":\"" << result.transport << "\",\"buffer_frames\":" << options.bufferFrames
+                  << ",\"buffer_ms\":" << bufferMs << ",\"sent\":" << result.sent << ",\"received\":"
+                  << result.received << ",\"onsets\":" << result.onsets << ",\"transport_us_p50\":" << transport50
+                  << ",\"transport_us_p99\":" << transport99 << ",\"transport_us_max\":" << transportMax
+                  << ",\"onset_ms_min\":" << onsetMin << ",\"onset_ms_p50\":" << onset50
+                  << ",\"onset_ms_p99\":" << onset99 << ",\"onset_ms_max\":" << onsetMax << "}\n";
+    }
+    std::cout.flush();
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program
+              << " [--csv] [--transport fifo|socket] [--notes N] [--buffer F] [--rate R] [--gap-ms G]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--csv") {
+            options.csv = true;
+        } else if (option == "--transport" && i + 1 < argc) {
+            options.transports = {argv[++i]};
+            if (options.transports[0] != "fifo" && options.transports[0] != "socket") {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--notes" && i + 1 < argc) {
+            options.notes = std::max(1, std::atoi(argv[++i]));
+        } else if (option == "--buffer" && i + 1 < argc) {
+            options.bufferFrames = std::max(16, std::atoi(argv[++i]));
+        } else if (option == "--rate" && i + 1 < argc) {
+            options.sampleRate = std::max(8000, std::atoi(argv[++i]));
+        } else if (option == "--gap-ms" && i + 1 < argc) {
+            options.gapMs = std::max(0.0, std::atof(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.csv) {
+        std::cout << "transport,buffer_frames,buffer_ms,sent,received,onsets,transport_us_p50,transport_us_p99,"
+                     "transport_us_max,onset_ms_min,onset_ms_p50,onset_ms_p99,onset_ms_max\n";
+    }
+    try {
+        for (const std::string& transport : options.transports) {
+            printResult(runTransport(transport, options), options);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
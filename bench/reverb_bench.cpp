@@ -0,0 +1,259 @@
+// Convolution reverb cost against direct convolution for multi-second stereo
+// impulse responses (decaying noise). Methods:
+//   direct     - time-domain convolution, the reference
+//   uniform    - every partition at the head block on the calling thread
+//   nonuniform - head and body on the calling thread, tail partitions inline
+//   background - as nonuniform, tail on the Convolver's own thread; run
+//                paced like an audio callback
+// Reports the calling thread's load (CPU seconds per audio second), callback
+// times, late tail blocks and the largest deviation from direct convolution.
+// The direct reference covers --direct-seconds starting one response length
+// in, where every tap contributes, so the FFT runs last at least that long.
+// Prints JSON lines (or CSV with --csv).
+
+#include "Convolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr size_t kBufferFrames = 256;
+
+struct Options {
+    bool csv = false;
+    bool quick = false;
+    double seconds = 3.0;       // audio per FFT run, at least
+    double directSeconds = 0.1; // audio for the direct reference
+};
+
+struct Result {
+    const char* method = "";
+    double irSeconds = 0.0;
+    double audioSeconds = 0.0;
+    double load = 0.0;
+    double meanUs = 0.0;
+    double worstUs = 0.0;
+    uint64_t late = 0;
+    double maxErrorDb = 0.0;
+};
+
+ImpulseResponse makeImpulse(double seconds) {
+    ImpulseResponse impulse;
+    impulse.channels = 2;
+    const size_t frames = static_cast<size_t>(seconds * kSampleRate);
+    impulse.samples.resize(frames * 2);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    // Falls by 60 dB over the response.
+    const double decay = std::log(1000.0) / static_cast<double>(frames);
+    for (size_t frame = 0; frame < frames; ++frame) {
+        const float envelope = static_cast<float>(0.02 * std::exp(-decay * static_cast<double>(frame)));
+        impulse.samples[frame * 2] = dist(rng) * envelope;
+        impulse.samples[frame * 2 + 1] = dist(rng) * envelope;
+    }
+    return impulse;
+}
+
+std::vector<float> makeInput(size_t frames, uint32_t seed) {
+    std::vector<float> input(frames);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    for (float& value : input) {
+        value = dist(rng);
+    }
+    return input;
+}
+
+// Wet output frames [first, first + count) of a stereo response for the mono
+// sum, as Convolver computes it.
+void convolveDirect(const ImpulseResponse& impulse,
+                    const std::vector<float>& mono,
+                    size_t first,
+                    size_t count,
+                    std::vector<float>& wetLeft,
+                    std::vector<float>& wetRight) {
+    const size_t taps = impulse.frames();
+    wetLeft.assign(count, 0.0f);
+    wetRight.assign(count, 0.0f);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t n = first + i;
+        float sumLeft = 0.0f;
+        float sumRight = 0.0f;
+        for (size_t k = 0; k < std::min(taps, n + 1); ++k) {
+            sumLeft += impulse.samples[k * 2] * mono[n - k];
+            sumRight += impulse.samples[k * 2 + 1] * mono[n - k];
+        }
+        wetLeft[i] = sumLeft;
+        wetRight[i] = sumRight;
+    }
+}
+
+// Against the reference, which starts at frame `first` of `left` and `right`.
+double errorDb(const std::vector<float>& left,
+               const std::vector<float>& right,
+               size_t first,
+               const std::vector<float>& referenceLeft,
+               const std::vector<float>& referenceRight) {
+    double error = 0.0;
+    double peak = 0.0;
+    for (size_t i = 0; i < referenceLeft.size(); ++i) {
+        error = std::max({error,
+                          std::fabs(static_cast<double>(left[first + i]) - referenceLeft[i]),
+                          std::fabs(static_cast<double>(right[first + i]) - referenceRight[i])});
+        peak = std::max({peak, std::fabs(static_cast<double>(referenceLeft[i])),
+                         std::fabs(static_cast<double>(referenceRight[i]))});
+    }
+    return peak > 0.0 ? 20.0 * std::log10(std::max(error / peak, 1e-12)) : 0.0;
+}
+
+Result runConvolver(const char* method,
+                    const ImpulseResponse& impulse,
+                    const ReverbSettings& settings,
+                    bool paced,
+                    const std::vector<float>& left,
+                    const std::vector<float>& right,
+                    size_t referenceFirst,
+                    const std::vector<float>& referenceLeft,
+                    const std::vector<float>& referenceRight) {
+    const size_t frames = left.size();
+    const std::vector<float> silence(kBufferFrames, 0.0f);
+    std::vector<float> wetLeft(frames, 0.0f);
+    std::vector<float> wetRight(frames, 0.0f);
+    std::vector<float> bufferLeft(kBufferFrames);
+    std::vector<float> bufferRight(kBufferFrames);
+    Convolver convolver(impulse, settings);
+
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(kBufferFrames) / kSampleRate));
+    double busy = 0.0;
+    double worst = 0.0;
+    int calls = 0;
+    auto next = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset + kBufferFrames <= frames; offset += kBufferFrames) {
+        if (paced) {
+            std::this_thread::sleep_until(next);
+            next += period;
+        }
+        std::copy_n(left.begin() + static_cast<std::ptrdiff_t>(offset), kBufferFrames, bufferLeft.begin());
+        std::copy_n(right.begin() + static_cast<std::ptrdiff_t>(offset), kBufferFrames, bufferRight.begin());
+        const auto start = std::chrono::steady_clock::now();
+        convolver.process(bufferLeft.data(), bufferRight.data(), silence.data(), kBufferFrames);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        busy += seconds;
+        worst = std::max(worst, seconds);
+        ++calls;
+        for (size_t i = 0; i < kBufferFrames; ++i) {
+            wetLeft[offset + i] = bufferLeft[i] - left[offset + i];
+            wetRight[offset + i] = bufferRight[i] - right[offset + i];
+        }
+    }
+
+    Result result;
+    result.method = method;
+    result.irSeconds = static_cast<double>(impulse.frames()) / kSampleRate;
+    result.audioSeconds = static_cast<double>(calls) * kBufferFrames / kSampleRate;
+    result.load = busy / result.audioSeconds;
+    result.meanUs = 1.0e6 * busy / calls;
+    result.worstUs = 1.0e6 * worst;
+    result.late = convolver.lateBlocks();
+    result.maxErrorDb = errorDb(wetLeft, wetRight, referenceFirst, referenceLeft, referenceRight);
+    return result;
+}
+
+void printResult(const Result& r, const Options& options) {
+    if (options.csv) {
+        std::cout << r.irSeconds << ',' << r.method << ',' << r.audioSeconds << ',' << r.load << ',' << r.meanUs << ','
+                  << r.worstUs << ',' << r.late << ',' << r.maxErrorDb << '\n';
+    } else {
+        std::cout << "{\"ir_seconds\":" << r.irSeconds << ",\"method\":\"" << r.method
+                  << "\",\"audio_seconds\":" << r.audioSeconds << ",\"load\":" << r.load
+                  << ",\"mean_callback_us\":" << r.meanUs << ",\"worst_callback_us\":" << r.worstUs
+                  << ",\"late_blocks\":" << r.late << ",\"max_error_db\":" << r.maxErrorDb << "}\n";
+    }
+    std::cout.flush();
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " [--csv] [--quick] [--seconds S] [--direct-seconds S]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--csv") {
+            options.csv = true;
+        } else if (option == "--quick") {
+            options.quick = true;
+        } else if (option == "--seconds" && i + 1 < argc) {
+            options.seconds = std::max(0.5, std::atof(argv[++i]));
+        } else if (option == "--direct-seconds" && i + 1 < argc) {
+            options.directSeconds = std::max(0.01, std::atof(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    options.directSeconds = std::min(options.directSeconds, options.seconds);
+
+    if (options.csv) {
+        std::cout << "ir_seconds,method,audio_seconds,load,mean_callback_us,worst_callback_us,late_blocks,"
+                     "max_error_db\n";
+    }
+    const std::vector<double> lengths = options.quick ? std::vector<double>{1.0, 4.0}
+                                                      : std::vector<double>{1.0, 2.0, 4.0, 8.0};
+    const ReverbSettings defaults;
+    for (double irSeconds : lengths) {
+        const ImpulseResponse impulse = makeImpulse(irSeconds);
+        const size_t first = impulse.frames();
+        const size_t directFrames = static_cast<size_t>(options.directSeconds * kSampleRate);
+        const size_t frames = std::max(static_cast<size_t>(options.seconds * kSampleRate), first + directFrames);
+        const std::vector<float> left = makeInput(frames + kBufferFrames, 1);
+        const std::vector<float> right = makeInput(frames + kBufferFrames, 2);
+        std::vector<float> mono(left.size());
+        for (size_t i = 0; i < mono.size(); ++i) {
+            mono[i] = (left[i] + right[i]) * 0.5f * defaults.send;
+        }
+
+        std::vector<float> referenceLeft;
+        std::vector<float> referenceRight;
+        const auto start = std::chrono::steady_clock::now();
+        convolveDirect(impulse, mono, first, directFrames, referenceLeft, referenceRight);
+        Result direct;
+        direct.method = "direct";
+        direct.irSeconds = irSeconds;
+        direct.audioSeconds = static_cast<double>(directFrames) / kSampleRate;
+        direct.load =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / direct.audioSeconds;
+        direct.meanUs = direct.load * 1.0e6 * kBufferFrames / kSampleRate;
+        direct.worstUs = direct.meanUs;
+        direct.maxErrorDb = errorDb(referenceLeft, referenceRight, 0, referenceLeft, referenceRight);
+        printResult(direct, options);
+
+        auto run = [&](const char* method, const ReverbSettings& settings, bool paced) {
+            printResult(
+                runConvolver(method, impulse, settings, paced, left, right, first, referenceLeft, referenceRight),
+                options);
+        };
+        ReverbSettings uniform;
+        uniform.tailBlockFrames = 0;
+        run("uniform", uniform, false);
+        ReverbSettings inlineTail;
+        inlineTail.backgroundTail = false;
+        run("nonuniform", inlineTail, false);
+        run("background", defaults, true);
+    }
+    return 0;
+}
@@ -0,0 +1,222 @@
+// Quality and speed of load-time sample-rate conversion (resample()) for
+// common rate pairs, against SDL_ConvertAudio when built with SDL2. Quality
+// is measured on pure tones: the output is least-squares fitted to a sine at
+// the tone frequency, giving the passband gain and the SINAD (signal to noise
+// and distortion, in dB). Tones above the output Nyquist frequency report how
+// far their aliases are suppressed instead. Speed is the conversion time for
+// ten seconds of stereo noise. Prints JSON lines (or CSV with --csv).
+
+#include "Resampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(WAVE_SRC_BENCH_SDL)
+#include <SDL.h>
+#endif
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kToneSeconds = 2.0;
+constexpr double kSpeedSeconds = 10.0;
+
+struct Options {
+    bool csv = false;
+    bool quick = false;
+};
+
+struct RatePair {
+    int from;
+    int to;
+};
+
+using Converter = std::vector<float> (*)(const std::vector<float>& input, int channels, int from, int to, int threads);
+
+std::vector<float> convertNative(const std::vector<float>& input, int channels, int from, int to, int threads) {
+    ResampleOptions options;
+    options.threads = threads;
+    return resample(input.data(), input.size() / static_cast<size_t>(channels), channels, from, to, options);
+}
+
+#if defined(WAVE_SRC_BENCH_SDL)
+std::vector<float> convertSdl(const std::vector<float>& input, int channels, int from, int to, int) {
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, AUDIO_F32, static_cast<Uint8>(channels), from, AUDIO_F32, static_cast<Uint8>(channels), to) < 0) {
+        return {};
+    }
+    cvt.len = static_cast<int>(input.size() * sizeof(float));
+    std::vector<Uint8> buffer(static_cast<size_t>(cvt.len) * static_cast<size_t>(cvt.len_mult));
+    std::memcpy(buffer.data(), input.data(), static_cast<size_t>(cvt.len));
+    cvt.buf = buffer.data();
+    if (SDL_ConvertAudio(&cvt) < 0) {
+        return {};
+    }
+    std::vector<float> output(static_cast<size_t>(cvt.len_cvt) / sizeof(float));
+    std::memcpy(output.data(), buffer.data(), static_cast<size_t>(cvt.len_cvt));
+    return output;
+}
+#endif
+
+struct Converters {
+    const char* name;
+    Converter convert;
+};
+
+struct ToneResult {
+    double gainDb = 0.0;
+    double sinadDb = 0.0; // for tones below the output Nyquist
+    double residualDb = 0.0; // output level for tones above it
+};
+
+// Fits a * sin + b * cos at `frequency` to the middle half of `signal`.
+ToneResult measureTone(const std::vector<float>& signal, double frequency, int rate) {
+    const size_t begin = signal.size() / 4;
+    const size_t end = signal.size() * 3 / 4;
+    const double w = 2.0 * kPi * frequency / rate;
+    double ss = 0.0, cc = 0.0, sc = 0.0, sy = 0.0, cy = 0.0, yy = 0.0;
+    for (size_t n = begin; n < end; ++n) {
+        const double s = std::sin(w * static_cast<double>(n));
+        const double c = std::cos(w * static_cast<double>(n));
+        const double y = signal[n];
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        sy += s * y;
+        cy += c * y;
+        yy += y * y;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (sy * cc - cy * sc) / det;
+    const double b = (cy * ss - sy * sc) / det;
+    const double fitted = a * sy + b * cy; // energy explained by the sine
+    const double residual = std::max(yy - fitted, 1e-30);
+    const double count = static_cast<double>(end - begin);
+
+    ToneResult result;
+    result.gainDb = 20.0 * std::log10(std::max(std::hypot(a, b), 1e-15));
+    result.sinadDb = 10.0 * std::log10(std::max(fitted, 1e-30) / residual);
+    result.residualDb = 10.0 * std::log10(std::max(yy / count * 2.0, 1e-30)); // relative to a full-scale sine
+    return result;
+}
+
+std::vector<float> makeTone(double frequency, int rate) {
+    std::vector<float> tone(static_cast<size_t>(kToneSeconds * rate));
+    for (size_t n = 0; n < tone.size(); ++n) {
+        tone[n] = static_cast<float>(0.5 * std::sin(2.0 * kPi * frequency * static_cast<double>(n) / rate));
+    }
+    return tone;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " [--csv] [--quick]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            options.csv = true;
+        } else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Converters> converters{{"native", &convertNative}};
+#if defined(WAVE_SRC_BENCH_SDL)
+    converters.push_back({"sdl", &convertSdl});
+#endif
+    const std::vector<RatePair> pairs = options.quick ? std::vector<RatePair>{{44100, 48000}, {96000, 48000}}
+                                                      : std::vector<RatePair>{{44100, 48000},
+                                                                              {48000, 44100},
+                                                                              {96000, 48000},
+                                                                              {22050, 48000},
+                                                                              {48000, 96000},
+                                                                              {44100, 96000}};
+    // Tone frequencies as fractions of the lower Nyquist frequency; 1.2 lies
+    // above the output band when downsampling.
+    const std::vector<double> tones{0.05, 0.25, 0.5, 0.8, 0.9, 1.2};
+    const int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    if (options.csv) {
+        std::cout << "converter,from,to,tone_hz,gain_db,sinad_db,alias_db\n";
+    }
+    for (const RatePair& pair : pairs) {
+        const double nyquist = 0.5 * std::min(pair.from, pair.to);
+        for (const Converters& converter : converters) {
+            for (double fraction : tones) {
+                const double frequency = fraction * nyquist;
+                if (frequency >= 0.5 * pair.from) {
+                    continue;
+                }
+                const std::vector<float> output = converter.convert(makeTone(frequency, pair.from), 1, pair.from, pair.to, 0);
+                if (output.empty()) {
+                    continue;
+                }
+                const bool aliased = frequency >= 0.5 * pair.to;
+                const ToneResult r = measureTone(output, frequency, pair.to);
+                // Alias level relative to the 0.5-amplitude input tone.
+                const double aliasDb = r.residualDb + 6.0206;
+                if (options.csv) {
+                    std::cout << converter.name << ',' << pair.from << ',' << pair.to << ',' << frequency << ','
+                              << (aliased ? 0.0 : r.gainDb + 6.0206) << ',' << (aliased ? 0.0 : r.sinadDb) << ','
+                              << (aliased ? aliasDb : 0.0) << '\n';
+                } else if (aliased) {
+                    std::cout << "{\"converter\":\"" << converter.name << "\",\"from\":" << pair.from
+                              << ",\"to\":" << pair.to << ",\"tone_hz\":" << frequency << ",\"alias_db\":" << aliasDb
+                              << "}\n";
+                } else {
+                    std::cout << "{\"converter\":\"" << converter.name << "\",\"from\":" << pair.from
+                              << ",\"to\":" << pair.to << ",\"tone_hz\":" << frequency
+                              << ",\"gain_db\":" << r.gainDb + 6.0206 << ",\"sinad_db\":" << r.sinadDb << "}\n";
+                }
+            }
+        }
+    }
+
+    if (options.csv) {
+        std::cout << "\nconverter,from,to,threads,seconds,mframes_per_second\n";
+    }
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    for (const RatePair& pair : pairs) {
+        std::vector<float> input(static_cast<size_t>(kSpeedSeconds * pair.from) * 2);
+        for (float& value : input) {
+            value = noise(rng);
+        }
+        for (const Converters& converter : converters) {
+            std::vector<int> threadCounts{1};
+            if (converter.convert == &convertNative && maxThreads > 1) {
+                threadCounts.push_back(maxThreads);
+            }
+            for (int threads : threadCounts) {
+                const auto start = std::chrono::steady_clock::now();
+                const std::vector<float> output = converter.convert(input, 2, pair.from, pair.to, threads);
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                const double rate = kSpeedSeconds * pair.from / seconds / 1e6;
+                if (options.csv) {
+                    std::cout << converter.name << ',' << pair.from << ',' << pair.to << ',' << threads << ','
+                              << seconds << ',' << rate << '\n';
+                } else {
+                    std::cout << "{\"speed\":{\"converter\":\"" << converter.name << "\",\"from\":" << pair.from
+                              << ",\"to\":" << pair.to << ",\"threads\":" << threads << ",\"seconds\":" << seconds
+                              << ",\"mframes_per_second\":" << rate << "}}\n";
+                }
+            }
+        }
+    }
+    return 0;
+}
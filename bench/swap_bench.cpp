@@ -0,0 +1,245 @@
+// Hot-swaps samples into a playing VoiceManager. A paced thread stands in for
+// the audio callback while notes keep sounding across swaps, and a loader
+// thread builds and publishes a fresh 4 s stereo sample every 20 ms, the way
+// wave_player does on a reload. Each run is repeated without the loader for
+// comparison. Reports callback times against the
+// buffer period, late callbacks, and every allocation or free the audio
+// thread made inside mix(), which should be none. Prints JSON lines (or CSV
+// with --csv).
+
+#include "VoiceManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Set by the audio thread around mix(); the global operators below count
+// what happens while it is set.
+thread_local bool insideMix = false;
+std::atomic<uint64_t> audioAllocations{0};
+std::atomic<uint64_t> audioFrees{0};
+
+void* countedAllocation(void* memory) {
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    if (insideMix) {
+        audioAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return memory;
+}
+
+void countedFree(void* memory) noexcept {
+    if (memory && insideMix) {
+        audioFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::free(memory);
+}
+
+} // namespace
+
+// The array and nothrow forms forward to these. Over-aligned types take the
+// std::align_val_t overloads, which the library would otherwise serve
+// without going through operator new.
+void* operator new(std::size_t size) {
+    return countedAllocation(std::malloc(size == 0 ? 1 : size));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    const auto bytes = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment.
+    return countedAllocation(std::aligned_alloc(bytes, (std::max<std::size_t>(size, 1) + bytes - 1) / bytes * bytes));
+}
+
+void operator delete(void* memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    countedFree(memory);
+}
+
+namespace {
+
+constexpr int kBaseNote = 60;
+constexpr int kVoices = 64;
+
+struct Options {
+    bool csv = false;
+    double seconds = 5.0;
+    double swapMs = 20.0;
+    double sampleSeconds = 4.0;
+    int bufferFrames = 256;
+    int sampleRate = 48000;
+};
+
+struct Result {
+    bool swapping = false;
+    int callbacks = 0;
+    int late = 0;
+    int published = 0;
+    size_t heldBanks = 0; // superseded banks still held when the run ended
+    double meanUs = 0.0;
+    double p99Us = 0.0;
+    double worstUs = 0.0;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+};
+
+std::vector<float> makeSample(const Options& options, uint32_t seed) {
+    std::vector<float> data(static_cast<size_t>(options.sampleSeconds * options.sampleRate) * 2);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-0.25f, 0.25f);
+    for (auto& value : data) {
+        value = dist(rng);
+    }
+    return data;
+}
+
+Result run(const Options& options, bool swapping) {
+    const std::vector<float> first = makeSample(options, 1);
+    VoiceManager manager(first, options.sampleRate, 2, 2, kBaseNote, kVoices);
+    EnvelopeSettings envelope;
+    envelope.releaseSeconds = 1.0;
+    manager.setEnvelope(envelope);
+
+    Result result;
+    result.swapping = swapping;
+    audioAllocations = 0;
+    audioFrees = 0;
+
+    std::atomic<bool> running{true};
+    std::thread loader;
+    if (swapping) {
+        loader = std::thread([&] {
+            uint32_t seed = 2;
+            while (running.load(std::memory_order_relaxed)) {
+                manager.publishSample(makeSample(options, seed++), options.sampleRate, 2, kBaseNote);
+                ++result.published;
+                std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(options.swapMs));
+            }
+        });
+    }
+
+    // One note every 8 callbacks on a random key, each held for 40, so notes
+    // started on one bank keep sounding well after the next is published.
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> key(kBaseNote - 12, kBaseNote + 12);
+    std::vector<int> held(40, -1);
+    std::vector<float> output(static_cast<size_t>(options.bufferFrames) * 2);
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(options.bufferFrames) / options.sampleRate));
+    const int calls = static_cast<int>(options.seconds * options.sampleRate / options.bufferFrames);
+    std::vector<double> durations;
+    durations.reserve(static_cast<size_t>(calls));
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+        std::this_thread::sleep_until(next);
+        int& slot = held[static_cast<size_t>(i) % held.size()];
+        if (slot >= 0) {
+            manager.noteOff(slot);
+            slot = -1;
+        }
+        if (i % 8 == 0) {
+            slot = key(rng);
+            manager.noteOn(slot);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        insideMix = true;
+        manager.mix(output.data(), options.bufferFrames);
+        insideMix = false;
+        const auto end = std::chrono::steady_clock::now();
+        durations.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        // Late when the buffer was not ready by the time it was due to play.
+        if (end > next + period) {
+            ++result.late;
+        }
+        next += period;
+    }
+    running = false;
+    if (loader.joinable()) {
+        loader.join();
+    }
+    result.heldBanks = manager.reclaimBanks();
+
+    double total = 0.0;
+    for (double d : durations) {
+        total += d;
+    }
+    std::sort(durations.begin(), durations.end());
+    result.callbacks = calls;
+    result.meanUs = total / static_cast<double>(calls);
+    result.p99Us = durations[static_cast<size_t>(0.99 * static_cast<double>(durations.size() - 1))];
+    result.worstUs = durations.back();
+    result.allocations = audioAllocations.load();
+    result.frees = audioFrees.load();
+    return result;
+}
+
+void printResult(const Result& r, const Options& options) {
+    const double periodUs = 1.0e6 * options.bufferFrames / options.sampleRate;
+    if (options.csv) {
+        std::cout << (r.swapping ? "swap" : "steady") << ',' << options.bufferFrames << ',' << periodUs << ','
+                  << r.callbacks << ',' << r.published << ',' << r.heldBanks << ',' << r.meanUs << ',' << r.p99Us
+                  << ',' << r.worstUs << ',' << r.late << ',' << r.allocations << ',' << r.frees << '\n';
+    } else {
+        std::cout << "{\"run\":\"" << (r.swapping ? "swap" : "steady") << "\",\"buffer_frames\":"
+                  << options.bufferFrames << ",\"period_us\":" << periodUs << ",\"callbacks\":" << r.callbacks
+                  << ",\"published\":" << r.published << ",\"held_banks\":" << r.heldBanks
+                  << ",\"mean_callback_us\":" << r.meanUs << ",\"p99_callback_us\":" << r.p99Us
+                  << ",\"worst_callback_us\":" << r.worstUs << ",\"late_callbacks\":" << r.late
+                  << ",\"audio_allocations\":" << r.allocations << ",\"audio_frees\":" << r.frees << "}\n";
+    }
+    std::cout.flush();
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " [--csv] [--seconds S] [--swap-ms M] [--buffer F]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--csv") {
+            options.csv = true;
+        } else if (option == "--seconds" && i + 1 < argc) {
+            options.seconds = std::max(0.1, std::atof(argv[++i]));
+        } else if (option == "--swap-ms" && i + 1 < argc) {
+            options.swapMs = std::max(0.0, std::atof(argv[++i]));
+        } else if (option == "--buffer" && i + 1 < argc) {
+            options.bufferFrames = std::max(16, std::atoi(argv[++i]));
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.csv) {
+        std::cout << "run,buffer_frames,period_us,callbacks,published,held_banks,mean_callback_us,p99_callback_us,"
+                     "worst_callback_us,late_callbacks,audio_allocations,audio_frees\n";
+    }
+    printResult(run(options, false), options);
+    printResult(run(options, true), options);
+    return 0;
+}
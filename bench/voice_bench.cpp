@@ -0,0 +1,526 @@
+// Sweeps VoiceManager::mix over interpolation mode, phase format, polyphony,
+// buffer size, input channel count and pitch ratio, and prints one JSON object per case (or CSV with --csv) so runs
+// can be diffed by scripts. Timings are per mix() call, i.e. per device callback.
+// With several voices the notes are spread one semitone apart around the
+// requested transposition (shifted to stay inside the MIDI range), so
+// pitch_ratio is the nominal centre ratio. A second section measures the cost
+// of note events against a fully occupied voice pool; --scaling instead times
+// multi-threaded rendering from 1 to N threads at small buffer sizes,
+// --pedal a dense sustain-pedal workload with voice virtualization off and on,
+// and --pitch-cache repeated notes against a sweep of pitch cache budgets.
+
+#include "VoiceManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int kBaseNote = 60;
+constexpr double kSampleSeconds = 12.0;
+constexpr int kMidiNotes = 128;
+constexpr double kPi = 3.14159265358979323846;
+
+struct Options {
+    bool csv = false;
+    bool quick = false;
+    bool scaling = false;
+    bool pedal = false;
+    bool pitchCache = false;
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<mix::Interpolation> modes{mix::Interpolation::Linear, mix::Interpolation::Hermite,
+                                          mix::Interpolation::Sinc};
+    std::vector<mix::PhaseFormat> phases{mix::PhaseFormat::Double, mix::PhaseFormat::Fixed};
+    int measureFrames = kSampleRate; // audio rendered per case after warm-up
+};
+
+struct CaseResult {
+    mix::Interpolation mode = mix::Interpolation::Linear;
+    mix::PhaseFormat phase = mix::PhaseFormat::Double;
+    int threads = 1;
+    int voices = 0;
+    int bufferFrames = 0;
+    int inputChannels = 0;
+    int semitones = 0;
+    double nsPerFrameVoice = 0.0;
+    double meanCallbackUs = 0.0;
+    double p99CallbackUs = 0.0;
+    double worstCallbackUs = 0.0;
+    double budgetUs = 0.0;
+};
+
+std::vector<float> makeNoise(int channels, double seconds = kSampleSeconds) {
+    std::vector<float> data(static_cast<size_t>(seconds * kSampleRate) * static_cast<size_t>(channels));
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-0.25f, 0.25f);
+    for (auto& value : data) {
+        value = dist(rng);
+    }
+    return data;
+}
+
+// Band-limited stand-in for a pitched instrument: eight harmonics of 220 Hz,
+// slightly detuned per channel. On noise, error figures would mostly measure
+// how differently the interpolators alias.
+std::vector<float> makeTone(int channels, double seconds) {
+    const size_t frames = static_cast<size_t>(seconds * kSampleRate);
+    std::vector<float> data(frames * static_cast<size_t>(channels));
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (int channel = 0; channel < channels; ++channel) {
+            const double phase = 2.0 * kPi * (220.0 + channel) * static_cast<double>(frame) / kSampleRate;
+            double value = 0.0;
+            for (int harmonic = 1; harmonic <= 8; ++harmonic) {
+                value += std::sin(harmonic * phase) / harmonic;
+            }
+            data[frame * static_cast<size_t>(channels) + static_cast<size_t>(channel)] = static_cast<float>(0.2 * value);
+        }
+    }
+    return data;
+}
+
+CaseResult runCase(const std::vector<float>& sample,
+                   mix::Interpolation mode,
+                   mix::PhaseFormat phase,
+                   int inputChannels,
+                   int voices,
+                   int bufferFrames,
+                   int semitones,
+                   const Options& options,
+                   int threads = 1) {
+    VoiceManager manager(sample, kSampleRate, inputChannels, 2, kBaseNote, voices, threads);
+    manager.setInterpolation(mode);
+    manager.setPhaseFormat(phase);
+
+    // Distinct notes centred on the requested transposition; re-triggering
+    // one note would release the previous voice.
+    const int lowestNote = std::clamp(kBaseNote + semitones - voices / 2, 0, kMidiNotes - voices);
+    for (int i = 0; i < voices; ++i) {
+        manager.noteOn(lowestNote + i);
+    }
+
+    std::vector<float> output(static_cast<size_t>(bufferFrames) * 2);
+    const int warmupCalls = std::max(1, kSampleRate / 20 / bufferFrames);
+    for (int i = 0; i < warmupCalls; ++i) {
+        manager.mix(output.data(), bufferFrames);
+    }
+
+    const int calls = std::max(8, options.measureFrames / bufferFrames);
+    std::vector<double> durations;
+    durations.reserve(static_cast<size_t>(calls));
+    for (int i = 0; i < calls; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        manager.mix(output.data(), bufferFrames);
+        const auto end = std::chrono::steady_clock::now();
+        durations.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    double total = 0.0;
+    for (double d : durations) {
+        total += d;
+    }
+    std::sort(durations.begin(), durations.end());
+
+    CaseResult result;
+    result.mode = mode;
+    result.phase = phase;
+    result.threads = threads;
+    result.voices = voices;
+    result.bufferFrames = bufferFrames;
+    result.inputChannels = inputChannels;
+    result.semitones = semitones;
+    result.nsPerFrameVoice =
+        total * 1000.0 / (static_cast<double>(calls) * static_cast<double>(bufferFrames) * static_cast<double>(voices));
+    result.meanCallbackUs = total / static_cast<double>(calls);
+    result.p99CallbackUs = durations[static_cast<size_t>(0.99 * static_cast<double>(durations.size() - 1))];
+    result.worstCallbackUs = durations.back();
+    result.budgetUs = 1.0e6 * static_cast<double>(bufferFrames) / static_cast<double>(kSampleRate);
+    return result;
+}
+
+void printResult(const CaseResult& r, const Options& options) {
+    if (options.csv) {
+        std::cout << mix::interpolationName(r.mode) << ',' << mix::phaseFormatName(r.phase) << ',' << r.voices << ',' << r.bufferFrames << ',' << r.inputChannels << ',' << r.semitones << ','
+                  << r.nsPerFrameVoice << ',' << r.meanCallbackUs << ',' << r.p99CallbackUs << ','
+                  << r.worstCallbackUs << ',' << r.budgetUs << '\n';
+        return;
+    }
+    std::cout << "{\"interpolation\":\"" << mix::interpolationName(r.mode) << "\",\"phase\":\""
+              << mix::phaseFormatName(r.phase) << "\",\"voices\":" << r.voices << ",\"buffer_frames\":" << r.bufferFrames
+              << ",\"input_channels\":" << r.inputChannels << ",\"semitones\":" << r.semitones
+              << ",\"pitch_ratio\":" << std::pow(2.0, r.semitones / 12.0)
+              << ",\"ns_per_frame_voice\":" << r.nsPerFrameVoice << ",\"mean_callback_us\":" << r.meanCallbackUs
+              << ",\"p99_callback_us\":" << r.p99CallbackUs << ",\"worst_callback_us\":" << r.worstCallbackUs
+              << ",\"budget_us\":" << r.budgetUs << "}\n";
+}
+
+// Note-on/off pairs applied by mix(…, 0) to a pool whose voices are all
+// sounding, so every note-on steals. Returns nanoseconds per event.
+double measureEventCost(const std::vector<float>& sample, int voices) {
+    constexpr int kEventsPerCall = 512; // half the command queue
+    VoiceManager manager(sample, kSampleRate, 1, 2, kBaseNote, voices);
+    std::vector<float> output(2);
+
+    for (int i = 0; i < voices; i += kEventsPerCall / 2) {
+        for (int k = i; k < std::min(voices, i + kEventsPerCall / 2); ++k) {
+            manager.noteOn(k % kMidiNotes);
+            manager.noteOff(k % kMidiNotes);
+        }
+        manager.mix(output.data(), 0);
+    }
+
+    constexpr int kCalls = 200;
+    double totalNs = 0.0;
+    int note = 0;
+    for (int call = 0; call < kCalls; ++call) {
+        for (int k = 0; k < kEventsPerCall / 2; ++k) {
+            manager.noteOn(note);
+            manager.noteOff(note);
+            note = (note + 7) % kMidiNotes;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        manager.mix(output.data(), 0);
+        const auto end = std::chrono::steady_clock::now();
+        totalNs += std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    return totalNs / (static_cast<double>(kCalls) * kEventsPerCall);
+}
+
+void runScaling(const Options& options) {
+    constexpr int kScalingVoices = 128;
+    const std::vector<int> bufferSizes = options.quick ? std::vector<int>{64} : std::vector<int>{32, 64, 128, 256};
+    const std::vector<float> sample = makeNoise(2);
+
+    if (options.csv) {
+        std::cout << "interpolation,threads,voices,buffer_frames,mean_callback_us,p99_callback_us,worst_callback_us,"
+                     "budget_us,speedup\n";
+    }
+    for (mix::Interpolation mode : options.modes) {
+        for (int bufferFrames : bufferSizes) {
+            double singleThreadUs = 0.0;
+            for (int threads = 1; threads <= options.maxThreads; ++threads) {
+                const CaseResult r = runCase(
+                    sample, mode, options.phases.front(), 2, kScalingVoices, bufferFrames, 0, options, threads);
+                if (threads == 1) {
+                    singleThreadUs = r.meanCallbackUs;
+                }
+                const double speedup = singleThreadUs / r.meanCallbackUs;
+                if (options.csv) {
+                    std::cout << mix::interpolationName(mode) << ',' << threads << ',' << r.voices << ','
+                              << r.bufferFrames << ',' << r.meanCallbackUs << ',' << r.p99CallbackUs << ','
+                              << r.worstCallbackUs << ',' << r.budgetUs << ',' << speedup << '\n';
+                } else {
+                    std::cout << "{\"interpolation\":\"" << mix::interpolationName(mode) << "\",\"threads\":" << threads
+                              << ",\"voices\":" << r.voices << ",\"buffer_frames\":" << r.bufferFrames
+                              << ",\"mean_callback_us\":" << r.meanCallbackUs
+                              << ",\"p99_callback_us\":" << r.p99CallbackUs
+                              << ",\"worst_callback_us\":" << r.worstCallbackUs << ",\"budget_us\":" << r.budgetUs
+                              << ",\"speedup\":" << speedup << "}\n";
+                }
+            }
+        }
+    }
+}
+
+struct PedalRun {
+    double meanCallbackUs = 0.0;
+    double meanActive = 0.0;
+    double meanVirtual = 0.0;
+    std::vector<float> output;
+};
+
+// Sustain-pedal style playing: a note every 40 ms on random keys over two
+// octaves, each released after 150 ms into a 20 s exponential release, so
+// most of the pool is ringing out at any time.
+PedalRun runPedalCase(const std::vector<float>& sample, mix::Interpolation mode, bool virtualize, int seconds) {
+    constexpr int kPedalVoices = 1024;
+    constexpr int kBufferFrames = 256;
+    constexpr uint64_t kNoteSpacing = kSampleRate / 25;
+    constexpr uint64_t kHoldFrames = kSampleRate * 3 / 20;
+
+    VoiceManager manager(sample, kSampleRate, 1, 2, kBaseNote, kPedalVoices);
+    manager.setInterpolation(mode);
+    EnvelopeSettings envelope;
+    envelope.attackSeconds = 0.005;
+    envelope.releaseSeconds = 20.0;
+    envelope.curve = EnvelopeCurve::Exponential;
+    manager.setEnvelope(envelope);
+    VirtualizationSettings virtualization;
+    virtualization.enabled = virtualize;
+    manager.setVirtualization(virtualization);
+
+    std::mt19937 rng(99);
+    std::uniform_int_distribution<int> key(kBaseNote - 12, kBaseNote + 12);
+    std::uniform_int_distribution<int> velocity(40, 127);
+    const uint64_t totalFrames = static_cast<uint64_t>(seconds) * kSampleRate;
+    PedalRun run;
+    run.output.resize(static_cast<size_t>(totalFrames) * 2);
+    uint64_t nextNote = 0;
+    double busyUs = 0.0;
+    double active = 0.0;
+    double virtualVoices = 0.0;
+    int calls = 0;
+    for (uint64_t frame = 0; frame + kBufferFrames <= totalFrames; frame += kBufferFrames) {
+        for (; nextNote < frame + kBufferFrames; nextNote += kNoteSpacing) {
+            const int note = key(rng);
+            manager.noteOn(note, velocity(rng), nextNote);
+            manager.noteOff(note, nextNote + kHoldFrames);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        manager.mix(run.output.data() + frame * 2, kBufferFrames);
+        const auto end = std::chrono::steady_clock::now();
+        busyUs += std::chrono::duration<double, std::micro>(end - start).count();
+        active += manager.activeVoiceCount();
+        virtualVoices += manager.virtualVoiceCount();
+        ++calls;
+    }
+    run.meanCallbackUs = busyUs / calls;
+    run.meanActive = active / calls;
+    run.meanVirtual = virtualVoices / calls;
+    return run;
+}
+
+void runPedal(const Options& options) {
+    const int seconds = options.quick ? 30 : 60;
+    const std::vector<float> sample = makeNoise(1, 45.0);
+    if (options.csv) {
+        std::cout << "interpolation,mean_active,mean_virtual,callback_us_off,callback_us_on,cpu_saved,"
+                     "max_error_db\n";
+    }
+    for (mix::Interpolation mode : options.modes) {
+        const PedalRun off = runPedalCase(sample, mode, false, seconds);
+        const PedalRun on = runPedalCase(sample, mode, true, seconds);
+        float peak = 0.0f;
+        float error = 0.0f;
+        for (size_t i = 0; i < off.output.size(); ++i) {
+            peak = std::max(peak, std::abs(off.output[i]));
+            error = std::max(error, std::abs(off.output[i] - on.output[i]));
+        }
+        // Difference relative to the loudest output sample.
+        const double errorDb = error > 0.0f ? 20.0 * std::log10(error / peak) : -std::numeric_limits<double>::infinity();
+        const double saved = 1.0 - on.meanCallbackUs / off.meanCallbackUs;
+        if (options.csv) {
+            std::cout << mix::interpolationName(mode) << ',' << on.meanActive << ',' << on.meanVirtual << ','
+                      << off.meanCallbackUs << ',' << on.meanCallbackUs << ',' << saved << ',' << errorDb << '\n';
+        } else {
+            std::cout << "{\"pedal\":{\"interpolation\":\"" << mix::interpolationName(mode)
+                      << "\",\"mean_active\":" << on.meanActive << ",\"mean_virtual\":" << on.meanVirtual
+                      << ",\"callback_us_off\":" << off.meanCallbackUs << ",\"callback_us_on\":" << on.meanCallbackUs
+                      << ",\"cpu_saved\":" << saved << ",\"max_error_db\":" << errorDb << "}}\n";
+        }
+    }
+}
+
+struct PitchCacheRun {
+    double meanCallbackUs = 0.0;
+    PitchCache::Stats stats;
+    std::vector<float> output;
+};
+
+// Two octaves of repeated notes on a stereo sample: one every 20 ms, held for
+// 400 ms. Paced in real time, because the cache fills from a background
+// thread while the callbacks run; only time inside mix() counts.
+PitchCacheRun runPitchCacheCase(const std::vector<float>& sample,
+                                mix::Interpolation mode,
+                                size_t budgetBytes,
+                                int seconds) {
+    constexpr int kBufferFrames = 256;
+    constexpr uint64_t kNoteSpacing = kSampleRate / 50;
+    constexpr uint64_t kHoldFrames = kSampleRate * 2 / 5;
+
+    VoiceManager manager(sample, kSampleRate, 2, 2, kBaseNote, 64);
+    manager.setInterpolation(mode);
+    EnvelopeSettings envelope;
+    envelope.releaseSeconds = 0.2;
+    manager.setEnvelope(envelope);
+    PitchCacheSettings settings;
+    settings.budgetBytes = budgetBytes;
+    manager.setPitchCache(settings);
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> key(kBaseNote - 12, kBaseNote + 12);
+    const uint64_t totalFrames = static_cast<uint64_t>(seconds) * kSampleRate;
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(kBufferFrames) / kSampleRate));
+    PitchCacheRun run;
+    run.output.resize(static_cast<size_t>(totalFrames) * 2);
+    uint64_t nextNote = 0;
+    double busyUs = 0.0;
+    int calls = 0;
+    auto next = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame + kBufferFrames <= totalFrames; frame += kBufferFrames) {
+        std::this_thread::sleep_until(next);
+        next += period;
+        for (; nextNote < frame + kBufferFrames; nextNote += kNoteSpacing) {
+            const int note = key(rng);
+            manager.noteOn(note, 127, nextNote);
+            manager.noteOff(note, nextNote + kHoldFrames);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        manager.mix(run.output.data() + frame * 2, kBufferFrames);
+        busyUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        ++calls;
+    }
+    run.meanCallbackUs = busyUs / calls;
+    run.stats = manager.pitchCacheStats();
+    return run;
+}
+
+void runPitchCache(const Options& options) {
+    const int seconds = options.quick ? 5 : 10;
+    const std::vector<float> sample = makeTone(2, 4.0);
+    // 25 keys of this sample take about 40 MB in all.
+    const std::vector<size_t> budgetsMb{4, 16, 64};
+    if (options.csv) {
+        std::cout << "interpolation,budget_mb,hit_rate,renders,evictions,cache_mb,callback_us_off,callback_us_on,"
+                     "speedup,max_error_db\n";
+    }
+    for (mix::Interpolation mode : options.modes) {
+        const PitchCacheRun off = runPitchCacheCase(sample, mode, 0, seconds);
+        float peak = 0.0f;
+        for (float value : off.output) {
+            peak = std::max(peak, std::abs(value));
+        }
+        for (size_t budgetMb : budgetsMb) {
+            const PitchCacheRun on = runPitchCacheCase(sample, mode, budgetMb << 20, seconds);
+            float error = 0.0f;
+            for (size_t i = 0; i < off.output.size(); ++i) {
+                error = std::max(error, std::abs(off.output[i] - on.output[i]));
+            }
+            // Against interpolated playback, relative to the loudest output sample.
+            const double errorDb =
+                error > 0.0f ? 20.0 * std::log10(error / peak) : -std::numeric_limits<double>::infinity();
+            const uint64_t noteOns = on.stats.hits + on.stats.misses;
+            const double hitRate = noteOns > 0 ? static_cast<double>(on.stats.hits) / static_cast<double>(noteOns) : 0.0;
+            const double cacheMb = static_cast<double>(on.stats.bytes) / (1024.0 * 1024.0);
+            const double speedup = off.meanCallbackUs / on.meanCallbackUs;
+            if (options.csv) {
+                std::cout << mix::interpolationName(mode) << ',' << budgetMb << ',' << hitRate << ','
+                          << on.stats.renders << ',' << on.stats.evictions << ',' << cacheMb << ','
+                          << off.meanCallbackUs << ',' << on.meanCallbackUs << ',' << speedup << ',' << errorDb
+                          << '\n';
+            } else {
+                std::cout << "{\"pitch_cache\":{\"interpolation\":\"" << mix::interpolationName(mode)
+                          << "\",\"budget_mb\":" << budgetMb << ",\"hit_rate\":" << hitRate
+                          << ",\"renders\":" << on.stats.renders << ",\"evictions\":" << on.stats.evictions
+                          << ",\"cache_mb\":" << cacheMb << ",\"callback_us_off\":" << off.meanCallbackUs
+                          << ",\"callback_us_on\":" << on.meanCallbackUs << ",\"speedup\":" << speedup
+                          << ",\"max_error_db\":" << errorDb << "}}\n";
+            }
+            std::cout.flush();
+        }
+    }
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program
+              << " [--csv] [--quick] [--frames N] [--interp linear|hermite|sinc] [--phase double|fixed]"
+                 " [--scaling [--max-threads N]] [--pedal] [--pitch-cache]\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0) {
+            options.csv = true;
+        } else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.measureFrames = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--scaling") == 0) {
+            options.scaling = true;
+        } else if (std::strcmp(argv[i], "--pedal") == 0) {
+            options.pedal = true;
+        } else if (std::strcmp(argv[i], "--pitch-cache") == 0) {
+            options.pitchCache = true;
+        } else if (std::strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            options.maxThreads = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--interp") == 0 && i + 1 < argc) {
+            mix::Interpolation mode;
+            if (!mix::parseInterpolation(argv[++i], mode)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.modes = {mode};
+        } else if (std::strcmp(argv[i], "--phase") == 0 && i + 1 < argc) {
+            mix::PhaseFormat phase;
+            if (!mix::parsePhaseFormat(argv[++i], phase)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            options.phases = {phase};
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.scaling) {
+        runScaling(options);
+        return 0;
+    }
+    if (options.pedal) {
+        runPedal(options);
+        return 0;
+    }
+    if (options.pitchCache) {
+        runPitchCache(options);
+        return 0;
+    }
+
+    const std::vector<int> polyphony =
+        options.quick ? std::vector<int>{1, 32, 128} : std::vector<int>{1, 2, 4, 8, 16, 32, 64, 128};
+    const std::vector<int> bufferSizes =
+        options.quick ? std::vector<int>{64, 1024} : std::vector<int>{32, 64, 128, 256, 512, 1024, 2048, 4096};
+    const std::vector<int> transpositions =
+        options.quick ? std::vector<int>{-24, 0, 24} : std::vector<int>{-36, -24, -12, 0, 12, 24, 36};
+
+    if (options.csv) {
+        std::cout << "interpolation,phase,voices,buffer_frames,input_channels,semitones,ns_per_frame_voice,mean_callback_us,"
+                     "p99_callback_us,worst_callback_us,budget_us\n";
+    }
+
+    for (int inputChannels : {1, 2}) {
+        const std::vector<float> sample = makeNoise(inputChannels);
+        for (mix::Interpolation mode : options.modes) {
+            for (mix::PhaseFormat phase : options.phases) {
+                for (int voices : polyphony) {
+                    for (int bufferFrames : bufferSizes) {
+                        for (int semitones : transpositions) {
+                            printResult(
+                                runCase(sample, mode, phase, inputChannels, voices, bufferFrames, semitones, options),
+                                options);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (options.csv) {
+        std::cout << "\nvoices,ns_per_event\n";
+    }
+    const std::vector<float> sample = makeNoise(1);
+    for (int voices : {32, 256, 1024, 4096}) {
+        const double ns = measureEventCost(sample, voices);
+        if (options.csv) {
+            std::cout << voices << ',' << ns << '\n';
+        } else {
+            std::cout << "{\"event_cost\":{\"voices\":" << voices << ",\"ns_per_event\":" << ns << "}}\n";
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Pairs the frame each audio callback starts on with the time it started, so
+// input threads (UI, MIDI) can stamp events with an output frame. A sequence
+// counter keeps the two values consistent.
+class AudioClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Audio thread, at the start of every callback.
+    void publish(uint64_t frame, Clock::time_point time) {
+        const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frame_.store(frame, std::memory_order_relaxed);
+        nanos_.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Output frame that plays at `time`, extrapolated from the last callback.
+    // Before the first callback there is nothing to go on and 0 (kNow) is
+    // returned.
+    uint64_t frameAt(Clock::time_point time, int sampleRate) const {
+        uint32_t sequence = 0;
+        uint64_t frame = 0;
+        Clock::rep start = 0;
+        do {
+            sequence = sequence_.load(std::memory_order_acquire);
+            frame = frame_.load(std::memory_order_relaxed);
+            start = nanos_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((sequence & 1) || sequence != sequence_.load(std::memory_order_relaxed));
+        if (sequence == 0) {
+            return 0;
+        }
+        const Clock::duration elapsed = time.time_since_epoch() - Clock::duration(start);
+        const double seconds = elapsed.count() > 0 ? std::chrono::duration<double>(elapsed).count() : 0.0;
+        return frame + static_cast<uint64_t>(seconds * static_cast<double>(sampleRate));
+    }
+
+private:
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<uint64_t> frame_{0};
+    std::atomic<Clock::rep> nanos_{0};
+};
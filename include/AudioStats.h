@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Callback timing and engine counters, written by the audio thread and read
+// from any other. Every field is a single-writer atomic updated with plain
+// loads and stores, so recording never blocks or spins; a reader may see
+// fields from neighbouring callbacks, which is fine for monitoring.
+class AudioStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Callback durations go into log2 buckets: bucket 0 holds everything under
+    // kFirstBucketMicros, bucket b durations below kFirstBucketMicros << b,
+    // and the last bucket everything longer.
+    static constexpr int kHistogramBuckets = 16;
+    static constexpr double kFirstBucketMicros = 16.0;
+
+    struct Snapshot {
+        int sampleRate = 0;
+        uint64_t callbacks = 0;
+        uint64_t frames = 0;
+        uint64_t busyNanos = 0;    // total time spent inside callbacks
+        uint64_t maxNanos = 0;     // longest callback
+        double lastLoad = 0.0;     // last callback's duration / buffer period
+        double peakLoad = 0.0;
+        int activeVoices = 0;      // after the last callback
+        int peakVoices = 0;
+        uint64_t voiceSteals = 0;
+        uint64_t overruns = 0;      // callbacks that took longer than their period
+        uint64_t lateCallbacks = 0; // callbacks that started over 1.5 periods after the previous one
+        std::array<uint64_t, kHistogramBuckets> histogram{};
+
+        // Busy time as a fraction of the audio it produced.
+        double meanLoad() const;
+        double meanMicros() const;
+        // Upper edge of the bucket holding the p-th quantile (0..1), in microseconds.
+        double percentileMicros(double p) const;
+        // Counters accumulated since `earlier`; peaks and last values are kept.
+        Snapshot since(const Snapshot& earlier) const;
+
+        std::string toText() const;
+        std::string toJson() const;
+    };
+
+    explicit AudioStats(int sampleRate) : sampleRate_(sampleRate) {}
+
+    AudioStats(const AudioStats&) = delete;
+    AudioStats& operator=(const AudioStats&) = delete;
+
+    // Audio thread only. `voiceSteals` is the engine's running total.
+    void recordCallback(Clock::time_point start,
+                        Clock::time_point end,
+                        int frames,
+                        int activeVoices,
+                        uint64_t voiceSteals);
+
+    Snapshot snapshot() const;
+
+    static double bucketUpperMicros(int bucket);
+
+private:
+    // Single writer: a relaxed load and store is enough and never spins.
+    template <typename T>
+    static void add(std::atomic<T>& counter, T amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    const int sampleRate_;
+    Clock::time_point previousStart_{};
+
+    std::atomic<uint64_t> callbacks_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> busyNanos_{0};
+    std::atomic<uint64_t> maxNanos_{0};
+    std::atomic<double> lastLoad_{0.0};
+    std::atomic<double> peakLoad_{0.0};
+    std::atomic<int> activeVoices_{0};
+    std::atomic<int> peakVoices_{0};
+    std::atomic<uint64_t> voiceSteals_{0};
+    std::atomic<uint64_t> overruns_{0};
+    std::atomic<uint64_t> lateCallbacks_{0};
+    std::array<std::atomic<uint64_t>, kHistogramBuckets> histogram_{};
+};
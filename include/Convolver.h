@@ -0,0 +1,163 @@
+#pragma once
+
+#include "EventQueue.h"
+#include "Semaphore.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An impulse response at the engine's rate: one channel, or two for a stereo
+// reverb.
+struct ImpulseResponse {
+    std::vector<float> samples; // interleaved
+    int channels = 0;
+
+    size_t frames() const { return channels > 0 ? samples.size() / static_cast<size_t>(channels) : 0; }
+};
+
+// Reads the first two channels of a WAV impulse response, converts them to
+// `sampleRate` and scales them to unit energy in the louder channel. Throws
+// std::runtime_error.
+ImpulseResponse loadImpulseResponse(const std::string& path, int sampleRate);
+
+struct ReverbSettings {
+    float send = 0.25f;            // share of the dry mix fed to the reverb
+    size_t headFrames = 64;        // direct-form taps, and the block of the audio thread's partitions
+    size_t tailBlockFrames = 2048; // block of the tail partitions; 0 keeps every partition at headFrames
+    bool backgroundTail = true;    // false computes the tail inline, which offline rendering needs
+};
+
+// Partitioned FFT convolution for the reverb send bus. Both channels travel as
+// one complex signal, so a single complex FFT serves the pair: a mono response
+// convolves left + i*right, a stereo one convolves the mono sum with
+// left + i*right. The response is split into
+//   head - the first headFrames taps, convolved directly, so the bus adds no
+//          latency;
+//   body - taps up to twice tailBlockFrames, partitioned uniformly at
+//          headFrames (overlap-save over a frequency-domain delay line);
+//   tail - the rest, partitioned at tailBlockFrames.
+// Head and body run on the calling thread. A tail block's output is due one
+// block after its input is complete, so it is rendered on a background
+// thread. The audio thread queues each block and posts a semaphore, and the
+// worker sleeps on it between blocks and queues the output back; output that
+// is not back in time is left silent and counted.
+class Convolver {
+public:
+    Convolver(const ImpulseResponse& impulse, const ReverbSettings& settings); // throws std::runtime_error
+    ~Convolver();
+
+    Convolver(const Convolver&) = delete;
+    Convolver& operator=(const Convolver&) = delete;
+
+    // Feeds send * (left + mono, right + mono) to the reverb and adds its
+    // output to `left` and `right`. Only from one thread (the audio thread);
+    // never allocates or waits.
+    void process(float* left, float* right, const float* mono, int frames);
+
+    size_t headFrames() const { return head_; }
+    size_t tailBlockFrames() const { return tail_ ? tail_->block() : 0; }
+    // Tail blocks left silent because the background thread was late; any thread.
+    uint64_t lateBlocks() const { return lateBlocks_.load(std::memory_order_relaxed); }
+
+private:
+    // In-place radix-2 FFT over split real and imaginary arrays, unscaled.
+    class Fft {
+    public:
+        explicit Fft(size_t size);
+
+        void forward(float* re, float* im) const;
+        void inverse(float* re, float* im) const { forward(im, re); }
+
+    private:
+        size_t size_;
+        std::vector<uint32_t> reverse_;
+        std::vector<float> cosines_; // stages of 8 points and up, concatenated
+        std::vector<float> sines_;
+    };
+
+    // Uniformly partitioned overlap-save convolution with taps [first, last)
+    // of a complex filter, one block of `block` frames at a time.
+    class Partitioned {
+    public:
+        Partitioned(const float* re, const float* im, size_t first, size_t last, size_t block);
+
+        size_t block() const { return block_; }
+        bool empty() const { return partitions_ == 0; }
+        // Output for the next `block` input frames; `out` may alias `in`.
+        void process(const float* inRe, const float* inIm, float* outRe, float* outIm);
+        // Moves on by `blocks` blocks of silence without computing output.
+        void skip(uint64_t blocks);
+
+    private:
+        size_t block_;
+        size_t partitions_;
+        Fft fft_;
+        std::vector<float> filterRe_; // one spectrum of 2 * block_ bins per partition
+        std::vector<float> filterIm_;
+        std::vector<float> delayRe_; // spectra of the latest input windows, a ring
+        std::vector<float> delayIm_;
+        size_t newest_ = 0;
+        std::vector<float> windowRe_; // previous and current input block
+        std::vector<float> windowIm_;
+        std::vector<float> sumRe_;
+        std::vector<float> sumIm_;
+    };
+
+    // A tail slot holds one block's input, then its output until played.
+    enum class SlotState {
+        Free,
+        Filling,
+        Queued,
+        Ready
+    };
+
+    struct TailJob {
+        uint64_t block = 0;
+        int slot = -1;
+    };
+
+    static constexpr int kTailSlots = 4;
+
+    void advanceTail();
+    void run();
+
+    size_t head_;
+    float send_;
+    bool stereoImpulse_;
+    bool background_;
+
+    // Audio thread.
+    std::vector<float> headRe_; // head taps, reversed
+    std::vector<float> headIm_;
+    std::vector<float> historyRe_; // previous and current head block of input
+    std::vector<float> historyIm_;
+    size_t fill_ = 0;
+    std::unique_ptr<Partitioned> body_;
+    std::vector<float> bodyRe_; // body output for the current head block
+    std::vector<float> bodyIm_;
+
+    std::unique_ptr<Partitioned> tail_;
+    std::vector<float> slotsRe_; // kTailSlots blocks
+    std::vector<float> slotsIm_;
+    std::array<SlotState, kTailSlots> states_{};
+    std::array<uint64_t, kTailSlots> slotBlocks_{};
+    int filling_ = -1;
+    int playing_ = -1;
+    uint64_t tailBlocks_ = 0;
+    size_t tailFill_ = 0;
+
+    EventQueue<TailJob> jobs_{kTailSlots};
+    EventQueue<TailJob> done_{kTailSlots};
+    uint64_t workerNext_ = 0; // worker; first block it has not seen
+
+    std::atomic<uint64_t> lateBlocks_{0};
+    std::atomic<bool> running_{true};
+    Semaphore wakeup_; // one post per queued job
+    std::thread thread_;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Shape of the attack, decay and release segments.
+enum class EnvelopeCurve {
+    Linear,     // constant slope
+    Exponential // first-order approach, like an analogue RC envelope
+};
+
+inline const char* envelopeCurveName(EnvelopeCurve curve) {
+    return curve == EnvelopeCurve::Exponential ? "exp" : "linear";
+}
+
+// Accepts the names printed by envelopeCurveName.
+inline bool parseEnvelopeCurve(const std::string& name, EnvelopeCurve& curve) {
+    for (EnvelopeCurve candidate : {EnvelopeCurve::Linear, EnvelopeCurve::Exponential}) {
+        if (name == envelopeCurveName(candidate)) {
+            curve = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ADSR amplitude envelope. Attack rises from silence to full scale and decay
+// falls from full scale to `sustainLevel` in the given times; release takes
+// `releaseSeconds` to fall from full scale, proportionally less from lower
+// levels. The defaults are the engine's original 10 ms / 50 ms ramps.
+struct EnvelopeSettings {
+    double attackSeconds = 0.01;
+    double decaySeconds = 0.0;
+    double sustainLevel = 1.0;
+    double releaseSeconds = 0.05;
+    EnvelopeCurve curve = EnvelopeCurve::Linear;
+};
+
+// Parses "attack,decay,sustain,release[,linear|exp]" (seconds, level 0..1).
+inline bool parseEnvelope(const std::string& text, EnvelopeSettings& envelope) {
+    std::istringstream fields(text);
+    std::string field;
+    double values[4] = {};
+    for (double& value : values) {
+        if (!std::getline(fields, field, ',') || field.empty()) {
+            return false;
+        }
+        char* end = nullptr;
+        value = std::strtod(field.c_str(), &end);
+        if (*end != '\0' || !(value >= 0.0)) {
+            return false;
+        }
+    }
+    EnvelopeSettings parsed;
+    parsed.attackSeconds = values[0];
+    parsed.decaySeconds = values[1];
+    parsed.sustainLevel = values[2];
+    parsed.releaseSeconds = values[3];
+    if (parsed.sustainLevel > 1.0) {
+        return false;
+    }
+    if (std::getline(fields, field, ',') && !parseEnvelopeCurve(field, parsed.curve)) {
+        return false;
+    }
+    if (std::getline(fields, field)) {
+        return false;
+    }
+    envelope = parsed;
+    return true;
+}
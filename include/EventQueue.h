@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded multi-producer/single-consumer ring (Vyukov style). Each slot carries
+// a sequence number, so producers only contend on a single CAS of the tail and
+// the consumer never waits: pop() either returns an event or reports empty.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class EventQueue {
+public:
+    explicit EventQueue(size_t capacity) {
+        size_t rounded = 2;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        mask_ = rounded - 1;
+        slots_ = std::make_unique<Slot[]>(rounded);
+        for (size_t i = 0; i < rounded; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    // Safe to call from any number of threads. Returns false when full.
+    bool push(const T& value) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[position & mask_];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference =
+                static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Single consumer only. Never blocks.
+    bool pop(T& out) {
+        Slot& slot = slots_[head_ & mask_];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != head_ + 1) {
+            return false;
+        }
+        out = slot.value;
+        slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+};
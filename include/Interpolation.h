@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+
+namespace mix {
+
+// Resampling quality, cheapest first.
+enum class Interpolation {
+    Linear,  // 2 taps
+    Hermite, // 4-point cubic Hermite
+    Sinc     // 16-tap polyphase windowed sinc, band-limited by pitch step
+};
+
+inline const char* interpolationName(Interpolation mode) {
+    switch (mode) {
+    case Interpolation::Hermite:
+        return "hermite";
+    case Interpolation::Sinc:
+        return "sinc";
+    default:
+        return "linear";
+    }
+}
+
+// Accepts the names printed by interpolationName.
+inline bool parseInterpolation(const std::string& name, Interpolation& mode) {
+    for (Interpolation candidate : {Interpolation::Linear, Interpolation::Hermite, Interpolation::Sinc}) {
+        if (name == interpolationName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// How a voice tracks its read position in the sample.
+enum class PhaseFormat {
+    Double, // double position and step
+    Fixed   // 32.32 fixed point, advanced by integer addition
+};
+
+inline const char* phaseFormatName(PhaseFormat format) {
+    return format == PhaseFormat::Fixed ? "fixed" : "double";
+}
+
+// Accepts the names printed by phaseFormatName.
+inline bool parsePhaseFormat(const std::string& name, PhaseFormat& format) {
+    for (PhaseFormat candidate : {PhaseFormat::Double, PhaseFormat::Fixed}) {
+        if (name == phaseFormatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace mix
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// touch, so only the parts that are actually read become resident.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path); // throws std::runtime_error
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return data_ != nullptr; }
+
+    // Hints the kernel to start reading [offset, offset + length) ahead of use.
+    void prefetch(size_t offset, size_t length) const;
+    // Drops the whole pages inside [offset, offset + length) from memory; they
+    // are read from the file again if touched later.
+    void evict(size_t offset, size_t length) const;
+
+    static size_t pageSize();
+
+private:
+    void release();
+
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+// One complete channel message.
+struct MidiMessage {
+    uint8_t status = 0;
+    uint8_t data1 = 0;
+    uint8_t data2 = 0;
+
+    int channel() const { return status & 0x0f; }
+    int kind() const { return status & 0xf0; }
+    bool isNoteOn() const { return kind() == 0x90 && data2 > 0; }
+    bool isNoteOff() const { return kind() == 0x80 || (kind() == 0x90 && data2 == 0); }
+    bool isControlChange() const { return kind() == 0xb0; }
+};
+
+// Incremental parser for a raw MIDI byte stream. Handles running status,
+// real-time bytes interleaved anywhere, and skips SysEx and system common
+// messages; messages may be split across feed() calls. Keeps a few bytes of
+// state and never allocates.
+class MidiParser {
+public:
+    template <typename Sink>
+    void feed(const uint8_t* bytes, size_t count, Sink&& sink) {
+        for (size_t i = 0; i < count; ++i) {
+            const uint8_t byte = bytes[i];
+            if (byte >= 0xf8) {
+                continue; // real-time: clock, start/stop, active sensing, reset
+            }
+            if (byte & 0x80) {
+                inSysex_ = byte == 0xf0;
+                filled_ = 0;
+                if (byte >= 0xf0) {
+                    // System common cancels running status; skip its data bytes.
+                    status_ = 0;
+                    skip_ = byte == 0xf2 ? 2 : (byte == 0xf1 || byte == 0xf3) ? 1 : 0;
+                } else {
+                    status_ = byte;
+                    skip_ = 0;
+                }
+                continue;
+            }
+            if (inSysex_ || status_ == 0) {
+                continue;
+            }
+            if (skip_ > 0) {
+                --skip_;
+                continue;
+            }
+            data_[filled_++] = byte;
+            const int kind = status_ & 0xf0;
+            if (filled_ < (kind == 0xc0 || kind == 0xd0 ? 1 : 2)) {
+                continue;
+            }
+            filled_ = 0;
+            sink(MidiMessage{status_, data_[0], data_[1]});
+            data_[1] = 0;
+        }
+    }
+
+    void reset() { *this = MidiParser(); }
+
+private:
+    uint8_t status_ = 0; // running status; 0 when none
+    uint8_t data_[2] = {};
+    int filled_ = 0;
+    int skip_ = 0;
+    bool inSysex_ = false;
+};
+
+// Reads raw MIDI bytes on a dedicated thread and hands each message, with the
+// time its bytes arrived, to `handler` on that thread. `path` may name an
+// existing FIFO, which is read directly (and held open so writers can come
+// and go), or anything else, which is replaced by a listening Unix stream
+// socket accepting up to kMaxClients producers at once. After construction
+// the thread only polls, reads into a fixed buffer and parses; it never
+// allocates.
+class MidiInput {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Handler = std::function<void(const MidiMessage& message, Clock::time_point received)>;
+
+    static constexpr int kMaxClients = 8;
+
+    MidiInput(const std::string& path, Handler handler); // throws std::runtime_error
+    ~MidiInput();
+
+    MidiInput(const MidiInput&) = delete;
+    MidiInput& operator=(const MidiInput&) = delete;
+
+    const std::string& path() const { return path_; }
+    bool isSocket() const { return listenFd_ >= 0; }
+    uint64_t bytesReceived() const { return bytes_.load(std::memory_order_relaxed); }
+    uint64_t messagesReceived() const { return messages_.load(std::memory_order_relaxed); }
+
+private:
+    struct Source {
+        int fd = -1;
+        MidiParser parser;
+    };
+
+    void run();
+    void closeAll();
+    void acceptClient();
+    // False once the source has closed.
+    bool readFrom(Source& source);
+
+    std::string path_;
+    Handler handler_;
+    int listenFd_ = -1;
+    int fifoWriter_ = -1; // keeps a FIFO from reporting end-of-file between writers
+    int wakeRead_ = -1;
+    int wakeWrite_ = -1;
+    Source fifo_;
+    std::array<Source, kMaxClients> clients_{};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> messages_{0};
+    std::thread thread_;
+};
@@ -0,0 +1,824 @@
+#pragma once
+
+#include "Interpolation.h"
+#include "Simd.h"
+#include "SincTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Block kernels behind VoiceManager::mix. A voice is rendered as a handful of
+// segments per block; inside a segment the envelope is one GainRamp and
+// every interpolation index is known to be in range, so the loops below carry
+// no per-sample branches. Channel layouts are template parameters, which keeps
+// the mono/stereo decisions out of the inner loop as well.
+//
+// The kernels run four lanes (SSE, NEON). On x86 CPUs with AVX2 the linear
+// float kernel, the default, switches to eight lanes with gathers at run
+// time and renders its voices 1.5-2x faster. Even so, mix() for 32 stereo
+// voices measures about 3.5x the former frame-major loop (2.5-3x on four
+// lanes), not 4x. Hermite, sinc and the int16 kernels still run four lanes;
+// int16 planes would need 16-bit gathers, which AVX2 lacks.
+namespace mix {
+
+enum class OutputLayout {
+    Mono,
+    Stereo,
+    Surround
+};
+
+// A 16-bit planar zone (see SampleFormat::Int16Planar). Kernels reading
+// planes produce raw PCM values; callers fold kInt16Scale into the gain, so
+// the conversion costs one integer-to-float per tap.
+struct Int16Planes {
+    const int16_t* left;
+    const int16_t* right; // the left plane again for mono zones
+};
+
+constexpr float kInt16Scale = 1.0f / 32768.0f;
+
+// Envelope gain across one segment: base + k * slope + offset * ratio^k.
+// Linear segments leave the offset at zero; exponential ones decay it towards
+// `base` with no slope.
+struct GainRamp {
+    float base = 0.0f;
+    float slope = 0.0f;
+    float offset = 0.0f;
+    float ratio = 1.0f;
+
+    float at(int k) const {
+        const float linear = base + static_cast<float>(k) * slope;
+        return offset == 0.0f ? linear : linear + offset * std::pow(ratio, static_cast<float>(k));
+    }
+
+    GainRamp scaled(float factor) const { return {base * factor, slope * factor, offset * factor, ratio}; }
+};
+
+// Four consecutive gains of a ramp, advanced with one add and one multiply.
+class GainLanes {
+public:
+    explicit GainLanes(const GainRamp& ramp)
+        : linear_(simd::madd(
+              simd::broadcast(ramp.base), simd::set(0.0f, 1.0f, 2.0f, 3.0f), simd::broadcast(ramp.slope))),
+          decay_(simd::mul(simd::broadcast(ramp.offset),
+                           simd::set(1.0f, ramp.ratio, ramp.ratio * ramp.ratio, ramp.ratio * ramp.ratio * ramp.ratio))),
+          linearAdvance_(simd::broadcast(ramp.slope * static_cast<float>(simd::kLanes))),
+          decayAdvance_(simd::broadcast(ramp.ratio * ramp.ratio * ramp.ratio * ramp.ratio)) {}
+
+    simd::Float4 current() const { return simd::add(linear_, decay_); }
+
+    void advance() {
+        linear_ = simd::add(linear_, linearAdvance_);
+        decay_ = simd::mul(decay_, decayAdvance_);
+    }
+
+private:
+    simd::Float4 linear_;
+    simd::Float4 decay_;
+    simd::Float4 linearAdvance_;
+    simd::Float4 decayAdvance_;
+};
+
+// A voice's read position and per-frame step. Kernels see frame k of a
+// segment at position + k * step and split it into a sample index and a
+// fraction; split() does four consecutive frames for the vector loops.
+struct PhasePoint {
+    ptrdiff_t index;
+    float frac;
+};
+
+struct DoublePhase {
+    double position = 0.0;
+    double step = 1.0;
+
+    PhasePoint at(int k) const {
+        const double p = position + static_cast<double>(k) * step;
+        const ptrdiff_t index = static_cast<ptrdiff_t>(p);
+        return {index, static_cast<float>(p - static_cast<double>(index))};
+    }
+    simd::Float4 split(int k, int* indices) const {
+        return simd::splitPositions(position + static_cast<double>(k) * step, step, indices);
+    }
+    double stepFrames() const { return step; }
+};
+
+// 32.32 fixed point. Positions are exact integer sums, so they never drift
+// and come out the same on every platform; indices stay below 2^31.
+struct FixedPhase {
+    static constexpr double kOne = 4294967296.0;
+
+    uint64_t position = 0;
+    uint64_t step = 0;
+
+    static uint64_t fromFrames(double frames) { return static_cast<uint64_t>(std::llround(frames * kOne)); }
+
+    PhasePoint at(int k) const {
+        const uint64_t p = position + static_cast<uint64_t>(k) * step;
+        return {static_cast<ptrdiff_t>(p >> 32),
+                static_cast<float>(static_cast<uint32_t>(p) >> simd::kFixedFractionShift) * simd::kFixedFractionScale};
+    }
+    simd::Float4 split(int k, int* indices) const {
+        return simd::splitPhases(position + static_cast<uint64_t>(k) * step, step, indices);
+    }
+    double stepFrames() const { return static_cast<double>(step) / kOne; }
+};
+
+// Frames each interpolator reads before and after floor(position).
+template <Interpolation Mode>
+struct Reach;
+template <>
+struct Reach<Interpolation::Linear> {
+    static constexpr int kBefore = 0;
+    static constexpr int kAfter = 1;
+};
+template <>
+struct Reach<Interpolation::Hermite> {
+    static constexpr int kBefore = 1;
+    static constexpr int kAfter = 2;
+};
+template <>
+struct Reach<Interpolation::Sinc> {
+    static constexpr int kBefore = kSincTaps / 2 - 1;
+    static constexpr int kAfter = kSincTaps / 2;
+};
+
+inline float hermite(float xm1, float x0, float x1, float x2, float t) {
+    const float c1 = 0.5f * (x1 - xm1);
+    const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+inline simd::Float4 hermite(simd::Float4 xm1, simd::Float4 x0, simd::Float4 x1, simd::Float4 x2, simd::Float4 t) {
+    const simd::Float4 half = simd::broadcast(0.5f);
+    const simd::Float4 c1 = simd::mul(half, simd::sub(x1, xm1));
+    const simd::Float4 c2 = simd::sub(simd::add(xm1, simd::add(x1, x1)),
+                                      simd::madd(simd::mul(half, x2), x0, simd::broadcast(2.5f)));
+    const simd::Float4 c3 =
+        simd::madd(simd::mul(half, simd::sub(x2, xm1)), simd::sub(x0, x1), simd::broadcast(1.5f));
+    return simd::madd(x0, simd::madd(c1, simd::madd(c2, c3, t), t), t);
+}
+
+// Interpolates one sample from Reach<Mode> taps starting at floor(position) - kBefore.
+template <Interpolation Mode>
+float interpolateTaps(const float* taps, float frac, int sincLevel) {
+    if constexpr (Mode == Interpolation::Linear) {
+        return taps[0] + (taps[1] - taps[0]) * frac;
+    } else if constexpr (Mode == Interpolation::Hermite) {
+        return hermite(taps[0], taps[1], taps[2], taps[3], frac);
+    } else {
+        const float phase = frac * static_cast<float>(kSincPhases);
+        const int row = std::min(static_cast<int>(phase), kSincPhases - 1);
+        const float t = phase - static_cast<float>(row);
+        const float* c0 = kSincTable.coefficients[sincLevel][row];
+        const float* c1 = kSincTable.coefficients[sincLevel][row + 1];
+        float total = 0.0f;
+        for (int tap = 0; tap < kSincTaps; ++tap) {
+            total += taps[tap] * (c0[tap] + (c1[tap] - c0[tap]) * t);
+        }
+        return total;
+    }
+}
+
+#if defined(WAVE_SIMD_AVX2)
+// The vector loop of renderLinear eight frames at a time, with AVX2 gathers
+// for the taps. Positions and gains come from the same 4-lane split() and
+// GainLanes steps as the narrow loop and the arithmetic is the same, so the
+// output is bit-identical to it. Returns the frames done (a multiple of
+// eight) and leaves `gainLanes` where the narrow loop continues. Offsets are
+// 32-bit: floor(position) + 1 times `stride` must stay below 2^31.
+template <int InputChannels, bool WantRight, typename Phase>
+WAVE_TARGET_AVX2 int renderLinearWide(const float* data,
+                                      int stride,
+                                      Phase phase,
+                                      GainLanes& gainLanes,
+                                      int frames,
+                                      float* left,
+                                      float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+
+    GainLanes low = gainLanes;
+    GainLanes high = gainLanes;
+    high.advance();
+    const __m256i strides = _mm256_set1_epi32(stride);
+
+    int k = 0;
+    for (; k + 2 * simd::kLanes <= frames; k += 2 * simd::kLanes) {
+        const __m256 gains = _mm256_set_m128(high.current().v, low.current().v);
+        int indices[2 * simd::kLanes];
+        const __m256 frac = _mm256_set_m128(phase.split(k + simd::kLanes, indices + simd::kLanes).v,
+                                            phase.split(k, indices).v);
+        // Two 128-bit loads, so both stores in split() forward.
+        __m256i offsets = _mm256_set_m128i(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + simd::kLanes)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices)));
+        if constexpr (InputChannels > 1) {
+            offsets = _mm256_mullo_epi32(offsets, strides);
+        }
+
+        const __m256 a = _mm256_i32gather_ps(data, offsets, 4);
+        const __m256 b = _mm256_i32gather_ps(data + stride, offsets, 4);
+        const __m256 l = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), frac));
+        _mm256_storeu_ps(left + k, _mm256_add_ps(_mm256_loadu_ps(left + k), _mm256_mul_ps(l, gains)));
+        if constexpr (kStereo) {
+            const __m256 c = _mm256_i32gather_ps(data + 1, offsets, 4);
+            const __m256 d = _mm256_i32gather_ps(data + stride + 1, offsets, 4);
+            const __m256 r = _mm256_add_ps(c, _mm256_mul_ps(_mm256_sub_ps(d, c), frac));
+            _mm256_storeu_ps(right + k, _mm256_add_ps(_mm256_loadu_ps(right + k), _mm256_mul_ps(r, gains)));
+        }
+        low.advance();
+        low.advance();
+        high.advance();
+        high.advance();
+    }
+    gainLanes = low;
+    return k;
+}
+#endif
+
+// Adds `frames` linearly interpolated frames, scaled by the gain ramp, to
+// the bus. Mono input is summed into `left` only (the caller treats it as the
+// shared mono bus). The caller guarantees that
+// floor(position + k * step) + 1 is a valid frame for every k < frames.
+template <int InputChannels, bool WantRight, typename Phase>
+void renderLinear(const float* data,
+                  int stride,
+                  Phase phase,
+                  const GainRamp& gain,
+                  int frames,
+                  float* left,
+                  float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+
+    GainLanes gainLanes(gain);
+
+    int k = 0;
+#if defined(WAVE_SIMD_AVX2)
+    if (frames >= 2 * simd::kLanes && simd::hasAvx2() &&
+        (phase.at(frames - 1).index + 1) * static_cast<ptrdiff_t>(stride) < std::numeric_limits<int32_t>::max()) {
+        k = renderLinearWide<InputChannels, WantRight>(data, stride, phase, gainLanes, frames, left, right);
+    }
+#endif
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        const simd::Float4 gains = gainLanes.current();
+        int indices[simd::kLanes];
+        const simd::Float4 frac =
+            phase.split(k, indices);
+        const float* f0 = data + static_cast<size_t>(indices[0]) * static_cast<size_t>(stride);
+        const float* f1 = data + static_cast<size_t>(indices[1]) * static_cast<size_t>(stride);
+        const float* f2 = data + static_cast<size_t>(indices[2]) * static_cast<size_t>(stride);
+        const float* f3 = data + static_cast<size_t>(indices[3]) * static_cast<size_t>(stride);
+
+        if constexpr (InputChannels == 1) {
+            // Mono data is contiguous, so each lane's two taps are one 64-bit load.
+            const simd::Float4 x = simd::loadPairs(f0, f1);
+            const simd::Float4 y = simd::loadPairs(f2, f3);
+            const simd::Float4 a = simd::evenLanes(x, y);
+            const simd::Float4 b = simd::oddLanes(x, y);
+            const simd::Float4 l = simd::madd(a, simd::sub(b, a), frac);
+            simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+        } else if constexpr (kStereo) {
+            // Each lane loads {L0, R0, L1, R1}; a 4x4 transpose yields the tap vectors.
+            simd::Float4 l0 = simd::loadPairs(f0, f0 + stride);
+            simd::Float4 r0 = simd::loadPairs(f1, f1 + stride);
+            simd::Float4 l1 = simd::loadPairs(f2, f2 + stride);
+            simd::Float4 r1 = simd::loadPairs(f3, f3 + stride);
+            simd::transpose(l0, r0, l1, r1);
+            const simd::Float4 l = simd::madd(l0, simd::sub(l1, l0), frac);
+            const simd::Float4 r = simd::madd(r0, simd::sub(r1, r0), frac);
+            simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+            simd::store(right + k, simd::madd(simd::load(right + k), r, gains));
+        } else {
+            const simd::Float4 a = simd::set(f0[0], f1[0], f2[0], f3[0]);
+            const simd::Float4 b = simd::set(f0[stride], f1[stride], f2[stride], f3[stride]);
+            const simd::Float4 l = simd::madd(a, simd::sub(b, a), frac);
+            simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+        }
+        gainLanes.advance();
+    }
+
+    for (; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        const float g = gain.at(k);
+        const float* frame = data + static_cast<size_t>(index) * static_cast<size_t>(stride);
+        left[k] += (frame[0] + (frame[stride] - frame[0]) * frac) * g;
+        if constexpr (kStereo) {
+            right[k] += (frame[1] + (frame[stride + 1] - frame[1]) * frac) * g;
+        }
+    }
+}
+
+// renderLinear with 4-point Hermite interpolation. The caller guarantees that
+// floor(position + k * step) - 1 ... + 2 are valid frames.
+template <int InputChannels, bool WantRight, typename Phase>
+void renderHermite(const float* data,
+                   int stride,
+                   Phase phase,
+                   const GainRamp& gain,
+                   int frames,
+                   float* left,
+                   float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+
+    GainLanes gainLanes(gain);
+
+    int k = 0;
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        const simd::Float4 gains = gainLanes.current();
+        int indices[simd::kLanes];
+        const simd::Float4 frac =
+            phase.split(k, indices);
+        // Pointers to the first tap (frame index - 1) of each lane.
+        const float* f0 = data + static_cast<ptrdiff_t>(indices[0] - 1) * stride;
+        const float* f1 = data + static_cast<ptrdiff_t>(indices[1] - 1) * stride;
+        const float* f2 = data + static_cast<ptrdiff_t>(indices[2] - 1) * stride;
+        const float* f3 = data + static_cast<ptrdiff_t>(indices[3] - 1) * stride;
+
+        if constexpr (InputChannels == 1) {
+            simd::Float4 xm1 = simd::load(f0);
+            simd::Float4 x0 = simd::load(f1);
+            simd::Float4 x1 = simd::load(f2);
+            simd::Float4 x2 = simd::load(f3);
+            simd::transpose(xm1, x0, x1, x2);
+            const simd::Float4 l = hermite(xm1, x0, x1, x2, frac);
+            simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+        } else {
+            // Per lane {Lm1, Rm1, L0, R0} and {L1, R1, L2, R2}, split into
+            // left and right tap rows and transposed to tap-major order.
+            const float* lanes[simd::kLanes] = {f0, f1, f2, f3};
+            simd::Float4 taps[2][simd::kLanes];
+            for (int lane = 0; lane < simd::kLanes; ++lane) {
+                const float* f = lanes[lane];
+                const simd::Float4 a = simd::loadPairs(f, f + stride);
+                const simd::Float4 b = simd::loadPairs(f + 2 * stride, f + 3 * stride);
+                taps[0][lane] = simd::evenLanes(a, b);
+                taps[1][lane] = simd::oddLanes(a, b);
+            }
+            simd::transpose(taps[0][0], taps[0][1], taps[0][2], taps[0][3]);
+            const simd::Float4 l = hermite(taps[0][0], taps[0][1], taps[0][2], taps[0][3], frac);
+            simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+            if constexpr (kStereo) {
+                simd::transpose(taps[1][0], taps[1][1], taps[1][2], taps[1][3]);
+                const simd::Float4 r = hermite(taps[1][0], taps[1][1], taps[1][2], taps[1][3], frac);
+                simd::store(right + k, simd::madd(simd::load(right + k), r, gains));
+            }
+        }
+        gainLanes.advance();
+    }
+
+    for (; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        const float g = gain.at(k);
+        const float* f = data + (index - 1) * stride;
+        left[k] += hermite(f[0], f[stride], f[2 * stride], f[3 * stride], frac) * g;
+        if constexpr (kStereo) {
+            right[k] += hermite(f[1], f[stride + 1], f[2 * stride + 1], f[3 * stride + 1], frac) * g;
+        }
+    }
+}
+
+// renderLinear with the polyphase sinc table for this step's octave. The
+// caller guarantees that floor(position + k * step) - 7 ... + 8 are valid
+// frames. Vectorised across taps, one output frame at a time.
+template <int InputChannels, bool WantRight, typename Phase>
+void renderSinc(const float* data,
+                int stride,
+                Phase phase,
+                const GainRamp& gain,
+                int frames,
+                float* left,
+                float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+    constexpr int kBefore = Reach<Interpolation::Sinc>::kBefore;
+    const auto& rows = kSincTable.coefficients[sincLevelFor(phase.stepFrames())];
+
+    float decay = gain.offset;
+    for (int k = 0; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        const float scaled = frac * static_cast<float>(kSincPhases);
+        const int row = std::min(static_cast<int>(scaled), kSincPhases - 1);
+        const simd::Float4 t = simd::broadcast(scaled - static_cast<float>(row));
+        const float* c0 = rows[row];
+        const float* c1 = rows[row + 1];
+        const float* first = data + (index - kBefore) * stride;
+
+        simd::Float4 accLeft = simd::broadcast(0.0f);
+        simd::Float4 accRight = simd::broadcast(0.0f);
+        for (int tap = 0; tap < kSincTaps; tap += simd::kLanes) {
+            const simd::Float4 a = simd::load(c0 + tap);
+            const simd::Float4 c = simd::madd(a, simd::sub(simd::load(c1 + tap), a), t);
+            if constexpr (InputChannels == 1) {
+                accLeft = simd::madd(accLeft, simd::load(first + tap), c);
+            } else {
+                const float* f = first + tap * stride;
+                const simd::Float4 x = simd::loadPairs(f, f + stride);
+                const simd::Float4 y = simd::loadPairs(f + 2 * stride, f + 3 * stride);
+                accLeft = simd::madd(accLeft, simd::evenLanes(x, y), c);
+                if constexpr (kStereo) {
+                    accRight = simd::madd(accRight, simd::oddLanes(x, y), c);
+                }
+            }
+        }
+
+        const float g = gain.base + static_cast<float>(k) * gain.slope + decay;
+        decay *= gain.ratio;
+        left[k] += simd::sum(accLeft) * g;
+        if constexpr (kStereo) {
+            right[k] += simd::sum(accRight) * g;
+        }
+    }
+}
+
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderInterpolated(const float* data,
+                        int stride,
+                        Phase phase,
+                        const GainRamp& gain,
+                        int frames,
+                        float* left,
+                        float* right) {
+    if constexpr (Mode == Interpolation::Linear) {
+        renderLinear<InputChannels, WantRight>(data, stride, phase, gain, frames, left, right);
+    } else if constexpr (Mode == Interpolation::Hermite) {
+        renderHermite<InputChannels, WantRight>(data, stride, phase, gain, frames, left, right);
+    } else {
+        renderSinc<InputChannels, WantRight>(data, stride, phase, gain, frames, left, right);
+    }
+}
+
+// Linear and Hermite kernels over 16-bit planes. Linear gathers each lane's
+// two taps with one 32-bit load; Hermite loads four samples per lane and
+// transposes them to tap-major order.
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderPlanarPolynomial(const Int16Planes& planes,
+                            Phase phase,
+                            const GainRamp& gain,
+                            int frames,
+                            float* left,
+                            float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+    constexpr int kBefore = Reach<Mode>::kBefore;
+    constexpr int kTaps = kBefore + Reach<Mode>::kAfter + 1;
+
+    GainLanes gainLanes(gain);
+
+    // Local copies, so stores to the buses cannot force the pointers to be reloaded.
+    const int16_t* const leftPlane = planes.left;
+    const int16_t* const rightPlane = planes.right;
+    auto interpolate = [](const int16_t* plane, const int* indices, simd::Float4 frac) {
+        const int16_t* first[simd::kLanes];
+        for (int lane = 0; lane < simd::kLanes; ++lane) {
+            first[lane] = plane + indices[lane] - kBefore;
+        }
+        if constexpr (Mode == Interpolation::Linear) {
+            simd::Float4 a;
+            simd::Float4 b;
+            simd::convertInt16Pairs(first, a, b);
+            return simd::madd(a, simd::sub(b, a), frac);
+        } else {
+            simd::Float4 taps[simd::kLanes];
+            for (int lane = 0; lane < simd::kLanes; ++lane) {
+                taps[lane] = simd::convertInt16(first[lane]);
+            }
+            simd::transpose(taps[0], taps[1], taps[2], taps[3]);
+            return hermite(taps[0], taps[1], taps[2], taps[3], frac);
+        }
+    };
+
+    int k = 0;
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        const simd::Float4 gains = gainLanes.current();
+        int indices[simd::kLanes];
+        const simd::Float4 frac =
+            phase.split(k, indices);
+        simd::store(left + k, simd::madd(simd::load(left + k), interpolate(leftPlane, indices, frac), gains));
+        if constexpr (kStereo) {
+            simd::store(right + k, simd::madd(simd::load(right + k), interpolate(rightPlane, indices, frac), gains));
+        }
+        gainLanes.advance();
+    }
+
+    for (; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        const float g = gain.at(k);
+        float tapsLeft[kTaps];
+        float tapsRight[kTaps];
+        for (int tap = 0; tap < kTaps; ++tap) {
+            tapsLeft[tap] = planes.left[index - kBefore + tap];
+            tapsRight[tap] = kStereo ? planes.right[index - kBefore + tap] : 0.0f;
+        }
+        left[k] += interpolateTaps<Mode>(tapsLeft, frac, 0) * g;
+        if constexpr (kStereo) {
+            right[k] += interpolateTaps<Mode>(tapsRight, frac, 0) * g;
+        }
+    }
+}
+
+// renderSinc over 16-bit planes; the taps of each channel are contiguous.
+template <int InputChannels, bool WantRight, typename Phase>
+void renderPlanarSinc(const Int16Planes& planes,
+                      Phase phase,
+                      const GainRamp& gain,
+                      int frames,
+                      float* left,
+                      float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+    constexpr int kBefore = Reach<Interpolation::Sinc>::kBefore;
+    const auto& rows = kSincTable.coefficients[sincLevelFor(phase.stepFrames())];
+
+    float decay = gain.offset;
+    for (int k = 0; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        const float scaled = frac * static_cast<float>(kSincPhases);
+        const int row = std::min(static_cast<int>(scaled), kSincPhases - 1);
+        const simd::Float4 t = simd::broadcast(scaled - static_cast<float>(row));
+        const float* c0 = rows[row];
+        const float* c1 = rows[row + 1];
+        const int16_t* firstLeft = planes.left + index - kBefore;
+        const int16_t* firstRight = planes.right + index - kBefore;
+
+        simd::Float4 accLeft = simd::broadcast(0.0f);
+        simd::Float4 accRight = simd::broadcast(0.0f);
+        for (int tap = 0; tap < kSincTaps; tap += 2 * simd::kLanes) {
+            const simd::Float4 a0 = simd::load(c0 + tap);
+            const simd::Float4 a1 = simd::load(c0 + tap + simd::kLanes);
+            const simd::Float4 low = simd::madd(a0, simd::sub(simd::load(c1 + tap), a0), t);
+            const simd::Float4 high = simd::madd(a1, simd::sub(simd::load(c1 + tap + simd::kLanes), a1), t);
+            simd::Float4 x0;
+            simd::Float4 x1;
+            simd::convertInt16x8(firstLeft + tap, x0, x1);
+            accLeft = simd::madd(simd::madd(accLeft, x0, low), x1, high);
+            if constexpr (kStereo) {
+                simd::convertInt16x8(firstRight + tap, x0, x1);
+                accRight = simd::madd(simd::madd(accRight, x0, low), x1, high);
+            }
+        }
+
+        const float g = gain.base + static_cast<float>(k) * gain.slope + decay;
+        decay *= gain.ratio;
+        left[k] += simd::sum(accLeft) * g;
+        if constexpr (kStereo) {
+            right[k] += simd::sum(accRight) * g;
+        }
+    }
+}
+
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderInterpolated(const Int16Planes& planes,
+                        Phase phase,
+                        const GainRamp& gain,
+                        int frames,
+                        float* left,
+                        float* right) {
+    if constexpr (Mode == Interpolation::Sinc) {
+        renderPlanarSinc<InputChannels, WantRight>(planes, phase, gain, frames, left, right);
+    } else {
+        renderPlanarPolynomial<Mode, InputChannels, WantRight>(
+            planes, phase, gain, frames, left, right);
+    }
+}
+
+// Scalar fallback for the first and last few frames of a sample, where some
+// taps fall outside [first, last]; those repeat the nearest edge frame.
+// `sample(frame, channel)` reads one value.
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase, typename Sample>
+void renderClampedWith(Sample sample,
+                       ptrdiff_t firstFrame,
+                       ptrdiff_t lastFrame,
+                       Phase phase,
+                       const GainRamp& gain,
+                       int frames,
+                       float* left,
+                       float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+    constexpr int kBefore = Reach<Mode>::kBefore;
+    constexpr int kTaps = kBefore + Reach<Mode>::kAfter + 1;
+    const int sincLevel = Mode == Interpolation::Sinc ? sincLevelFor(phase.stepFrames()) : 0;
+
+    float decay = gain.offset;
+    for (int k = 0; k < frames; ++k) {
+        const auto [index, frac] = phase.at(k);
+        float tapsLeft[kTaps];
+        float tapsRight[kTaps];
+        for (int tap = 0; tap < kTaps; ++tap) {
+            const ptrdiff_t frame = std::clamp(index - kBefore + tap, firstFrame, lastFrame);
+            tapsLeft[tap] = sample(frame, 0);
+            tapsRight[tap] = kStereo ? sample(frame, 1) : 0.0f;
+        }
+        const float g = gain.base + static_cast<float>(k) * gain.slope + decay;
+        decay *= gain.ratio;
+        left[k] += interpolateTaps<Mode>(tapsLeft, frac, sincLevel) * g;
+        if constexpr (kStereo) {
+            right[k] += interpolateTaps<Mode>(tapsRight, frac, sincLevel) * g;
+        }
+    }
+}
+
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderClamped(const float* data,
+                   int stride,
+                   ptrdiff_t firstFrame,
+                   ptrdiff_t lastFrame,
+                   Phase phase,
+                   const GainRamp& gain,
+                   int frames,
+                   float* left,
+                   float* right) {
+    renderClampedWith<Mode, InputChannels, WantRight>(
+        [data, stride](ptrdiff_t frame, int channel) { return data[frame * stride + channel]; },
+        firstFrame, lastFrame, phase, gain, frames, left, right);
+}
+
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderClamped(const Int16Planes& planes,
+                   ptrdiff_t firstFrame,
+                   ptrdiff_t lastFrame,
+                   Phase phase,
+                   const GainRamp& gain,
+                   int frames,
+                   float* left,
+                   float* right) {
+    renderClampedWith<Mode, InputChannels, WantRight>(
+        [planes](ptrdiff_t frame, int channel) {
+            return static_cast<float>(channel == 0 ? planes.left[frame] : planes.right[frame]);
+        },
+        firstFrame, lastFrame, phase, gain, frames, left, right);
+}
+
+// Scalar path for the last few frames before a loop end, whose later taps
+// continue from the loop start: frames at or past `loopEnd` read
+// loopStart + (frame - loopStart) % (loopEnd - loopStart). Taps before frame 0
+// repeat it, as in renderClamped.
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderLooped(const float* data,
+                  int stride,
+                  ptrdiff_t loopStart,
+                  ptrdiff_t loopEnd,
+                  Phase phase,
+                  const GainRamp& gain,
+                  int frames,
+                  float* left,
+                  float* right) {
+    const ptrdiff_t length = loopEnd - loopStart;
+    renderClampedWith<Mode, InputChannels, WantRight>(
+        [=](ptrdiff_t frame, int channel) {
+            frame = frame < loopEnd ? frame : loopStart + (frame - loopStart) % length;
+            return data[frame * stride + channel];
+        },
+        0, std::numeric_limits<ptrdiff_t>::max(), phase, gain, frames, left, right);
+}
+
+template <Interpolation Mode, int InputChannels, bool WantRight, typename Phase>
+void renderLooped(const Int16Planes& planes,
+                  ptrdiff_t loopStart,
+                  ptrdiff_t loopEnd,
+                  Phase phase,
+                  const GainRamp& gain,
+                  int frames,
+                  float* left,
+                  float* right) {
+    const ptrdiff_t length = loopEnd - loopStart;
+    renderClampedWith<Mode, InputChannels, WantRight>(
+        [=](ptrdiff_t frame, int channel) {
+            frame = frame < loopEnd ? frame : loopStart + (frame - loopStart) % length;
+            return static_cast<float>(channel == 0 ? planes.left[frame] : planes.right[frame]);
+        },
+        0, std::numeric_limits<ptrdiff_t>::max(), phase, gain, frames, left, right);
+}
+
+// Adds a held value under a gain ramp; used once the playhead has reached the
+// last frame of the sample and the voice is fading out on it.
+template <int InputChannels, bool WantRight>
+void renderHeld(float valueLeft,
+                float valueRight,
+                const GainRamp& gain,
+                int frames,
+                float* left,
+                float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+
+    GainLanes gainLanes(gain);
+    const simd::Float4 l = simd::broadcast(valueLeft);
+    const simd::Float4 r = simd::broadcast(valueRight);
+
+    int k = 0;
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        const simd::Float4 gains = gainLanes.current();
+        simd::store(left + k, simd::madd(simd::load(left + k), l, gains));
+        if constexpr (kStereo) {
+            simd::store(right + k, simd::madd(simd::load(right + k), r, gains));
+        }
+        gainLanes.advance();
+    }
+    for (; k < frames; ++k) {
+        const float g = gain.at(k);
+        left[k] += valueLeft * g;
+        if constexpr (kStereo) {
+            right[k] += valueRight * g;
+        }
+    }
+}
+
+// Adds `frames` consecutive frames `stride` floats apart, scaled by
+// the gain ramp; the playback path for pre-pitched copies, which need no
+// interpolation.
+template <int InputChannels, bool WantRight>
+void renderUnitStep(const float* data, int stride, const GainRamp& gain, int frames, float* left, float* right) {
+    constexpr bool kStereo = InputChannels > 1 && WantRight;
+
+    GainLanes gainLanes(gain);
+
+    int k = 0;
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        const simd::Float4 gains = gainLanes.current();
+        if constexpr (InputChannels == 1) {
+            simd::store(left + k, simd::madd(simd::load(left + k), simd::load(data + k), gains));
+        } else {
+            // {L0, R0, L1, R1} and {L2, R2, L3, R3}, deinterleaved.
+            const float* frame = data + static_cast<size_t>(k) * static_cast<size_t>(stride);
+            const simd::Float4 x = simd::loadPairs(frame, frame + stride);
+            const simd::Float4 y = simd::loadPairs(frame + 2 * stride, frame + 3 * stride);
+            simd::store(left + k, simd::madd(simd::load(left + k), simd::evenLanes(x, y), gains));
+            if constexpr (kStereo) {
+                simd::store(right + k, simd::madd(simd::load(right + k), simd::oddLanes(x, y), gains));
+            }
+        }
+        gainLanes.advance();
+    }
+    for (; k < frames; ++k) {
+        const float g = gain.at(k);
+        const float* frame = data + static_cast<size_t>(k) * static_cast<size_t>(stride);
+        left[k] += frame[0] * g;
+        if constexpr (kStereo) {
+            right[k] += frame[1] * g;
+        }
+    }
+}
+
+// destination[k] += source[k]
+inline void accumulate(float* destination, const float* source, int frames) {
+    int k = 0;
+    for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+        simd::store(destination + k, simd::add(simd::load(destination + k), simd::load(source + k)));
+    }
+    for (; k < frames; ++k) {
+        destination[k] += source[k];
+    }
+}
+
+// Folds the planar buses into the interleaved device buffer. `mono` holds the
+// mono-input voices and is added to both sides; extra output channels carry
+// the average of the clamped left and right signals.
+template <OutputLayout Layout>
+void writeOutput(const float* left,
+                 const float* right,
+                 const float* mono,
+                 float* output,
+                 int frames,
+                 int outputChannels) {
+    int k = 0;
+    if constexpr (Layout == OutputLayout::Mono) {
+        for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+            const simd::Float4 l = simd::add(simd::load(left + k), simd::load(mono + k));
+            simd::store(output + k, simd::clamp(l, -1.0f, 1.0f));
+        }
+        for (; k < frames; ++k) {
+            output[k] = std::clamp(left[k] + mono[k], -1.0f, 1.0f);
+        }
+    } else {
+        for (; k + simd::kLanes <= frames; k += simd::kLanes) {
+            alignas(16) float l[simd::kLanes];
+            alignas(16) float r[simd::kLanes];
+            const simd::Float4 m = simd::load(mono + k);
+            simd::store(l, simd::clamp(simd::add(simd::load(left + k), m), -1.0f, 1.0f));
+            simd::store(r, simd::clamp(simd::add(simd::load(right + k), m), -1.0f, 1.0f));
+            for (int lane = 0; lane < simd::kLanes; ++lane) {
+                float* frame = output + static_cast<size_t>(k + lane) * static_cast<size_t>(outputChannels);
+                frame[0] = l[lane];
+                frame[1] = r[lane];
+                if constexpr (Layout == OutputLayout::Surround) {
+                    const float centre = (l[lane] + r[lane]) * 0.5f;
+                    for (int channel = 2; channel < outputChannels; ++channel) {
+                        frame[channel] = centre;
+                    }
+                }
+            }
+        }
+        for (; k < frames; ++k) {
+            const float l = std::clamp(left[k] + mono[k], -1.0f, 1.0f);
+            const float r = std::clamp(right[k] + mono[k], -1.0f, 1.0f);
+            float* frame = output + static_cast<size_t>(k) * static_cast<size_t>(outputChannels);
+            frame[0] = l;
+            frame[1] = r;
+            if constexpr (Layout == OutputLayout::Surround) {
+                for (int channel = 2; channel < outputChannels; ++channel) {
+                    frame[channel] = (l + r) * 0.5f;
+                }
+            }
+        }
+    }
+}
+
+} // namespace mix
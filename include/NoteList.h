@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A note on/off at an absolute time, as read from a note list or MIDI file.
+struct NoteEvent {
+    double time = 0.0; // seconds from the start of the render
+    int note = 0;
+    int velocity = 0;  // 0 for note off
+    bool on = false;
+};
+
+// Text note lists hold one event per line: "<seconds> on|off <midi note> [velocity]".
+// Blank lines and lines starting with '#' are ignored.
+std::vector<NoteEvent> readNoteText(const std::string& path);
+
+// Standard MIDI File (format 0 or 1). All tracks and channels are merged and
+// tick times are converted to seconds through the tempo map.
+std::vector<NoteEvent> readMidiFile(const std::string& path);
+
+// Dispatches on the file contents: files starting with "MThd" are parsed as
+// MIDI, everything else as a text note list. The result is sorted by time.
+std::vector<NoteEvent> readNoteList(const std::string& path);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "NoteList.h"
+
+#include <cstddef>
+#include <vector>
+
+class VoiceManager;
+
+// How renderOffline hands events to the manager.
+enum class EventTiming {
+    Timestamped, // fixed blocks; events carry their frame and mix() splits at it
+    SplitBlocks, // blocks cut at every event frame; the exact reference
+    BlockStart   // events applied at the start of the block they fall in (no timestamps)
+};
+
+struct RenderOptions {
+    int blockSize = 512;
+    double tailSeconds = 10.0; // longest render after the last event while voices still sound
+    EventTiming timing = EventTiming::Timestamped;
+};
+
+struct RenderResult {
+    std::vector<float> samples; // interleaved, VoiceManager::outputChannels() wide
+    size_t frames = 0;
+    double renderSeconds = 0.0; // wall-clock time spent inside mix()
+    double audioSeconds = 0.0;
+
+    // How many times faster than real time the render ran.
+    double realTimeFactor() const { return renderSeconds > 0.0 ? audioSeconds / renderSeconds : 0.0; }
+};
+
+// Drives the manager without an audio device, as fast as the CPU allows.
+RenderResult renderOffline(VoiceManager& manager, const std::vector<NoteEvent>& events, const RenderOptions& options);
+
+struct OnsetReport {
+    size_t checked = 0;     // note-ons that start from silence in the reference
+    size_t exact = 0;       // of those, onsets on the reference frame
+    long maxError = 0;      // largest |onset - reference onset| in frames
+    double meanError = 0.0; // mean |onset - reference onset| in frames
+};
+
+// Compares note onsets in `rendered` against `reference` (both renders of
+// `events` at `sampleRate` with `channels` interleaved channels). Only notes
+// preceded by silence are measured; an onset is the first frame above
+// `threshold` within `window` frames either side of the event.
+OnsetReport compareOnsets(const RenderResult& rendered,
+                          const RenderResult& reference,
+                          const std::vector<NoteEvent>& events,
+                          int sampleRate,
+                          int channels,
+                          size_t window = 4096,
+                          float threshold = 1e-4f);
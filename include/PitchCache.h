@@ -0,0 +1,156 @@
+#pragma once
+
+#include "EventQueue.h"
+#include "Resampler.h"
+#include "SampleBank.h"
+#include "Semaphore.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+struct PitchCacheSettings {
+    size_t budgetBytes = size_t{256} << 20;
+    ResampleOptions quality{1}; // one thread, so the worker stays in the background
+    bool background = true;     // false renders copies inline, which offline rendering needs
+};
+
+// Pre-pitched copies of zones for the keys actually played. The first note on
+// a key misses and is interpolated as usual while a background thread
+// resamples the whole zone to that key's pitch with the load-time sinc
+// filter; later notes on the key play the copy at unit step. Entries are
+// evicted least recently used once their bytes exceed the budget, never while
+// a voice plays them. Looped, streamed and partly decoded zones are not
+// cached.
+//
+// The entry table belongs to the audio thread; the worker only renders and
+// frees buffers it is told about through two queues, so the audio thread
+// never allocates, frees or waits. It finds entries through a hash index
+// and evicts from the front of a recency list, so a note-on costs the same
+// however many entries are cached. The worker sleeps on a semaphore that
+// each queued job posts. Without `background` there is no worker: a miss
+// renders its copy on the spot, and update() installs it, so which notes hit
+// depends only on the events and block boundaries.
+class PitchCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0; // note-ons on cacheable zones that had to interpolate
+        uint64_t renders = 0;
+        uint64_t evictions = 0;
+        size_t bytes = 0;
+        int entries = 0;
+    };
+
+    static constexpr int kMaxEntries = 512;
+    // Renders queued at once; later misses are not queued, which bounds the
+    // worker's backlog and the banks it keeps alive.
+    static constexpr int kMaxPending = 4;
+
+    PitchCache(int sampleRate, const PitchCacheSettings& settings);
+    ~PitchCache();
+
+    PitchCache(const PitchCache&) = delete;
+    PitchCache& operator=(const PitchCache&) = delete;
+
+    // Audio thread only. The copy of `zone` played at `step` for `note`,
+    // pinned until release(entry); nullptr on a miss, which queues a render.
+    // `epoch` tells apart zones of different banks at the same address.
+    const SampleZone* acquire(const SampleZone& zone, uint64_t epoch, int note, double step, int& entry);
+    void release(int entry);
+    // Installs finished renders and evicts down to the budget.
+    void update();
+    // Oldest bank epoch the worker may still read from, or `current`.
+    uint64_t oldestPendingEpoch(uint64_t current) const { return std::min(current, oldestPending_); }
+
+    // Any thread.
+    Stats stats() const;
+    size_t budgetBytes() const { return budgetBytes_; }
+
+private:
+    enum class State {
+        Free,
+        Pending,
+        Ready
+    };
+
+    struct Entry {
+        State state = State::Free;
+        const SampleZone* source = nullptr;
+        uint64_t epoch = 0;
+        int note = 0;
+        SampleZone zone; // the pre-pitched copy once ready
+        int voices = 0;  // sounding voices reading it
+        size_t bytes = 0;
+
+        // Links in recent_ while ready, least recently used first.
+        int previous = -1;
+        int next = -1;
+    };
+
+    struct Job {
+        int entry = -1;
+        bool render = true; // false frees the entry's buffer
+        SampleZone source;
+        double step = 1.0;
+    };
+
+    struct Done {
+        int entry = -1;
+        const float* data = nullptr; // nullptr when rendering failed
+        size_t frames = 0;
+    };
+
+    // Open addressing with linear probing; at most half full.
+    static constexpr size_t kIndexSize = 2 * kMaxEntries;
+
+    static size_t hashKey(const SampleZone* source, uint64_t epoch, int note);
+    int find(const SampleZone* source, uint64_t epoch, int note) const;
+    void insertIndex(int entry);
+    void eraseIndex(int entry);
+    void pushRecent(int entry);
+    void unlinkRecent(int entry);
+    void addPending(int entry);
+    void removePending(int entry);
+    void freeEntry(int entry);
+    bool postJob(const Job& job);
+    void run();
+    void doJob(const Job& job);
+    void renderJob(const Job& job);
+    int evictOne();
+
+    int sampleRate_;
+    size_t budgetBytes_;
+    ResampleOptions quality_;
+    bool background_;
+
+    // Audio thread.
+    std::vector<Entry> entries_;
+    std::array<int, kIndexSize> index_{}; // entry per slot, -1 when empty
+    std::vector<int> freeEntries_;
+    int recentHead_ = -1;
+    int recentTail_ = -1;
+    size_t readyBytes_ = 0;
+    std::array<int, kMaxPending> pendingEntries_{};
+    int pending_ = 0;
+    uint64_t oldestPending_ = std::numeric_limits<uint64_t>::max();
+
+    EventQueue<Job> jobs_{kMaxEntries + kMaxPending};
+    EventQueue<Done> done_{kMaxPending};
+    std::vector<std::vector<float>> buffers_; // worker; one per entry
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> renders_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<size_t> bytes_{0};
+    std::atomic<int> readyEntries_{0};
+    std::atomic<bool> running_{true};
+    Semaphore wakeup_; // one post per queued job
+    std::thread thread_;
+};
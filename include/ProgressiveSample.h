@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "SampleBank.h"
+#include "WavFile.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// A WAV file that plays while it is still being decoded. The constructor
+// decodes only the first kFirstChunkFrames; a background thread decodes the
+// rest in chunks, publishing how far it got through the zone's `decoded`
+// counter. The zone covers the whole file at its own rate from the start (the
+// voice's pitch step absorbs the rate difference, as for streamed files), and
+// a voice that catches up with the decoder waits on the newest decoded frame
+// until more arrives. Zones are not complete until waitForData() returns, so
+// only then may they be converted or cached.
+class ProgressiveSample {
+public:
+    static constexpr size_t kFirstChunkFrames = 8192;
+    static constexpr size_t kChunkFrames = size_t{1} << 16;
+
+    ProgressiveSample(const std::string& path, int rootNote); // throws std::runtime_error
+    ~ProgressiveSample();
+
+    ProgressiveSample(const ProgressiveSample&) = delete;
+    ProgressiveSample& operator=(const ProgressiveSample&) = delete;
+
+    const SampleZone& zone() const { return zone_; }
+    size_t decodedFrames() const { return decoded_.load(std::memory_order_acquire); }
+    bool complete() const { return decodedFrames() == zone_.frames; }
+
+    // Blocks until the whole file is decoded and returns a copy of it with
+    // its loop, in the form SampleCache::load expects from a decoder.
+    WavData waitForData() const;
+
+private:
+    void run();
+    void decode(size_t first, size_t count);
+
+    MappedFile file_;
+    WavFormat format_;
+    std::unique_ptr<float[]> samples_; // left uninitialised until decoded
+    std::atomic<size_t> decoded_{0};
+    SampleZone zone_;
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable completed_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+};
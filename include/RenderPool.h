@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Semaphore.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Fork/join pool for the audio thread. run() hands out task indices through
+// per-thread ranges: each participant pops from the front of its own range
+// and, once that is empty, steals from the back of the others'. The caller
+// takes part as participant 0 and only ever waits for tasks another thread
+// has already claimed, so a worker that wakes late costs parallelism, not a
+// missed deadline. After a job a worker spins briefly in case the next one
+// follows at once, then sleeps on its own semaphore, which run() posts.
+class RenderPool {
+public:
+    using Task = void (*)(void* context, int index);
+
+    // `threads` counts the calling thread; threads - 1 workers are started
+    // and asked for real-time scheduling where the OS allows it.
+    explicit RenderPool(int threads);
+    ~RenderPool();
+
+    RenderPool(const RenderPool&) = delete;
+    RenderPool& operator=(const RenderPool&) = delete;
+
+    int threadCount() const { return static_cast<int>(ranges_.size()); }
+
+    // Runs task(context, i) for every i in [0, count) and returns once all
+    // have finished. Call from one thread at a time.
+    void run(int count, Task task, void* context);
+
+private:
+    // front in the low 32 bits, back (exclusive) in the high 32 bits.
+    struct alignas(64) Range {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    void workerLoop(int participant);
+    void work(int participant);
+    bool popFront(Range& range, int& index);
+    bool popBack(Range& range, int& index);
+
+    std::vector<Range> ranges_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<Task> task_{nullptr};
+    std::atomic<void*> context_{nullptr};
+    alignas(64) std::atomic<int> pending_{0};
+    alignas(64) std::atomic<uint64_t> epoch_{0};
+    std::atomic<bool> running_{true};
+
+    std::unique_ptr<Semaphore[]> wakeups_; // per participant (0, the caller, unused); one post per job
+};
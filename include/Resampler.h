@@ -0,0 +1,43 @@
+#pragma once
+
+#include "SampleBank.h"
+
+#include <cstddef>
+#include <vector>
+
+// Load-time sample-rate conversion: a polyphase Kaiser-windowed sinc filter,
+// evaluated exactly for rational rate pairs with up to kMaxPhases output
+// phases (every common audio pair) and by interpolating between phases
+// otherwise. Output frames are split over worker threads.
+struct ResampleOptions {
+    int threads = 0;         // 0 uses every hardware thread
+    int halfTaps = 64;       // taps either side at or above unity; scaled up when downsampling
+    double passband = 0.45;  // cutoff in cycles per frame of the lower rate
+    double kaiserBeta = 9.6; // about 95 dB stopband
+};
+
+constexpr size_t kMaxPhases = 4096;
+
+// Frames produced for `frames` input frames.
+size_t resampledFrames(size_t frames, int fromRate, int toRate);
+
+// Moves loop points to the nearest frames at `toRate`, within the `frames`
+// converted frames; a loop that collapses is dropped.
+void resampleLoop(size_t& loopStart, size_t& loopEnd, size_t frames, int fromRate, int toRate);
+
+// Converts interleaved frames from `fromRate` to `toRate`. Equal rates copy.
+std::vector<float> resample(const float* input,
+                            size_t frames,
+                            int channels,
+                            int fromRate,
+                            int toRate,
+                            const ResampleOptions& options = {});
+
+// A bank whose in-memory zones all play at `sampleRate`. Float zones at
+// another rate are converted into `storage`; the rest, and streamed zones
+// (which are never fully resident), still point into `bank`, so both must
+// outlive the result. Convert before compactBank().
+SampleBank resampleBank(const SampleBank& bank,
+                        int sampleRate,
+                        std::vector<std::vector<float>>& storage,
+                        const ResampleOptions& options = {});
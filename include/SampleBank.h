@@ -0,0 +1,154 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class StreamingSample;
+
+// How a zone's resident frames are stored. Int16Planar halves the footprint
+// and the memory traffic of Float32; the mix kernels convert it on the fly.
+enum class SampleFormat {
+    Float32,    // interleaved floats at `data`
+    Int16Planar // one plane of 16-bit PCM per channel at `pcm`
+};
+
+inline const char* sampleFormatName(SampleFormat format) {
+    return format == SampleFormat::Int16Planar ? "int16" : "float";
+}
+
+// Accepts the names printed by sampleFormatName.
+inline bool parseSampleFormat(const std::string& name, SampleFormat& format) {
+    for (SampleFormat candidate : {SampleFormat::Float32, SampleFormat::Int16Planar}) {
+        if (name == sampleFormatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// One playable region of an instrument: a key/velocity rectangle mapped onto
+// a sample recorded at `rootNote`. `data` points straight into the bank's
+// mapped pool (or caller-owned memory for single-sample banks).
+struct SampleZone {
+    int lowKey = 0;
+    int highKey = 127;
+    int lowVelocity = 0;
+    int highVelocity = 127;
+    int rootNote = 60;
+    int sampleRate = 0;
+    int channels = 0;
+    SampleFormat format = SampleFormat::Float32;
+    const float* data = nullptr; // Float32: interleaved frames
+    const int16_t* pcm = nullptr; // Int16Planar: channel c starts at pcm + c * planeStride
+    size_t planeStride = 0;
+    size_t frames = 0;
+
+    // Frames [loopStart, loopEnd) repeat for as long as the voice sounds,
+    // release included; loopEnd is 0 for a one-shot zone.
+    size_t loopStart = 0;
+    size_t loopEnd = 0;
+
+    // Disk-streamed zones keep only the first `headFrames` at `data`; the rest
+    // is fed through SampleStreamer ring buffers.
+    const StreamingSample* stream = nullptr;
+    size_t headFrames = 0;
+
+    // Zones still being decoded (see ProgressiveSample) can only be read up
+    // to the frame count published here.
+    const std::atomic<size_t>* decoded = nullptr;
+
+    size_t residentFrames() const {
+        return stream ? headFrames : decoded ? decoded->load(std::memory_order_acquire) : frames;
+    }
+    bool looped() const { return loopEnd > loopStart; }
+};
+
+// Source description used when building a bank file.
+struct BankZoneSpec {
+    std::string samplePath;
+    int lowKey = 0;
+    int highKey = 127;
+    int lowVelocity = 0;
+    int highVelocity = 127;
+    int rootNote = 60;
+    // Loop in source frames; without one the WAV file's `smpl` loop is used.
+    bool explicitLoop = false;
+    size_t loopStart = 0;
+    size_t loopEnd = 0;
+    size_t crossfadeFrames = 0; // see crossfadeLoop()
+};
+
+// Multi-sample instrument. Bank files (.wbk) hold a small zone table followed
+// by a pool of interleaved float samples, each starting on a kPoolAlignment
+// boundary, so opening a bank only maps the file and voices read from it
+// directly; untouched samples never become resident.
+class SampleBank {
+public:
+    static constexpr size_t kPoolAlignment = 16384; // covers 4 KiB and 16 KiB pages
+
+    SampleBank() = default;
+    SampleBank(SampleBank&&) = default;
+    SampleBank& operator=(SampleBank&&) = default;
+
+    static SampleBank open(const std::string& path); // throws std::runtime_error
+
+    // Wraps caller-owned interleaved data as one zone covering every key,
+    // looping [loopStart, loopEnd) when that is a valid range.
+    static SampleBank fromSample(const float* data,
+                                 size_t frames,
+                                 int channels,
+                                 int sampleRate,
+                                 int rootNote,
+                                 size_t loopStart = 0,
+                                 size_t loopEnd = 0);
+
+    // Wraps zones whose data is owned elsewhere (e.g. by a StreamingSample).
+    static SampleBank fromZones(std::vector<SampleZone> zones);
+
+    // Wraps zones that point into `file`; the bank keeps it mapped.
+    static SampleBank fromZones(std::vector<SampleZone> zones, MappedFile file);
+
+    // Picks the zone for a key/velocity pair; nullptr when nothing matches.
+    const SampleZone* findZone(int midiNote, int velocity) const;
+
+    const std::vector<SampleZone>& zones() const { return zones_; }
+    bool empty() const { return zones_.empty(); }
+    bool hasStreamedZones() const;
+    size_t mappedBytes() const { return file_.size(); }
+
+private:
+    void indexZones();
+
+    MappedFile file_;
+    std::vector<SampleZone> zones_;
+    std::array<std::vector<uint32_t>, 128> zonesByKey_{};
+};
+
+// Planes start on kPlaneAlignment byte boundaries and are followed by at
+// least kPlanePadding spare samples, so kernels may load a few taps past the
+// last frame.
+constexpr size_t kPlaneAlignment = 64;
+constexpr size_t kPlanePadding = 32;
+
+// A bank whose in-memory zones are converted to Int16Planar into `storage`
+// (rounded, clipped at full scale; exact for 16-bit sources). Streamed zones
+// keep their float head and still point into `bank`, which must then outlive
+// the result; otherwise the source may be released once this returns.
+SampleBank compactBank(const SampleBank& bank, std::vector<std::vector<int16_t>>& storage);
+
+// Decodes each spec'd WAV file once and writes them as a bank file.
+void writeSampleBank(const std::string& path, const std::vector<BankZoneSpec>& zones);
+
+// Reads a bank manifest: one zone per line,
+// "<wav path> <low key> <high key> <low velocity> <high velocity> <root note>
+// [<loop start> <loop end> [<crossfade>]]", where the loop points may both be
+// "-" to keep the file's own loop (and "0 0" drops it).
+// Relative WAV paths are resolved against the manifest's directory.
+std::vector<BankZoneSpec> readBankManifest(const std::string& path);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Resampler.h"
+#include "SampleBank.h"
+#include "WavFile.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Everything that shapes the engine-ready data besides the source file.
+// Changing any of it selects a different cache entry.
+struct SampleCacheSettings {
+    int sampleRate = 0; // engine rate the sample is converted to
+    SampleFormat format = SampleFormat::Float32;
+    ResampleOptions resample; // `threads` does not affect the result and is not part of the key
+    // Loop in source frames replacing the file's `smpl` loop, and the
+    // crossfade baked into it (see crossfadeLoop()).
+    bool explicitLoop = false;
+    size_t loopStart = 0;
+    size_t loopEnd = 0;
+    size_t crossfadeFrames = 0;
+};
+
+// A single-sample bank served by SampleCache. `bank` points into the mapped
+// cache entry, or into the in-memory storage below when no entry could be
+// written.
+struct CachedSample {
+    SampleBank bank;
+    bool hit = false;
+    std::vector<float> samples;
+    std::vector<std::vector<int16_t>> compactStorage;
+};
+
+// Persistent cache of decoded, rate-converted samples. An entry holds one
+// zone exactly as the mix kernels read it (interleaved floats or aligned
+// int16 planes), so a warm load only maps the file. Entries are named after
+// a hash of the source contents and the settings; a small per-path record of
+// size and modification time avoids rehashing unchanged sources. Entries are
+// written to a temporary file and renamed, so concurrent players never see a
+// partial one.
+class SampleCache {
+public:
+    using Decoder = std::function<WavData(const std::string&)>;
+
+    // An empty directory disables the cache; every load then decodes.
+    explicit SampleCache(std::string directory = defaultDirectory());
+
+    // $XDG_CACHE_HOME/wave-player, else ~/.cache/wave-player
+    // (~/Library/Caches/wave-player on macOS); empty without a home directory.
+    static std::string defaultDirectory();
+
+    // Loads `path` at `settings`, decoding with `decode` and storing a new
+    // entry on a miss. Throws whatever `decode` throws.
+    CachedSample load(const std::string& path,
+                      const SampleCacheSettings& settings,
+                      int rootNote,
+                      const Decoder& decode = readWav) const;
+
+    // The entry for `path` at `settings` if there is one, without decoding,
+    // hashing or writing anything: a source whose size or modification time
+    // differs from its record counts as a miss until load() sees it again.
+    std::optional<CachedSample> find(const std::string& path, const SampleCacheSettings& settings, int rootNote) const;
+
+    const std::string& directory() const { return directory_; }
+
+private:
+    std::string directory_;
+};
+
+// 64-bit hash of `size` bytes, used for cache keys (not cryptographic).
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
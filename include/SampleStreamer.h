@@ -0,0 +1,117 @@
+#pragma once
+
+#include "SampleBank.h"
+#include "Semaphore.h"
+#include "WavFile.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A WAV file played from disk: the first `headFrames` are decoded into memory
+// so notes can start immediately, the rest is read on demand by the
+// SampleStreamer I/O thread. A `smpl` loop extends the head to the loop end.
+class StreamingSample {
+public:
+    static constexpr size_t kMinHeadFrames = 64;
+
+    StreamingSample(const std::string& path, size_t headFrames, int rootNote); // throws
+    ~StreamingSample();
+
+    StreamingSample(const StreamingSample&) = delete;
+    StreamingSample& operator=(const StreamingSample&) = delete;
+
+    const SampleZone& zone() const { return zone_; }
+    const float* lastFrame() const { return lastFrame_.data(); }
+
+    // Decodes frames [first, first + count) into `out`. I/O thread only.
+    size_t read(size_t first, size_t count, float* out, std::vector<unsigned char>& scratch) const;
+
+private:
+    int fd_ = -1;
+    WavFormat format_;
+    std::vector<float> head_;
+    std::vector<float> lastFrame_;
+    SampleZone zone_;
+};
+
+// Background reader that keeps one ring buffer per voice filled ahead of the
+// voice's play position. The audio thread only publishes positions, reads
+// already-filled frames and posts a semaphore when the reader has work; it
+// never waits on the I/O thread, which sleeps on that semaphore when idle.
+class SampleStreamer {
+public:
+    struct Config {
+        size_t ringFrames = size_t{1} << 16; // rounded up to a power of two
+        size_t chunkFrames = 4096;           // frames per disk read
+        size_t prefetchFrames = 8192;        // lead kept ahead at unit pitch step
+    };
+
+    // Readable frames [begin, end) backed by `data`, where frame f lives at
+    // data + (f - first) * channels; `begin` may lie up to kGuardFrames before
+    // `first`.
+    struct Window {
+        const float* data = nullptr;
+        size_t first = 0;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    // Frames mirrored on both sides of each ring so interpolation taps can run
+    // over the wrap point, and history the writer leaves intact behind the
+    // published read position.
+    static constexpr size_t kGuardFrames = 8;
+    // Streams start this far before the end of the resident head so that
+    // interpolators switching over still find their history taps.
+    static constexpr size_t kHistoryFrames = 2 * kGuardFrames;
+
+    SampleStreamer(int slotCount, int maxChannels, Config config);
+    ~SampleStreamer();
+
+    SampleStreamer(const SampleStreamer&) = delete;
+    SampleStreamer& operator=(const SampleStreamer&) = delete;
+
+    // Audio thread only.
+    void start(int slot, const SampleZone& zone, size_t firstFrame, double step);
+    void stop(int slot);
+    void setReadPosition(int slot, size_t frame);
+    bool window(int slot, size_t frame, Window& out) const;
+    void countUnderrun() { underruns_.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        // Parameters are written by the audio thread between two generation
+        // bumps (odd while being written) and read seqlock-style by the I/O thread.
+        std::atomic<uint32_t> generation{0};
+        std::atomic<const SampleZone*> zone{nullptr};
+        std::atomic<uint64_t> firstFrame{0};
+        std::atomic<double> step{1.0};
+        std::atomic<uint64_t> readFrame{0};
+        // (generation & 0xffff) << 48 | frames filled so far.
+        std::atomic<uint64_t> filled{0};
+        std::vector<float> ring;
+
+        // I/O thread state.
+        uint32_t seenGeneration = 0;
+        uint64_t writeFrame = 0;
+    };
+
+    void wake();
+    bool service(Slot& slot, std::vector<float>& decoded, std::vector<unsigned char>& scratch);
+    void run();
+
+    Config config_;
+    int maxChannels_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::atomic<uint64_t> underruns_{0};
+    std::atomic<bool> running_{true};
+    std::atomic<bool> wakePending_{false}; // a post the reader has not consumed yet
+    Semaphore wakeup_;
+    std::thread thread_;
+};
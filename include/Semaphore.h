@@ -0,0 +1,43 @@
+#pragma once
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+// Counting semaphore for waking background workers from the audio thread:
+// post() takes no lock and never blocks (a futex or Mach semaphore signal,
+// and only a system call when someone is waiting), so the real-time side
+// can call it; wait() blocks until a post is available. macOS has no
+// unnamed POSIX semaphores, so it uses a dispatch semaphore.
+class Semaphore {
+public:
+#if defined(__APPLE__)
+    Semaphore() : semaphore_(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(semaphore_); }
+
+    void post() { dispatch_semaphore_signal(semaphore_); }
+    void wait() { dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER); }
+#else
+    Semaphore() { sem_init(&semaphore_, 0, 0); }
+    ~Semaphore() { sem_destroy(&semaphore_); }
+
+    void post() { sem_post(&semaphore_); }
+    void wait() {
+        while (sem_wait(&semaphore_) != 0 && errno == EINTR) {
+        }
+    }
+#endif
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+private:
+#if defined(__APPLE__)
+    dispatch_semaphore_t semaphore_;
+#else
+    sem_t semaphore_;
+#endif
+};
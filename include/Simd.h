@@ -0,0 +1,296 @@
+#pragma once
+
+// Minimal 4-lane float vector used by the mix kernels. Maps onto SSE on x86,
+// NEON on ARM and a plain array elsewhere; the scalar fallback can be forced
+// with WAVE_DISABLE_SIMD for comparison runs. On x86 with GCC or Clang,
+// WAVE_SIMD_AVX2 also allows 8-lane kernels selected at run time.
+
+#if !defined(WAVE_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define WAVE_SIMD_SSE 1
+#include <immintrin.h>
+#elif !defined(WAVE_DISABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define WAVE_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define WAVE_SIMD_SCALAR 1
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+namespace simd {
+
+constexpr int kLanes = 4;
+
+// 32.32 fixed-point positions keep 24 bits of their fraction, as many as a
+// float holds; truncating instead of rounding keeps it below 1.
+constexpr int kFixedFractionShift = 8;
+constexpr float kFixedFractionScale = 1.0f / 16777216.0f;
+
+#if defined(WAVE_SIMD_SSE)
+
+struct Float4 {
+    __m128 v;
+};
+
+inline Float4 load(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 broadcast(float x) { return {_mm_set1_ps(x)}; }
+inline Float4 set(float a, float b, float c, float d) { return {_mm_setr_ps(a, b, c, d)}; }
+inline Float4 add(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 sub(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 mul(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+
+// {a[0], a[1], b[0], b[1]}
+inline Float4 loadPairs(const float* a, const float* b) {
+    const __m128 low = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(a));
+    return {_mm_loadh_pi(low, reinterpret_cast<const __m64*>(b))};
+}
+// {x0, x2, y0, y2}
+inline Float4 evenLanes(Float4 x, Float4 y) { return {_mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(2, 0, 2, 0))}; }
+// {x1, x3, y1, y3}
+inline Float4 oddLanes(Float4 x, Float4 y) { return {_mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(3, 1, 3, 1))}; }
+inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+inline float sum(Float4 a) {
+    const __m128 pairs = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+// Four little-endian integers at any alignment, converted without scaling.
+inline Float4 convertInt16(const void* p) {
+    const __m128i x = _mm_loadl_epi64(static_cast<const __m128i*>(p));
+    return {_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16))};
+}
+inline Float4 convertInt32(const void* p) {
+    return {_mm_cvtepi32_ps(_mm_loadu_si128(static_cast<const __m128i*>(p)))};
+}
+// Eight integers into two vectors.
+inline void convertInt16x8(const void* p, Float4& low, Float4& high) {
+    const __m128i x = _mm_loadu_si128(static_cast<const __m128i*>(p));
+    low = {_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16))};
+    high = {_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16))};
+}
+// Two consecutive int16 samples at each of four addresses: lane i of `first`
+// and `second` gets p[i][0] and p[i][1]. One 32-bit load per lane.
+inline void convertInt16Pairs(const int16_t* const* p, Float4& first, Float4& second) {
+    // Assembled in registers; four scalar stores and a vector reload would
+    // stall on store forwarding.
+    __m128i words[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        int32_t word;
+        std::memcpy(&word, p[lane], sizeof(word));
+        words[lane] = _mm_cvtsi32_si128(word);
+    }
+    const __m128i x = _mm_unpacklo_epi64(_mm_unpacklo_epi32(words[0], words[1]), _mm_unpacklo_epi32(words[2], words[3]));
+    first = {_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(x, 16), 16))};
+    second = {_mm_cvtepi32_ps(_mm_srai_epi32(x, 16))};
+}
+
+// Splits the positions p, p + step, p + 2 step, p + 3 step into integer
+// indices and fractional parts. Positions must be below 2^31.
+inline Float4 splitPositions(double position, double step, int* indices) {
+    const __m128d stepPair = _mm_set1_pd(2.0 * step);
+    const __m128d low = _mm_setr_pd(position, position + step);
+    const __m128d high = _mm_add_pd(low, stepPair);
+    const __m128i lowIndex = _mm_cvttpd_epi32(low);
+    const __m128i highIndex = _mm_cvttpd_epi32(high);
+    const __m128 lowFrac = _mm_cvtpd_ps(_mm_sub_pd(low, _mm_cvtepi32_pd(lowIndex)));
+    const __m128 highFrac = _mm_cvtpd_ps(_mm_sub_pd(high, _mm_cvtepi32_pd(highIndex)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_unpacklo_epi64(lowIndex, highIndex));
+    return {_mm_movelh_ps(lowFrac, highFrac)};
+}
+
+// splitPositions for 32.32 fixed-point positions: each index is a high word
+// and each fraction the top of a low word, exactly as the scalar split.
+// Indices must be below 2^31.
+inline Float4 splitPhases(uint64_t phase, uint64_t step, int* indices) {
+    const __m128i low = _mm_set_epi64x(static_cast<long long>(phase + step), static_cast<long long>(phase));
+    const __m128i high = _mm_add_epi64(low, _mm_set1_epi64x(static_cast<long long>(2 * step)));
+    const __m128 lowWords = _mm_castsi128_ps(low);
+    const __m128 highWords = _mm_castsi128_ps(high);
+    const __m128i index = _mm_castps_si128(_mm_shuffle_ps(lowWords, highWords, _MM_SHUFFLE(3, 1, 3, 1)));
+    const __m128i fraction = _mm_castps_si128(_mm_shuffle_ps(lowWords, highWords, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), index);
+    return {_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(fraction, kFixedFractionShift)),
+                       _mm_set1_ps(kFixedFractionScale))};
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+// Kernels marked WAVE_TARGET_AVX2 are compiled for AVX2 whatever the build
+// flags say; only call them when hasAvx2().
+#define WAVE_SIMD_AVX2 1
+#define WAVE_TARGET_AVX2 __attribute__((target("avx2")))
+
+inline bool hasAvx2() {
+    static const bool available = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return available;
+}
+#endif
+
+#elif defined(WAVE_SIMD_NEON)
+
+struct Float4 {
+    float32x4_t v;
+};
+
+inline Float4 load(const float* p) { return {vld1q_f32(p)}; }
+inline void store(float* p, Float4 a) { vst1q_f32(p, a.v); }
+inline Float4 broadcast(float x) { return {vdupq_n_f32(x)}; }
+inline Float4 set(float a, float b, float c, float d) {
+    const float lanes[4] = {a, b, c, d};
+    return {vld1q_f32(lanes)};
+}
+inline Float4 add(Float4 a, Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float4 sub(Float4 a, Float4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float4 mul(Float4 a, Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {vminq_f32(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+
+inline Float4 loadPairs(const float* a, const float* b) { return {vcombine_f32(vld1_f32(a), vld1_f32(b))}; }
+inline Float4 evenLanes(Float4 x, Float4 y) { return {vuzpq_f32(x.v, y.v).val[0]}; }
+inline Float4 oddLanes(Float4 x, Float4 y) { return {vuzpq_f32(x.v, y.v).val[1]}; }
+inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) {
+    const float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+    const float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+    a.v = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+    b.v = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+    c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+    d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+inline float sum(Float4 a) {
+    const float32x2_t pairs = vadd_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+    return vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+}
+
+// Four little-endian integers at any alignment, converted without scaling.
+inline Float4 convertInt16(const void* p) {
+    return {vcvtq_f32_s32(vmovl_s16(vreinterpret_s16_u8(vld1_u8(static_cast<const uint8_t*>(p)))))};
+}
+inline Float4 convertInt32(const void* p) {
+    return {vcvtq_f32_s32(vreinterpretq_s32_u8(vld1q_u8(static_cast<const uint8_t*>(p))))};
+}
+inline void convertInt16x8(const void* p, Float4& low, Float4& high) {
+    const int16x8_t x = vreinterpretq_s16_u8(vld1q_u8(static_cast<const uint8_t*>(p)));
+    low = {vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)))};
+    high = {vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)))};
+}
+inline void convertInt16Pairs(const int16_t* const* p, Float4& first, Float4& second) {
+    int32_t words[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        std::memcpy(&words[lane], p[lane], sizeof(int32_t));
+    }
+    const int32x4_t x = vld1q_s32(words);
+    first = {vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(x, 16), 16))};
+    second = {vcvtq_f32_s32(vshrq_n_s32(x, 16))};
+}
+
+inline Float4 splitPhases(uint64_t phase, uint64_t step, int* indices) {
+    const uint64x2_t low = vcombine_u64(vcreate_u64(phase), vcreate_u64(phase + step));
+    const uint64x2_t high = vaddq_u64(low, vdupq_n_u64(2 * step));
+    const uint32x4_t index = vcombine_u32(vshrn_n_u64(low, 32), vshrn_n_u64(high, 32));
+    const uint32x4_t fraction = vcombine_u32(vmovn_u64(low), vmovn_u64(high));
+    vst1q_s32(indices, vreinterpretq_s32_u32(index));
+    return {vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(fraction, kFixedFractionShift)), kFixedFractionScale)};
+}
+
+#else
+
+struct Float4 {
+    float v[4];
+};
+
+inline Float4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, Float4 a) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = a.v[i];
+    }
+}
+inline Float4 broadcast(float x) { return {{x, x, x, x}}; }
+inline Float4 set(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+inline Float4 add(Float4 a, Float4 b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+inline Float4 sub(Float4 a, Float4 b) { return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; }
+inline Float4 mul(Float4 a, Float4 b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+inline Float4 min(Float4 a, Float4 b) {
+    return {{a.v[0] < b.v[0] ? a.v[0] : b.v[0], a.v[1] < b.v[1] ? a.v[1] : b.v[1],
+             a.v[2] < b.v[2] ? a.v[2] : b.v[2], a.v[3] < b.v[3] ? a.v[3] : b.v[3]}};
+}
+inline Float4 max(Float4 a, Float4 b) {
+    return {{a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1],
+             a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3]}};
+}
+
+inline Float4 loadPairs(const float* a, const float* b) { return {{a[0], a[1], b[0], b[1]}}; }
+inline Float4 evenLanes(Float4 x, Float4 y) { return {{x.v[0], x.v[2], y.v[0], y.v[2]}}; }
+inline Float4 oddLanes(Float4 x, Float4 y) { return {{x.v[1], x.v[3], y.v[1], y.v[3]}}; }
+inline void transpose(Float4& a, Float4& b, Float4& c, Float4& d) {
+    const Float4 rows[4] = {a, b, c, d};
+    a = {{rows[0].v[0], rows[1].v[0], rows[2].v[0], rows[3].v[0]}};
+    b = {{rows[0].v[1], rows[1].v[1], rows[2].v[1], rows[3].v[1]}};
+    c = {{rows[0].v[2], rows[1].v[2], rows[2].v[2], rows[3].v[2]}};
+    d = {{rows[0].v[3], rows[1].v[3], rows[2].v[3], rows[3].v[3]}};
+}
+inline float sum(Float4 a) { return (a.v[0] + a.v[2]) + (a.v[1] + a.v[3]); }
+
+inline Float4 convertInt16(const void* p) {
+    const auto* bytes = static_cast<const uint8_t*>(p);
+    Float4 result;
+    for (int lane = 0; lane < 4; ++lane) {
+        result.v[lane] = static_cast<float>(static_cast<int16_t>(bytes[2 * lane] | (bytes[2 * lane + 1] << 8)));
+    }
+    return result;
+}
+inline Float4 convertInt32(const void* p) {
+    const auto* bytes = static_cast<const uint8_t*>(p);
+    Float4 result;
+    for (int lane = 0; lane < 4; ++lane) {
+        const uint32_t value = static_cast<uint32_t>(bytes[4 * lane]) | (static_cast<uint32_t>(bytes[4 * lane + 1]) << 8) |
+                               (static_cast<uint32_t>(bytes[4 * lane + 2]) << 16) |
+                               (static_cast<uint32_t>(bytes[4 * lane + 3]) << 24);
+        result.v[lane] = static_cast<float>(static_cast<int32_t>(value));
+    }
+    return result;
+}
+inline void convertInt16x8(const void* p, Float4& low, Float4& high) {
+    low = convertInt16(p);
+    high = convertInt16(static_cast<const uint8_t*>(p) + 8);
+}
+inline void convertInt16Pairs(const int16_t* const* p, Float4& first, Float4& second) {
+    for (int lane = 0; lane < 4; ++lane) {
+        first.v[lane] = static_cast<float>(p[lane][0]);
+        second.v[lane] = static_cast<float>(p[lane][1]);
+    }
+}
+
+inline Float4 splitPositions(double position, double step, int* indices) {
+    float fractions[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        const double p = position + static_cast<double>(lane) * step;
+        indices[lane] = static_cast<int>(p);
+        fractions[lane] = static_cast<float>(p - static_cast<double>(indices[lane]));
+    }
+    return load(fractions);
+}
+
+inline Float4 splitPhases(uint64_t phase, uint64_t step, int* indices) {
+    float fractions[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        const uint64_t p = phase + static_cast<uint64_t>(lane) * step;
+        indices[lane] = static_cast<int>(p >> 32);
+        fractions[lane] = static_cast<float>(static_cast<uint32_t>(p) >> kFixedFractionShift) * kFixedFractionScale;
+    }
+    return load(fractions);
+}
+
+#endif
+
+// a + b * c
+inline Float4 madd(Float4 a, Float4 b, Float4 c) { return add(a, mul(b, c)); }
+
+inline Float4 clamp(Float4 x, float lo, float hi) { return min(max(x, broadcast(lo)), broadcast(hi)); }
+
+} // namespace simd
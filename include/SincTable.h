@@ -0,0 +1,105 @@
+#pragma once
+
+// Polyphase Kaiser-windowed sinc coefficients, generated at compile time.
+// Each level is a low-pass for one octave of pitch step (level L serves steps
+// up to 2^L), so transposing upwards filters out what would otherwise alias;
+// rows are fractional phases, with one extra row so the kernel can interpolate
+// between neighbouring phases.
+namespace mix {
+
+constexpr int kSincTaps = 16;
+constexpr int kSincPhases = 128;
+constexpr int kSincLevels = 5;
+
+struct SincTable {
+    alignas(16) float coefficients[kSincLevels][kSincPhases + 1][kSincTaps];
+};
+
+namespace detail {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kKaiserBeta = 7.0;
+constexpr double kPassband = 0.40; // cutoff at unit step, in cycles per input frame
+
+constexpr double constexprSin(double x) {
+    const double turns = x / (2.0 * kPi);
+    const double whole = static_cast<double>(static_cast<long long>(turns + (turns >= 0.0 ? 0.5 : -0.5)));
+    x -= whole * 2.0 * kPi;
+    double term = x;
+    double result = x;
+    for (int n = 1; n < 14; ++n) {
+        term *= -x * x / static_cast<double>((2 * n) * (2 * n + 1));
+        result += term;
+    }
+    return result;
+}
+
+constexpr double constexprSqrt(double x) {
+    if (x <= 0.0) {
+        return 0.0;
+    }
+    double r = x > 1.0 ? x : 1.0;
+    for (int i = 0; i < 64; ++i) {
+        r = 0.5 * (r + x / r);
+    }
+    return r;
+}
+
+// Modified Bessel function of the first kind, order zero.
+constexpr double besselI0(double x) {
+    double term = 1.0;
+    double result = 1.0;
+    for (int k = 1; k < 40; ++k) {
+        const double factor = x / (2.0 * static_cast<double>(k));
+        term *= factor * factor;
+        result += term;
+    }
+    return result;
+}
+
+constexpr double windowedSinc(double x, double cutoff) {
+    constexpr double kHalfWidth = kSincTaps / 2;
+    if (x <= -kHalfWidth || x >= kHalfWidth) {
+        return 0.0;
+    }
+    const double ratio = x / kHalfWidth;
+    const double window = besselI0(kKaiserBeta * constexprSqrt(1.0 - ratio * ratio)) / besselI0(kKaiserBeta);
+    const double arg = 2.0 * cutoff * x;
+    const double sinc = arg == 0.0 ? 1.0 : constexprSin(kPi * arg) / (kPi * arg);
+    return 2.0 * cutoff * sinc * window;
+}
+
+constexpr SincTable makeSincTable() {
+    SincTable table{};
+    for (int level = 0; level < kSincLevels; ++level) {
+        const double cutoff = kPassband / static_cast<double>(1 << level);
+        for (int phase = 0; phase <= kSincPhases; ++phase) {
+            const double fraction = static_cast<double>(phase) / kSincPhases;
+            double taps[kSincTaps] = {};
+            double total = 0.0;
+            for (int tap = 0; tap < kSincTaps; ++tap) {
+                taps[tap] = windowedSinc(static_cast<double>(tap - (kSincTaps / 2 - 1)) - fraction, cutoff);
+                total += taps[tap];
+            }
+            // Unity gain at DC for every phase, so a held signal stays flat.
+            for (int tap = 0; tap < kSincTaps; ++tap) {
+                table.coefficients[level][phase][tap] = static_cast<float>(taps[tap] / total);
+            }
+        }
+    }
+    return table;
+}
+
+} // namespace detail
+
+inline constexpr SincTable kSincTable = detail::makeSincTable();
+
+inline int sincLevelFor(double step) {
+    int level = 0;
+    while (level + 1 < kSincLevels && step > static_cast<double>(1 << level)) {
+        ++level;
+    }
+    return level;
+}
+
+} // namespace mix
@@ -1,62 +1,334 @@
 #pragma once
 
+#include "Convolver.h"
+#include "Envelope.h"
+#include "EventQueue.h"
+#include "Interpolation.h"
+#include "PitchCache.h"
+#include "RenderPool.h"
+#include "SampleBank.h"
+#include "SampleStreamer.h"
+
 #include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <vector>
 
+namespace mix {
+struct GainRamp;
+}
+
+// Voices that cannot be heard are virtualized: for that block their playhead
+// and envelope move on as usual but nothing is interpolated or mixed, and
+// they are rendered again as soon as they would be audible. A voice is
+// inaudible below `floorDb` dBFS of envelope gain, and masked when its gain is
+// under `maskDb` relative to the average of all voice gains; the masked voices
+// together then stay at least `maskDb` below the summed gain. Voices in
+// their attack are always rendered.
+struct VirtualizationSettings {
+    bool enabled = true;
+    double maskDb = -40.0;
+    double floorDb = -70.0;
+};
+
 class VoiceManager {
 public:
+    static constexpr int kDefaultMaxVoices = 32;
+
+    // Single-sample instrument; every key pitch-shifts `sampleData`, which
+    // must outlive the manager. `maxVoices` fixes the polyphony; all voice
+    // storage is allocated here. With `renderThreads` > 1, mix() spreads the
+    // voices over a RenderPool of that many threads (the caller included).
     VoiceManager(const std::vector<float>& sampleData,
                  int sampleRate,
                  int channels,
                  int outputChannels,
-                 int baseNote);
+                 int baseNote,
+                 int maxVoices = kDefaultMaxVoices,
+                 int renderThreads = 1);
+
+    // Multi-sample instrument running at `sampleRate`. Voices read straight
+    // from the bank's zones, so the bank must outlive the manager.
+    VoiceManager(const SampleBank& bank,
+                 int sampleRate,
+                 int outputChannels,
+                 int maxVoices = kDefaultMaxVoices,
+                 int renderThreads = 1);
+
+    // Replaces the instrument while audio runs. Notes started from the next
+    // mix() call on use `bank`; voices already sounding finish on the bank
+    // they started with. The shared_ptr must also keep the bank's sample
+    // data alive (see the aliasing constructor). mix() only swaps a pointer
+    // and records the oldest bank its voices still read; superseded banks
+    // are released here or in reclaimBanks(), on the caller's thread, once
+    // no voice reads them. Safe from any thread but the audio thread.
+    // Streamed zones cannot be swapped in; throws std::runtime_error.
+    void publishBank(std::shared_ptr<const SampleBank> bank);
+    // publishBank() for one interleaved sample covering every key.
+    void publishSample(std::vector<float> samples,
+                       int sampleRate,
+                       int channels,
+                       int rootNote,
+                       size_t loopStart = 0,
+                       size_t loopEnd = 0);
+    // Releases superseded banks no voice reads any more; returns how many
+    // are still held.
+    size_t reclaimBanks();
+
+    // Events land on an absolute output frame (see renderedFrames()); mix()
+    // splits its blocks there, so onsets are exact whatever the buffer size.
+    // kNow, or any frame already rendered, applies at the start of the next
+    // mix() call. Events are queued, so these never block and are safe from
+    // any thread.
+    static constexpr uint64_t kNow = 0;
 
-    void noteOn(int midiNote);
-    void noteOff(int midiNote);
-    void stopAll();
+    void noteOn(int midiNote, int velocity = 127, uint64_t frame = kNow);
+    void noteOff(int midiNote, uint64_t frame = kNow);
+    void stopAll(uint64_t frame = kNow);
 
+    // Renders voice-major in blocks of kBlockSize frames, cut short wherever a
+    // scheduled event falls. Output matches the
+    // former frame-major loop to within 1e-5 per sample (gain ramps and
+    // positions are now computed as start + k * step rather than accumulated).
+    // Multi-threaded rendering sums fixed voice chunks in chunk order, so its
+    // output is bit-identical for any thread count above one.
     void mix(float* output, int frameCount);
 
+    // Resampler used from the next block on; safe from any thread. Linear by default.
+    void setInterpolation(mix::Interpolation mode) { interpolation_.store(mode, std::memory_order_relaxed); }
+    mix::Interpolation interpolation() const { return interpolation_.load(std::memory_order_relaxed); }
+
+    // Position format for notes started from now on; safe from any thread.
+    // Double by default.
+    void setPhaseFormat(mix::PhaseFormat format) { phaseFormat_.store(format, std::memory_order_relaxed); }
+    mix::PhaseFormat phaseFormat() const { return phaseFormat_.load(std::memory_order_relaxed); }
+
+    // Applies from the next block on; safe from any thread.
+    void setVirtualization(const VirtualizationSettings& settings);
+
+    // Plays repeated notes from pre-pitched copies (see PitchCache) within
+    // `settings.budgetBytes`; a zero budget turns the cache off, which is the
+    // default. Call before the audio callback starts.
+    void setPitchCache(const PitchCacheSettings& settings);
+    PitchCache::Stats pitchCacheStats() const { return pitchCache_ ? pitchCache_->stats() : PitchCache::Stats{}; }
+
+    // Sends the mix through a convolution reverb with `impulse` (see
+    // Convolver) and adds it back before the output clamp; an empty impulse
+    // response turns the send off, which is the default. Call before the
+    // audio callback starts. Throws std::runtime_error.
+    void setReverb(const ImpulseResponse& impulse, const ReverbSettings& settings = {});
+    uint64_t reverbLateBlocks() const { return reverb_ ? reverb_->lateBlocks() : 0; }
+
+    // Amplitude envelope for notes started from now on (sounding voices move
+    // onto the new segments at their next stage change). Unlike the calls
+    // above this is not synchronised with mix(): set it before the audio
+    // callback starts, or from the thread that calls mix().
+    void setEnvelope(const EnvelopeSettings& envelope);
+    const EnvelopeSettings& envelope() const { return envelope_; }
+
     int outputChannels() const { return outputChannels_; }
+    int sampleRate() const { return sampleRate_; }
+    int maxVoices() const { return static_cast<int>(voices_.size()); }
+    int renderThreads() const { return renderPool_ ? renderPool_->threadCount() : 1; }
+    // Audio-thread view; only meaningful from the thread that calls mix().
+    int activeVoiceCount() const;
+    // Active voices that were virtualized in the last block; audio thread only.
+    int virtualVoiceCount() const { return virtualVoices_; }
+    // Frames rendered so far, i.e. the frame the next mix() call starts on.
+    uint64_t renderedFrames() const { return renderedFrames_.load(std::memory_order_acquire); }
+    uint64_t droppedEvents() const { return droppedEvents_.load(std::memory_order_relaxed); }
+    // Note-ons that had to take a sounding voice because none was free.
+    uint64_t voiceSteals() const { return voiceSteals_.load(std::memory_order_relaxed); }
+    // Blocks in which a streamed voice ran ahead of the disk reader.
+    uint64_t streamUnderruns() const { return streamer_ ? streamer_->underruns() : 0; }
+    // Blocks in which a voice caught up with a sample still being decoded.
+    uint64_t decodeWaits() const { return decodeWaits_.load(std::memory_order_relaxed); }
 
 private:
     enum class Stage {
         Idle,
         Attack,
+        Decay,
         Sustain,
         Release
     };
 
+    enum class CommandType {
+        NoteOn,
+        NoteOff,
+        StopAll
+    };
+
+    struct Command {
+        CommandType type = CommandType::NoteOn;
+        int note = 0;
+        int velocity = 0;
+        uint64_t frame = kNow;
+    };
+
     struct Voice {
         Stage stage = Stage::Idle;
         int note = 0;
+        const SampleZone* zone = nullptr;
         double position = 0.0;
         double step = 1.0;
+        uint64_t fixedPosition = 0; // 32.32, used instead of position/step when fixedPhase
+        uint64_t fixedStep = 0;
+        bool fixedPhase = false;
+        bool virtualized = false; // skip interpolation for the current block
+        uint64_t bankEpoch = 0;   // epoch of the bank `zone` belongs to
+        int pitchEntry = -1;      // PitchCache entry `zone` points into, or -1
         float gain = 0.0f;
+
+        // Links in heldVoices_ (attack/decay/sustain) or releasingVoices_, oldest first.
+        int previous = -1;
+        int next = -1;
+        int activeSlot = -1; // index in activeVoices_
+        bool releaseQueued = false; // ran out of sample while rendering; lists not yet updated
+    };
+
+    // Intrusive doubly linked list threaded through Voice::previous/next.
+    struct VoiceList {
+        int head = -1;
+        int tail = -1;
     };
 
-    double computeStepFor(int midiNote) const;
-    int findVoiceFor(int midiNote);
-    int findFreeVoice();
-    int stealVoice();
-    void beginRelease(Voice& voice);
+    struct MixBus {
+        float* left;
+        float* right;
+        float* mono; // mono-input voices, added to both sides on output
+    };
 
-    void advanceEnvelope(Voice& voice);
+    // Per-frame recurrence of one envelope stage, run until the gain crosses
+    // `end`: linear stages add `slope`, exponential ones approach `target` by
+    // `ratio` (logRatio = ln ratio), overshooting `end` so they finish in the
+    // stage's time rather than asymptotically.
+    struct Segment {
+        bool exponential = false;
+        float slope = 0.0f;
+        float target = 0.0f;
+        float ratio = 1.0f;
+        float logRatio = 0.0f;
+        float end = 0.0f;
+    };
 
-    const std::vector<float>& sampleData_;
+    // A bank handed to publishBank(); epochs count up from the one the
+    // manager was created with.
+    struct PublishedBank {
+        std::shared_ptr<const SampleBank> bank;
+        uint64_t epoch = 0;
+    };
+
+    // Parameters shared with the render workers for one block.
+    struct RenderJob {
+        mix::Interpolation mode = mix::Interpolation::Linear;
+        int frames = 0;
+        int chunks = 0;
+    };
+
+    void initialise(const SampleBank& bank, int maxVoices, int renderThreads);
+    void adoptPublishedBank();
+    void publishOldestEpoch();
+    size_t reclaimBanksLocked();
+    void postCommand(CommandType type, int midiNote, int velocity, uint64_t frame);
+    void drainCommands();
+    void applyCommand(const Command& command);
+    void startNote(int midiNote, int velocity);
+    void releaseNote(int midiNote);
+    void silenceAll();
+
+    double computeStepFor(int midiNote, const SampleZone& zone) const;
+    int acquireVoice();
+    void detachVoice(int index);
+    void retireVoice(int index);
+    void beginRelease(int index);
+    void pushBack(VoiceList& list, int index);
+    void unlink(VoiceList& list, int index);
+
+    void renderBlock(float* output, int frames);
+    void virtualizeVoices();
+    void renderParallel(mix::Interpolation mode, int frames);
+    static void renderChunk(void* context, int chunk);
+    void renderRange(mix::Interpolation mode, size_t begin, size_t end, int frames, const MixBus& bus);
+    template <mix::Interpolation Mode>
+    void renderVoices(size_t begin, size_t end, int frames, const MixBus& bus);
+    template <mix::Interpolation Mode, int InputChannels, bool WantRight>
+    void renderVoiceAs(Voice& voice, int slot, int frames, const MixBus& bus);
+    template <mix::Interpolation Mode, int InputChannels, bool WantRight, SampleFormat Format>
+    void renderVoiceWith(Voice& voice, int slot, int frames, const MixBus& bus);
+    template <mix::Interpolation Mode, int InputChannels, bool WantRight, SampleFormat Format, typename Phase>
+    void renderVoice(Voice& voice, int slot, int frames, const MixBus& bus);
+    template <int InputChannels, bool WantRight>
+    void renderPrepitched(Voice& voice, int frames, const MixBus& bus);
+    void settleVoices();
+    const Segment* segmentFor(Stage stage) const;
+    mix::GainRamp rampFor(const Voice& voice) const;
+    int framesUntilStageEnd(const Voice& voice) const;
+    void finishStage(Voice& voice);
+
+    SampleBank ownedBank_;
+    const SampleBank* bank_ = nullptr; // audio thread's view of currentBank_
+    uint64_t bankEpoch_ = 0;
     int sampleRate_;
-    int channels_;
     int outputChannels_;
-    int baseNote_;
-    int sampleFrames_;
 
-    float attackIncrement_;
-    float releaseIncrement_;
+    EnvelopeSettings envelope_;
+    Segment attack_;
+    Segment decay_;
+    Segment release_;
+    float sustainLevel_ = 1.0f;
+
+    static constexpr size_t kCommandQueueSize = 1024;
+    static constexpr int kBlockSize = 256;
+    static constexpr int kMidiNotes = 128;
+    static constexpr size_t kMaxRenderChunks = 32;
+    static constexpr size_t kMinParallelVoices = 4;
+
+    // Voice bookkeeping; every note event touches these in O(1). Idle voices
+    // sit on the free stack, sounding ones in the dense active list that
+    // rendering walks, and at most one voice per note is held.
+    std::vector<Voice> voices_;
+    std::vector<int> freeVoices_;
+    std::vector<int> activeVoices_;
+    std::array<int, kMidiNotes> heldVoiceForNote_{};
+    VoiceList heldVoices_;
+    VoiceList releasingVoices_;
+
+    alignas(64) std::array<float, kBlockSize> busLeft_{};
+    alignas(64) std::array<float, kBlockSize> busRight_{};
+    alignas(64) std::array<float, kBlockSize> busMono_{};
+    EventQueue<Command> commands_{kCommandQueueSize};
+    std::vector<Command> scheduled_; // drained commands by frame, posting order within a frame
+    uint64_t clock_ = 0;             // audio thread's copy of renderedFrames_
+    std::atomic<uint64_t> renderedFrames_{0};
+    std::atomic<uint64_t> droppedEvents_{0};
+    std::atomic<uint64_t> voiceSteals_{0};
+    std::atomic<uint64_t> decodeWaits_{0};
+    std::atomic<mix::Interpolation> interpolation_{mix::Interpolation::Linear};
+    std::atomic<mix::PhaseFormat> phaseFormat_{mix::PhaseFormat::Double};
+    std::atomic<float> maskRatio_{0.0f}; // 0 disables the corresponding test
+    std::atomic<float> floorGain_{0.0f};
+    int virtualVoices_ = 0;
+    std::unique_ptr<SampleStreamer> streamer_; // only when the bank has streamed zones
+
+    // Epoch-based reclamation of swapped-out banks: publishers append to
+    // publishedBanks_ (oldest first, the last one current) under the mutex,
+    // which the audio thread never takes; it only loads currentBank_ and
+    // stores the oldest epoch its voices still use.
+    std::mutex publishMutex_;
+    std::vector<std::unique_ptr<PublishedBank>> publishedBanks_;
+    std::atomic<const PublishedBank*> currentBank_{nullptr};
+    std::atomic<uint64_t> oldestEpochInUse_{0};
+
+    // Declared after the banks so its worker stops before they go.
+    std::unique_ptr<PitchCache> pitchCache_;
+    std::unique_ptr<Convolver> reverb_;
 
-    static constexpr int kMaxVoices = 32;
-    std::array<Voice, kMaxVoices> voices_{};
-    std::mutex mutex_;
+    std::unique_ptr<RenderPool> renderPool_; // only with renderThreads > 1
+    std::vector<float> partialBuses_;        // left/right/mono per chunk
+    RenderJob renderJob_;
 };
 
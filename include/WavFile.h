@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decoded WAV contents as interleaved 32-bit float frames. Frames
+// [loopStart, loopEnd) form the sustain loop, taken from the first forward
+// loop of a `smpl` chunk; loopEnd is 0 when there is none.
+struct WavData {
+    std::vector<float> samples;
+    int sampleRate = 0;
+    int channels = 0;
+    size_t loopStart = 0;
+    size_t loopEnd = 0;
+
+    size_t frames() const { return channels > 0 ? samples.size() / static_cast<size_t>(channels) : 0; }
+
+    // Clears the loop unless [start, end) is a non-empty range of frames.
+    void setLoop(size_t start, size_t end) {
+        const bool valid = start < end && end <= frames();
+        loopStart = valid ? start : 0;
+        loopEnd = valid ? end : 0;
+    }
+};
+
+// Layout of the PCM payload inside a WAV file.
+struct WavFormat {
+    uint16_t encoding = 0; // 1 = integer PCM, 3 = IEEE float (also for extensible files)
+    int bytesPerSample = 0;
+    int channels = 0;
+    int sampleRate = 0;
+    uint64_t dataOffset = 0; // byte offset of the first frame
+    uint64_t dataBytes = 0;
+    uint64_t loopStart = 0; // as in WavData
+    uint64_t loopEnd = 0;
+
+    size_t bytesPerFrame() const { return static_cast<size_t>(bytesPerSample) * static_cast<size_t>(channels); }
+    size_t frames() const { return bytesPerFrame() > 0 ? static_cast<size_t>(dataBytes / bytesPerFrame()) : 0; }
+};
+
+// Reads 8/16/24/32-bit integer PCM and 32/64-bit float WAV files without SDL,
+// including WAVE_FORMAT_EXTENSIBLE headers. The file is memory-mapped and
+// decoded in one pass into the returned buffer.
+// Throws std::runtime_error on malformed or unsupported files.
+WavData readWav(const std::string& path);
+
+// Walks the RIFF chunks without reading the sample data.
+WavFormat readWavFormat(const std::string& path);
+
+// Converts `sampleCount` raw samples in `format` to float.
+void decodeWavSamples(const unsigned char* source, size_t sampleCount, const WavFormat& format, float* destination);
+
+// Blends the `crossfadeFrames` frames leading up to the loop end with those
+// leading up to the loop start (linearly, which suits the correlated material
+// loops are cut from), so the jump back is seamless.
+// The fade is shortened to fit before the loop start and inside the loop.
+// Returns the length used; 0 leaves the data alone.
+size_t crossfadeLoop(WavData& wav, size_t crossfadeFrames);
+
+// Writes interleaved float frames as a 32-bit float WAV file.
+void writeWav(const std::string& path, const float* samples, size_t frames, int channels, int sampleRate);
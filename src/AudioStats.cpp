@@ -0,0 +1,150 @@
+#include "AudioStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+constexpr double kLateFactor = 1.5;
+} // namespace
+
+double AudioStats::bucketUpperMicros(int bucket) {
+    return kFirstBucketMicros * static_cast<double>(uint64_t{1} << bucket);
+}
+
+void AudioStats::recordCallback(
+    Clock::time_point start, Clock::time_point end, int frames, int activeVoices, uint64_t voiceSteals) {
+    const auto nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    const double periodNanos = 1e9 * static_cast<double>(frames) / static_cast<double>(sampleRate_);
+    const double load = periodNanos > 0.0 ? static_cast<double>(nanos) / periodNanos : 0.0;
+
+    int bucket = 0;
+    while (bucket + 1 < kHistogramBuckets && static_cast<double>(nanos) >= bucketUpperMicros(bucket) * 1000.0) {
+        ++bucket;
+    }
+    add(histogram_[static_cast<size_t>(bucket)], uint64_t{1});
+
+    if (callbacks_.load(std::memory_order_relaxed) > 0 &&
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(start - previousStart_).count()) >
+            kLateFactor * periodNanos) {
+        add(lateCallbacks_, uint64_t{1});
+    }
+    previousStart_ = start;
+    if (load > 1.0) {
+        add(overruns_, uint64_t{1});
+    }
+
+    add(frames_, static_cast<uint64_t>(frames));
+    add(busyNanos_, nanos);
+    maxNanos_.store(std::max(maxNanos_.load(std::memory_order_relaxed), nanos), std::memory_order_relaxed);
+    lastLoad_.store(load, std::memory_order_relaxed);
+    peakLoad_.store(std::max(peakLoad_.load(std::memory_order_relaxed), load), std::memory_order_relaxed);
+    activeVoices_.store(activeVoices, std::memory_order_relaxed);
+    peakVoices_.store(std::max(peakVoices_.load(std::memory_order_relaxed), activeVoices), std::memory_order_relaxed);
+    voiceSteals_.store(voiceSteals, std::memory_order_relaxed);
+    // Published last so a reader that sees the count also sees the rest.
+    callbacks_.store(callbacks_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+AudioStats::Snapshot AudioStats::snapshot() const {
+    Snapshot snapshot;
+    snapshot.sampleRate = sampleRate_;
+    snapshot.callbacks = callbacks_.load(std::memory_order_acquire);
+    snapshot.frames = frames_.load(std::memory_order_relaxed);
+    snapshot.busyNanos = busyNanos_.load(std::memory_order_relaxed);
+    snapshot.maxNanos = maxNanos_.load(std::memory_order_relaxed);
+    snapshot.lastLoad = lastLoad_.load(std::memory_order_relaxed);
+    snapshot.peakLoad = peakLoad_.load(std::memory_order_relaxed);
+    snapshot.activeVoices = activeVoices_.load(std::memory_order_relaxed);
+    snapshot.peakVoices = peakVoices_.load(std::memory_order_relaxed);
+    snapshot.voiceSteals = voiceSteals_.load(std::memory_order_relaxed);
+    snapshot.overruns = overruns_.load(std::memory_order_relaxed);
+    snapshot.lateCallbacks = lateCallbacks_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < histogram_.size(); ++i) {
+        snapshot.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+double AudioStats::Snapshot::meanLoad() const {
+    const double audioNanos = sampleRate > 0 ? 1e9 * static_cast<double>(frames) / sampleRate : 0.0;
+    return audioNanos > 0.0 ? static_cast<double>(busyNanos) / audioNanos : 0.0;
+}
+
+double AudioStats::Snapshot::meanMicros() const {
+    return callbacks > 0 ? static_cast<double>(busyNanos) / 1000.0 / static_cast<double>(callbacks) : 0.0;
+}
+
+double AudioStats::Snapshot::percentileMicros(double p) const {
+    uint64_t total = 0;
+    for (uint64_t count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    const double target = std::clamp(p, 0.0, 1.0) * static_cast<double>(total);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+        seen += histogram[static_cast<size_t>(bucket)];
+        if (static_cast<double>(seen) >= target && seen > 0) {
+            return bucketUpperMicros(bucket);
+        }
+    }
+    return bucketUpperMicros(kHistogramBuckets - 1);
+}
+
+AudioStats::Snapshot AudioStats::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot interval = *this;
+    interval.callbacks -= earlier.callbacks;
+    interval.frames -= earlier.frames;
+    interval.busyNanos -= earlier.busyNanos;
+    interval.voiceSteals -= earlier.voiceSteals;
+    interval.overruns -= earlier.overruns;
+    interval.lateCallbacks -= earlier.lateCallbacks;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        interval.histogram[i] -= earlier.histogram[i];
+    }
+    return interval;
+}
+
+std::string AudioStats::Snapshot::toText() const {
+    char line[256];
+    std::snprintf(line,
+                  sizeof(line),
+                  "callbacks %llu  load %.1f%% (peak %.1f%%)  mean %.0f us  p99 <%.0f us  max %.0f us  "
+                  "voices %d (peak %d)  steals %llu  overruns %llu  late %llu",
+                  static_cast<unsigned long long>(callbacks),
+                  100.0 * meanLoad(),
+                  100.0 * peakLoad,
+                  meanMicros(),
+                  percentileMicros(0.99),
+                  static_cast<double>(maxNanos) / 1000.0,
+                  activeVoices,
+                  peakVoices,
+                  static_cast<unsigned long long>(voiceSteals),
+                  static_cast<unsigned long long>(overruns),
+                  static_cast<unsigned long long>(lateCallbacks));
+    return line;
+}
+
+std::string AudioStats::Snapshot::toJson() const {
+    std::ostringstream out;
+    out << "{\"callbacks\":" << callbacks << ",\"frames\":" << frames << ",\"mean_load\":" << meanLoad()
+        << ",\"last_load\":" << lastLoad << ",\"peak_load\":" << peakLoad << ",\"mean_us\":" << meanMicros()
+        << ",\"p50_us\":" << percentileMicros(0.5) << ",\"p99_us\":" << percentileMicros(0.99)
+        << ",\"max_us\":" << static_cast<double>(maxNanos) / 1000.0 << ",\"active_voices\":" << activeVoices
+        << ",\"peak_voices\":" << peakVoices << ",\"voice_steals\":" << voiceSteals << ",\"overruns\":" << overruns
+        << ",\"late_callbacks\":" << lateCallbacks << ",\"histogram_us\":[";
+    for (int bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+        out << (bucket ? "," : "") << "{\"below\":";
+        if (bucket + 1 < kHistogramBuckets) {
+            out << bucketUpperMicros(bucket);
+        } else {
+            out << "null";
+        }
+        out << ",\"count\":" << histogram[static_cast<size_t>(bucket)] << "}";
+    }
+    out << "]}";
+    return out.str();
+}
@@ -0,0 +1,429 @@
+#include "Convolver.h"
+
+#include "Denormals.h"
+#include "Resampler.h"
+#include "Simd.h"
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr size_t kMinHeadFrames = 16;
+constexpr size_t kMaxHeadFrames = 4096;
+constexpr double kPi = 3.14159265358979323846;
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t rounded = 1;
+    while (rounded < value) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+} // namespace
+
+ImpulseResponse loadImpulseResponse(const std::string& path, int sampleRate) {
+    const WavData wav = readWav(path);
+    const size_t frames = wav.frames();
+    if (frames == 0) {
+        throw std::runtime_error("Impulssvaret indeholder ingen samples: " + path);
+    }
+    const int channels = std::min(wav.channels, 2);
+    std::vector<float> samples(frames * static_cast<size_t>(channels));
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (int channel = 0; channel < channels; ++channel) {
+            samples[frame * static_cast<size_t>(channels) + static_cast<size_t>(channel)] =
+                wav.samples[frame * static_cast<size_t>(wav.channels) + static_cast<size_t>(channel)];
+        }
+    }
+
+    ImpulseResponse impulse;
+    impulse.channels = channels;
+    impulse.samples = resample(samples.data(), frames, channels, wav.sampleRate, sampleRate);
+    double energy[2] = {0.0, 0.0};
+    for (size_t i = 0; i < impulse.samples.size(); ++i) {
+        energy[i % static_cast<size_t>(channels)] += static_cast<double>(impulse.samples[i]) * impulse.samples[i];
+    }
+    const double loudest = std::max(energy[0], energy[1]);
+    if (loudest > 0.0) {
+        const float scale = static_cast<float>(1.0 / std::sqrt(loudest));
+        for (float& sample : impulse.samples) {
+            sample *= scale;
+        }
+    }
+    return impulse;
+}
+
+Convolver::Fft::Fft(size_t size) : size_(size), reverse_(size) {
+    int bits = 0;
+    while ((size_t{1} << bits) < size) {
+        ++bits;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            reversed |= static_cast<uint32_t>((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        reverse_[i] = reversed;
+    }
+    for (size_t half = 4; half < size; half *= 2) {
+        for (size_t k = 0; k < half; ++k) {
+            const double angle = kPi * static_cast<double>(k) / static_cast<double>(half);
+            cosines_.push_back(static_cast<float>(std::cos(angle)));
+            sines_.push_back(static_cast<float>(-std::sin(angle)));
+        }
+    }
+}
+
+// Decimation in time: the first two stages need no multiplies and run per
+// group of four, every later stage four butterflies at a time.
+void Convolver::Fft::forward(float* re, float* im) const {
+    const size_t n = size_;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t j = reverse_[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+    for (size_t i = 0; i < n; i += 4) {
+        const float r0 = re[i] + re[i + 1];
+        const float i0 = im[i] + im[i + 1];
+        const float r1 = re[i] - re[i + 1];
+        const float i1 = im[i] - im[i + 1];
+        const float r2 = re[i + 2] + re[i + 3];
+        const float i2 = im[i + 2] + im[i + 3];
+        const float r3 = re[i + 2] - re[i + 3];
+        const float i3 = im[i + 2] - im[i + 3];
+        re[i] = r0 + r2;
+        im[i] = i0 + i2;
+        re[i + 2] = r0 - r2;
+        im[i + 2] = i0 - i2;
+        re[i + 1] = r1 + i3; // the second pair is turned by -i
+        im[i + 1] = i1 - r3;
+        re[i + 3] = r1 - i3;
+        im[i + 3] = i1 + r3;
+    }
+    const float* cosines = cosines_.data();
+    const float* sines = sines_.data();
+    for (size_t half = 4; half < n; half *= 2) {
+        for (size_t i = 0; i < n; i += 2 * half) {
+            float* aRe = re + i;
+            float* aIm = im + i;
+            float* bRe = aRe + half;
+            float* bIm = aIm + half;
+            for (size_t k = 0; k < half; k += simd::kLanes) {
+                const simd::Float4 wRe = simd::load(cosines + k);
+                const simd::Float4 wIm = simd::load(sines + k);
+                const simd::Float4 xRe = simd::load(bRe + k);
+                const simd::Float4 xIm = simd::load(bIm + k);
+                const simd::Float4 tRe = simd::sub(simd::mul(xRe, wRe), simd::mul(xIm, wIm));
+                const simd::Float4 tIm = simd::add(simd::mul(xRe, wIm), simd::mul(xIm, wRe));
+                const simd::Float4 uRe = simd::load(aRe + k);
+                const simd::Float4 uIm = simd::load(aIm + k);
+                simd::store(aRe + k, simd::add(uRe, tRe));
+                simd::store(aIm + k, simd::add(uIm, tIm));
+                simd::store(bRe + k, simd::sub(uRe, tRe));
+                simd::store(bIm + k, simd::sub(uIm, tIm));
+            }
+        }
+        cosines += half;
+        sines += half;
+    }
+}
+
+// Partition p holds taps [first + p * block, first + (p + 1) * block), zero
+// padded to 2 * block and scaled by the inverse transform's 1 / (2 * block).
+Convolver::Partitioned::Partitioned(const float* re, const float* im, size_t first, size_t last, size_t block)
+    : block_(block),
+      partitions_(last > first ? (last - first + block - 1) / block : 0),
+      fft_(2 * block) {
+    const size_t bins = 2 * block_;
+    filterRe_.assign(partitions_ * bins, 0.0f);
+    filterIm_.assign(partitions_ * bins, 0.0f);
+    const float scale = 1.0f / static_cast<float>(bins);
+    for (size_t p = 0; p < partitions_; ++p) {
+        float* spectrumRe = filterRe_.data() + p * bins;
+        float* spectrumIm = filterIm_.data() + p * bins;
+        const size_t begin = first + p * block_;
+        const size_t end = std::min(begin + block_, last);
+        for (size_t tap = begin; tap < end; ++tap) {
+            spectrumRe[tap - begin] = re[tap] * scale;
+            spectrumIm[tap - begin] = im[tap] * scale;
+        }
+        fft_.forward(spectrumRe, spectrumIm);
+    }
+    delayRe_.assign(partitions_ * bins, 0.0f);
+    delayIm_.assign(partitions_ * bins, 0.0f);
+    windowRe_.assign(bins, 0.0f);
+    windowIm_.assign(bins, 0.0f);
+    sumRe_.assign(bins, 0.0f);
+    sumIm_.assign(bins, 0.0f);
+}
+
+void Convolver::Partitioned::process(const float* inRe, const float* inIm, float* outRe, float* outIm) {
+    const size_t bins = 2 * block_;
+    std::copy_n(windowRe_.data() + block_, block_, windowRe_.data());
+    std::copy_n(windowIm_.data() + block_, block_, windowIm_.data());
+    std::copy_n(inRe, block_, windowRe_.data() + block_);
+    std::copy_n(inIm, block_, windowIm_.data() + block_);
+
+    newest_ = newest_ == 0 ? partitions_ - 1 : newest_ - 1;
+    float* spectrumRe = delayRe_.data() + newest_ * bins;
+    float* spectrumIm = delayIm_.data() + newest_ * bins;
+    std::copy(windowRe_.begin(), windowRe_.end(), spectrumRe);
+    std::copy(windowIm_.begin(), windowIm_.end(), spectrumIm);
+    fft_.forward(spectrumRe, spectrumIm);
+
+    // Partition p meets the window from p blocks ago.
+    std::fill(sumRe_.begin(), sumRe_.end(), 0.0f);
+    std::fill(sumIm_.begin(), sumIm_.end(), 0.0f);
+    size_t slot = newest_;
+    for (size_t p = 0; p < partitions_; ++p) {
+        const float* hRe = filterRe_.data() + p * bins;
+        const float* hIm = filterIm_.data() + p * bins;
+        const float* xRe = delayRe_.data() + slot * bins;
+        const float* xIm = delayIm_.data() + slot * bins;
+        for (size_t k = 0; k < bins; k += simd::kLanes) {
+            const simd::Float4 aRe = simd::load(xRe + k);
+            const simd::Float4 aIm = simd::load(xIm + k);
+            const simd::Float4 bRe = simd::load(hRe + k);
+            const simd::Float4 bIm = simd::load(hIm + k);
+            simd::store(sumRe_.data() + k,
+                        simd::add(simd::load(sumRe_.data() + k), simd::sub(simd::mul(aRe, bRe), simd::mul(aIm, bIm))));
+            simd::store(sumIm_.data() + k,
+                        simd::add(simd::load(sumIm_.data() + k), simd::add(simd::mul(aRe, bIm), simd::mul(aIm, bRe))));
+        }
+        slot = slot + 1 == partitions_ ? 0 : slot + 1;
+    }
+    fft_.inverse(sumRe_.data(), sumIm_.data());
+    // The first half wrapped around; the second is the linear convolution.
+    std::copy_n(sumRe_.data() + block_, block_, outRe);
+    std::copy_n(sumIm_.data() + block_, block_, outIm);
+}
+
+void Convolver::Partitioned::skip(uint64_t blocks) {
+    if (blocks == 0 || partitions_ == 0) {
+        return;
+    }
+    const size_t bins = 2 * block_;
+    for (uint64_t i = 0; i < std::min<uint64_t>(blocks, partitions_); ++i) {
+        newest_ = newest_ == 0 ? partitions_ - 1 : newest_ - 1;
+        std::fill_n(delayRe_.data() + newest_ * bins, bins, 0.0f);
+        std::fill_n(delayIm_.data() + newest_ * bins, bins, 0.0f);
+    }
+    std::fill(windowRe_.begin(), windowRe_.end(), 0.0f);
+    std::fill(windowIm_.begin(), windowIm_.end(), 0.0f);
+}
+
+Convolver::Convolver(const ImpulseResponse& impulse, const ReverbSettings& settings)
+    : head_(roundUpToPowerOfTwo(std::clamp(settings.headFrames, kMinHeadFrames, kMaxHeadFrames))),
+      send_(settings.send),
+      stereoImpulse_(impulse.channels == 2),
+      background_(settings.backgroundTail) {
+    const size_t frames = impulse.frames();
+    if ((impulse.channels != 1 && impulse.channels != 2) || frames == 0) {
+        throw std::runtime_error("Impulssvaret skal have en eller to kanaler og mindst en frame");
+    }
+    // The response as one complex filter, see the class comment.
+    std::vector<float> re(frames);
+    std::vector<float> im(frames, 0.0f);
+    for (size_t frame = 0; frame < frames; ++frame) {
+        re[frame] = impulse.samples[frame * static_cast<size_t>(impulse.channels)];
+        if (stereoImpulse_) {
+            im[frame] = impulse.samples[frame * 2 + 1];
+        }
+    }
+
+    headRe_.assign(head_, 0.0f);
+    headIm_.assign(head_, 0.0f);
+    for (size_t tap = 0; tap < std::min(head_, frames); ++tap) {
+        headRe_[head_ - 1 - tap] = re[tap];
+        headIm_[head_ - 1 - tap] = im[tap];
+    }
+    historyRe_.assign(2 * head_, 0.0f);
+    historyIm_.assign(2 * head_, 0.0f);
+    bodyRe_.assign(head_, 0.0f);
+    bodyIm_.assign(head_, 0.0f);
+
+    size_t bodyEnd = frames;
+    if (settings.tailBlockFrames > 0) {
+        const size_t block = roundUpToPowerOfTwo(std::max(settings.tailBlockFrames, 2 * head_));
+        if (frames > 2 * block) {
+            bodyEnd = 2 * block;
+            tail_ = std::make_unique<Partitioned>(re.data(), im.data(), bodyEnd, frames, block);
+            slotsRe_.assign(kTailSlots * block, 0.0f);
+            slotsIm_.assign(kTailSlots * block, 0.0f);
+            filling_ = 0;
+            states_[0] = SlotState::Filling;
+        }
+    }
+    body_ = std::make_unique<Partitioned>(re.data(), im.data(), std::min(head_, frames), bodyEnd, head_);
+    if (tail_ && background_) {
+        thread_ = std::thread(&Convolver::run, this);
+    }
+}
+
+Convolver::~Convolver() {
+    running_.store(false, std::memory_order_relaxed);
+    wakeup_.post();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Convolver::process(float* left, float* right, const float* mono, int frames) {
+    const size_t total = static_cast<size_t>(std::max(frames, 0));
+    const size_t tailBlock = tail_ ? tail_->block() : 0;
+    size_t done = 0;
+    while (done < total) {
+        const size_t count = std::min(total - done, head_ - fill_);
+        float* inRe = historyRe_.data() + head_ + fill_;
+        float* inIm = historyIm_.data() + head_ + fill_;
+        for (size_t i = 0; i < count; ++i) {
+            const float l = left[done + i] + mono[done + i];
+            const float r = right[done + i] + mono[done + i];
+            inRe[i] = stereoImpulse_ ? (l + r) * 0.5f * send_ : l * send_;
+            inIm[i] = stereoImpulse_ ? 0.0f : r * send_;
+        }
+
+        const float* tailRe = nullptr;
+        const float* tailIm = nullptr;
+        if (tail_) {
+            if (filling_ >= 0) {
+                const size_t offset = static_cast<size_t>(filling_) * tailBlock + tailFill_;
+                std::copy_n(inRe, count, slotsRe_.data() + offset);
+                std::copy_n(inIm, count, slotsIm_.data() + offset);
+            }
+            if (playing_ >= 0) {
+                const size_t offset = static_cast<size_t>(playing_) * tailBlock + tailFill_;
+                tailRe = slotsRe_.data() + offset;
+                tailIm = slotsIm_.data() + offset;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            // The head taps against the latest head_ inputs, oldest first.
+            const float* xRe = historyRe_.data() + fill_ + i + 1;
+            const float* xIm = historyIm_.data() + fill_ + i + 1;
+            simd::Float4 sumRe = simd::broadcast(0.0f);
+            simd::Float4 sumIm = simd::broadcast(0.0f);
+            for (size_t k = 0; k < head_; k += simd::kLanes) {
+                const simd::Float4 hRe = simd::load(headRe_.data() + k);
+                const simd::Float4 hIm = simd::load(headIm_.data() + k);
+                const simd::Float4 aRe = simd::load(xRe + k);
+                const simd::Float4 aIm = simd::load(xIm + k);
+                sumRe = simd::add(sumRe, simd::sub(simd::mul(hRe, aRe), simd::mul(hIm, aIm)));
+                sumIm = simd::add(sumIm, simd::add(simd::mul(hRe, aIm), simd::mul(hIm, aRe)));
+            }
+            float wetRe = simd::sum(sumRe) + bodyRe_[fill_ + i];
+            float wetIm = simd::sum(sumIm) + bodyIm_[fill_ + i];
+            if (tailRe) {
+                wetRe += tailRe[i];
+                wetIm += tailIm[i];
+            }
+            left[done + i] += wetRe;
+            right[done + i] += wetIm;
+        }
+
+        done += count;
+        fill_ += count;
+        if (fill_ == head_) {
+            // The body's output for this block sounds during the next one.
+            if (!body_->empty()) {
+                body_->process(historyRe_.data() + head_, historyIm_.data() + head_, bodyRe_.data(), bodyIm_.data());
+            }
+            std::copy_n(historyRe_.data() + head_, head_, historyRe_.data());
+            std::copy_n(historyIm_.data() + head_, head_, historyIm_.data());
+            fill_ = 0;
+        }
+        if (tail_) {
+            tailFill_ += count;
+            if (tailFill_ == tailBlock) {
+                advanceTail();
+                tailFill_ = 0;
+            }
+        }
+    }
+}
+
+// Called once per tail block of input. Block b's output sounds over block
+// b + 2, so the block completed now is submitted and the previous one's
+// output starts playing.
+void Convolver::advanceTail() {
+    const uint64_t block = tailBlocks_++;
+    TailJob job;
+    while (done_.pop(job)) {
+        const auto slot = static_cast<size_t>(job.slot);
+        states_[slot] = job.block + 1 >= block ? SlotState::Ready : SlotState::Free; // too late otherwise
+    }
+    if (playing_ >= 0) {
+        states_[static_cast<size_t>(playing_)] = SlotState::Free;
+        playing_ = -1;
+    }
+
+    if (filling_ >= 0) {
+        const auto slot = static_cast<size_t>(filling_);
+        slotBlocks_[slot] = block;
+        if (!background_) {
+            const size_t offset = slot * tail_->block();
+            tail_->process(slotsRe_.data() + offset,
+                           slotsIm_.data() + offset,
+                           slotsRe_.data() + offset,
+                           slotsIm_.data() + offset);
+            states_[slot] = SlotState::Ready;
+        } else {
+            states_[slot] = SlotState::Queued;
+            jobs_.push(TailJob{block, filling_}); // never full: one job per slot
+            wakeup_.post();
+        }
+    }
+    // Without a free slot the next block's input is dropped; the worker
+    // stands in silence for it.
+    filling_ = -1;
+    for (int slot = 0; slot < kTailSlots; ++slot) {
+        if (states_[static_cast<size_t>(slot)] == SlotState::Free) {
+            filling_ = slot;
+            states_[static_cast<size_t>(slot)] = SlotState::Filling;
+            break;
+        }
+    }
+
+    if (block == 0) {
+        return;
+    }
+    for (int slot = 0; slot < kTailSlots; ++slot) {
+        if (states_[static_cast<size_t>(slot)] == SlotState::Ready && slotBlocks_[static_cast<size_t>(slot)] + 1 == block) {
+            playing_ = slot;
+        }
+    }
+    if (playing_ < 0) {
+        lateBlocks_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Convolver::run() {
+    const ScopedFlushDenormals flushDenormals;
+    TailJob job;
+    for (;;) {
+        wakeup_.wait();
+        if (!running_.load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (!jobs_.pop(job)) {
+            continue;
+        }
+        // Dropped blocks enter the delay line as silence, so later blocks
+        // still meet the right partitions.
+        tail_->skip(job.block - workerNext_);
+        const size_t offset = static_cast<size_t>(job.slot) * tail_->block();
+        tail_->process(
+            slotsRe_.data() + offset, slotsIm_.data() + offset, slotsRe_.data() + offset, slotsIm_.data() + offset);
+        workerNext_ = job.block + 1;
+        done_.push(job);
+    }
+}
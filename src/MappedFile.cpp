@@ -0,0 +1,83 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Kunne ikke åbne fil: " + path);
+    }
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Filen er tom eller kan ikke læses: " + path);
+    }
+
+    void* mapping = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Kunne ikke memory-mappe fil: " + path);
+    }
+
+    data_ = static_cast<const unsigned char*>(mapping);
+    size_ = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+    if (!data_ || offset >= size_) {
+        return;
+    }
+    const size_t page = pageSize();
+    const size_t begin = offset - offset % page;
+    const size_t end = std::min(size_, offset + length);
+    ::madvise(const_cast<unsigned char*>(data_) + begin, end - begin, MADV_WILLNEED);
+}
+
+void MappedFile::evict(size_t offset, size_t length) const {
+    if (!data_ || offset >= size_) {
+        return;
+    }
+    const size_t page = pageSize();
+    const size_t begin = (offset + page - 1) / page * page;
+    const size_t end = std::min(size_, offset + length) / page * page;
+    if (begin < end) {
+        ::madvise(const_cast<unsigned char*>(data_) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+size_t MappedFile::pageSize() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+void MappedFile::release() {
+    if (data_) {
+        ::munmap(const_cast<unsigned char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
@@ -0,0 +1,189 @@
+#include "MidiInput.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr size_t kReadBytes = 512;
+
+// Best effort, just below the render workers; without the privilege the
+// reader keeps normal priority.
+void requestRealtimePriority(std::thread& thread) {
+#if defined(__linux__) || defined(__APPLE__)
+    sched_param param{};
+    param.sched_priority = std::max(1, sched_get_priority_max(SCHED_FIFO) - 2);
+    pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+#else
+    (void)thread;
+#endif
+}
+
+void closeFd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+} // namespace
+
+MidiInput::MidiInput(const std::string& path, Handler handler) : path_(path), handler_(std::move(handler)) {
+    int wake[2];
+    if (::pipe(wake) != 0) {
+        throw std::runtime_error("Kunne ikke oprette MIDI tråden");
+    }
+    wakeRead_ = wake[0];
+    wakeWrite_ = wake[1];
+
+    struct stat info {};
+    const bool exists = ::stat(path.c_str(), &info) == 0;
+    if (exists && S_ISFIFO(info.st_mode)) {
+        fifo_.fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        fifoWriter_ = fifo_.fd >= 0 ? ::open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC) : -1;
+        if (fifoWriter_ < 0) {
+            closeAll();
+            throw std::runtime_error("Kunne ikke åbne MIDI FIFO: " + path);
+        }
+    } else {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            closeAll();
+            throw std::runtime_error("MIDI socket stien er for lang: " + path);
+        }
+        if (exists && !S_ISSOCK(info.st_mode)) {
+            closeAll();
+            throw std::runtime_error("Findes allerede og er hverken FIFO eller socket: " + path);
+        }
+        if (exists) {
+            ::unlink(path.c_str()); // left behind by an earlier run
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd_ < 0 || ::bind(listenFd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd_, kMaxClients) != 0) {
+            closeAll();
+            throw std::runtime_error("Kunne ikke lytte på MIDI socket: " + path);
+        }
+    }
+
+    thread_ = std::thread(&MidiInput::run, this);
+    requestRealtimePriority(thread_);
+}
+
+MidiInput::~MidiInput() {
+    const char stop = 0;
+    if (::write(wakeWrite_, &stop, 1) == 1 && thread_.joinable()) {
+        thread_.join();
+    } else if (thread_.joinable()) {
+        thread_.detach();
+    }
+    const bool socket = listenFd_ >= 0;
+    closeAll();
+    if (socket) {
+        ::unlink(path_.c_str());
+    }
+}
+
+void MidiInput::closeAll() {
+    closeFd(listenFd_);
+    closeFd(fifoWriter_);
+    closeFd(fifo_.fd);
+    for (Source& client : clients_) {
+        closeFd(client.fd);
+    }
+    closeFd(wakeRead_);
+    closeFd(wakeWrite_);
+}
+
+void MidiInput::run() {
+    std::array<pollfd, kMaxClients + 2> fds{};
+    std::array<Source*, kMaxClients + 2> sources{};
+    for (;;) {
+        int count = 0;
+        fds[count++] = pollfd{wakeRead_, POLLIN, 0};
+        if (listenFd_ >= 0) {
+            sources[count] = nullptr;
+            fds[count++] = pollfd{listenFd_, POLLIN, 0};
+        }
+        if (fifo_.fd >= 0) {
+            sources[count] = &fifo_;
+            fds[count++] = pollfd{fifo_.fd, POLLIN, 0};
+        }
+        for (Source& client : clients_) {
+            if (client.fd >= 0) {
+                sources[count] = &client;
+                fds[count++] = pollfd{client.fd, POLLIN, 0};
+            }
+        }
+
+        if (::poll(fds.data(), static_cast<nfds_t>(count), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;
+        }
+        for (int i = 1; i < count; ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (!sources[i]) {
+                acceptClient();
+            } else if (!readFrom(*sources[i])) {
+                closeFd(sources[i]->fd);
+                sources[i]->parser.reset();
+            }
+        }
+    }
+}
+
+void MidiInput::acceptClient() {
+    int fd = ::accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) {
+        return;
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    for (Source& client : clients_) {
+        if (client.fd < 0) {
+            client.fd = fd;
+            client.parser.reset();
+            return;
+        }
+    }
+    closeFd(fd); // every slot taken
+}
+
+bool MidiInput::readFrom(Source& source) {
+    uint8_t buffer[kReadBytes];
+    // Bytes that arrive together share the time the reader woke for them.
+    const Clock::time_point received = Clock::now();
+    const ssize_t got = ::read(source.fd, buffer, sizeof(buffer));
+    if (got == 0) {
+        return false;
+    }
+    if (got < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    bytes_.store(bytes_.load(std::memory_order_relaxed) + static_cast<uint64_t>(got), std::memory_order_relaxed);
+    source.parser.feed(buffer, static_cast<size_t>(got), [&](const MidiMessage& message) {
+        messages_.store(messages_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        handler_(message, received);
+    });
+    return true;
+}
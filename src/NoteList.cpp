@@ -0,0 +1,250 @@
+#include "NoteList.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr double kDefaultTempo = 500000.0; // microseconds per quarter note (120 BPM)
+
+struct MidiEvent {
+    uint64_t tick = 0;
+    int order = 0;       // file order, keeps simultaneous events stable
+    double tempo = 0.0;  // > 0 for tempo changes
+    NoteEvent note;
+};
+
+class ByteReader {
+public:
+    ByteReader(const uint8_t* begin, const uint8_t* end) : cursor_(begin), end_(end) {}
+
+    bool atEnd() const { return cursor_ >= end_; }
+
+    uint8_t peek() const {
+        require(1);
+        return *cursor_;
+    }
+
+    uint8_t byte() {
+        require(1);
+        return *cursor_++;
+    }
+
+    uint32_t bigEndian(int count) {
+        require(static_cast<size_t>(count));
+        uint32_t value = 0;
+        for (int i = 0; i < count; ++i) {
+            value = (value << 8) | *cursor_++;
+        }
+        return value;
+    }
+
+    uint32_t variableLength() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const uint8_t next = byte();
+            value = (value << 7) | (next & 0x7f);
+            if ((next & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Ugyldig variabel længde i MIDI fil");
+    }
+
+    void skip(size_t count) {
+        require(count);
+        cursor_ += count;
+    }
+
+    const uint8_t* position() const { return cursor_; }
+
+private:
+    void require(size_t count) const {
+        if (static_cast<size_t>(end_ - cursor_) < count) {
+            throw std::runtime_error("MIDI filen er afkortet");
+        }
+    }
+
+    const uint8_t* cursor_;
+    const uint8_t* end_;
+};
+
+std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Kunne ikke åbne fil: " + path);
+    }
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+void parseTrack(ByteReader reader, int& order, std::vector<MidiEvent>& events) {
+    uint64_t tick = 0;
+    uint8_t runningStatus = 0;
+
+    while (!reader.atEnd()) {
+        tick += reader.variableLength();
+
+        uint8_t status = reader.peek();
+        if (status & 0x80) {
+            reader.byte();
+        } else if (runningStatus != 0) {
+            status = runningStatus;
+        } else {
+            throw std::runtime_error("MIDI data uden status byte");
+        }
+
+        if (status == 0xff) {
+            const uint8_t type = reader.byte();
+            const uint32_t length = reader.variableLength();
+            if (type == 0x51 && length == 3) {
+                MidiEvent event;
+                event.tick = tick;
+                event.order = order++;
+                event.tempo = static_cast<double>(reader.bigEndian(3));
+                events.push_back(event);
+            } else {
+                reader.skip(length);
+            }
+            if (type == 0x2f) {
+                return;
+            }
+            continue;
+        }
+        if (status == 0xf0 || status == 0xf7) {
+            reader.skip(reader.variableLength());
+            continue;
+        }
+
+        runningStatus = status;
+        const uint8_t kind = status & 0xf0;
+        const uint8_t data1 = reader.byte();
+        const bool twoDataBytes = kind != 0xc0 && kind != 0xd0;
+        const uint8_t data2 = twoDataBytes ? reader.byte() : 0;
+
+        if (kind == 0x90 || kind == 0x80) {
+            MidiEvent event;
+            event.tick = tick;
+            event.order = order++;
+            event.note.note = data1;
+            event.note.on = kind == 0x90 && data2 > 0;
+            event.note.velocity = event.note.on ? data2 : 0;
+            events.push_back(event);
+        }
+    }
+}
+
+} // namespace
+
+std::vector<NoteEvent> readNoteText(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Kunne ikke åbne nodeliste: " + path);
+    }
+
+    std::vector<NoteEvent> events;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        NoteEvent event;
+        std::string kind;
+        if (!(fields >> event.time >> kind >> event.note) || (kind != "on" && kind != "off") ||
+            event.time < 0.0) {
+            throw std::runtime_error("Ugyldig linje " + std::to_string(lineNumber) + " i " + path);
+        }
+        event.on = kind == "on";
+        event.velocity = 0;
+        if (event.on && !(fields >> event.velocity)) {
+            event.velocity = 100;
+        }
+        events.push_back(event);
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const NoteEvent& a, const NoteEvent& b) {
+        return a.time < b.time;
+    });
+    return events;
+}
+
+std::vector<NoteEvent> readMidiFile(const std::string& path) {
+    const std::vector<uint8_t> bytes = readFile(path);
+    ByteReader file(bytes.data(), bytes.data() + bytes.size());
+
+    if (bytes.size() < 14 || std::memcmp(bytes.data(), "MThd", 4) != 0) {
+        throw std::runtime_error("Ikke en MIDI fil: " + path);
+    }
+    file.skip(4);
+    const uint32_t headerLength = file.bigEndian(4);
+    const uint32_t format = file.bigEndian(2);
+    const uint32_t trackCount = file.bigEndian(2);
+    const uint32_t division = file.bigEndian(2);
+    file.skip(headerLength - 6);
+    if (format > 1) {
+        throw std::runtime_error("MIDI format " + std::to_string(format) + " understøttes ikke");
+    }
+
+    std::vector<MidiEvent> events;
+    int order = 0;
+    for (uint32_t track = 0; track < trackCount && !file.atEnd(); ++track) {
+        const uint32_t id = file.bigEndian(4);
+        const uint32_t length = file.bigEndian(4);
+        const uint8_t* begin = file.position();
+        file.skip(length);
+        if (id == 0x4d54726b) { // "MTrk"
+            parseTrack(ByteReader(begin, begin + length), order, events);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](const MidiEvent& a, const MidiEvent& b) {
+        return a.tick != b.tick ? a.tick < b.tick : a.order < b.order;
+    });
+
+    // SMPTE divisions give a fixed tick length; metrical ones follow the tempo map.
+    const bool smpte = (division & 0x8000) != 0;
+    const double smpteTickSeconds =
+        smpte ? 1.0 / (static_cast<double>(-static_cast<int8_t>(division >> 8)) * static_cast<double>(division & 0xff))
+              : 0.0;
+    const double ticksPerQuarter = smpte ? 1.0 : static_cast<double>(std::max<uint32_t>(division, 1));
+
+    std::vector<NoteEvent> notes;
+    double tempo = kDefaultTempo;
+    double seconds = 0.0;
+    uint64_t lastTick = 0;
+    for (const auto& event : events) {
+        const double elapsed = static_cast<double>(event.tick - lastTick);
+        seconds += smpte ? elapsed * smpteTickSeconds : elapsed * tempo / (ticksPerQuarter * 1000000.0);
+        lastTick = event.tick;
+        if (event.tempo > 0.0) {
+            tempo = event.tempo;
+            continue;
+        }
+        NoteEvent note = event.note;
+        note.time = seconds;
+        notes.push_back(note);
+    }
+    return notes;
+}
+
+std::vector<NoteEvent> readNoteList(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Kunne ikke åbne nodeliste: " + path);
+    }
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (in.gcount() == 4 && std::memcmp(magic, "MThd", 4) == 0) {
+        return readMidiFile(path);
+    }
+    return readNoteText(path);
+}
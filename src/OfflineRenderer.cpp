@@ -0,0 +1,133 @@
+#include "OfflineRenderer.h"
+
+#include "VoiceManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+size_t frameOf(double seconds, double rate) {
+    return static_cast<size_t>(std::llround(std::max(0.0, seconds) * rate));
+}
+
+bool audible(const RenderResult& result, size_t frame, int channels, float threshold) {
+    const float* samples = result.samples.data() + frame * static_cast<size_t>(channels);
+    for (int channel = 0; channel < channels; ++channel) {
+        if (std::fabs(samples[channel]) > threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// First audible frame in [from, to), or `to` if there is none.
+size_t firstAudible(const RenderResult& result, size_t from, size_t to, int channels, float threshold) {
+    to = std::min(to, result.frames);
+    while (from < to && !audible(result, from, channels, threshold)) {
+        ++from;
+    }
+    return from;
+}
+
+} // namespace
+
+RenderResult renderOffline(VoiceManager& manager, const std::vector<NoteEvent>& events, const RenderOptions& options) {
+    const int channels = manager.outputChannels();
+    const double rate = static_cast<double>(manager.sampleRate());
+    const int blockSize = std::max(1, options.blockSize);
+    const uint64_t origin = manager.renderedFrames();
+
+    const size_t lastEventFrame = events.empty() ? 0 : frameOf(events.back().time, rate);
+    const size_t endLimit = lastEventFrame + frameOf(options.tailSeconds, rate);
+
+    RenderResult result;
+    std::chrono::steady_clock::duration busy{};
+    size_t frame = 0;
+    size_t next = 0;
+
+    for (;;) {
+        const bool eventsDone = next == events.size();
+        if (eventsDone && (manager.activeVoiceCount() == 0 || frame >= endLimit)) {
+            break;
+        }
+
+        size_t count = static_cast<size_t>(blockSize);
+        if (options.timing == EventTiming::SplitBlocks && !eventsDone) {
+            size_t upcoming = next;
+            while (upcoming < events.size() && frameOf(events[upcoming].time, rate) <= frame) {
+                ++upcoming;
+            }
+            if (upcoming < events.size()) {
+                count = std::min(count, frameOf(events[upcoming].time, rate) - frame);
+            }
+        } else if (eventsDone && frame < endLimit) {
+            count = std::min(count, endLimit - frame);
+        }
+
+        // Hand over every event that falls inside this block. Timestamped
+        // events keep their frame; the others take effect at the block start,
+        // which for SplitBlocks is their own frame.
+        while (next < events.size() && frameOf(events[next].time, rate) < frame + count) {
+            const NoteEvent& event = events[next++];
+            const uint64_t at =
+                options.timing == EventTiming::Timestamped ? origin + frameOf(event.time, rate) : VoiceManager::kNow;
+            if (event.on) {
+                manager.noteOn(event.note, event.velocity, at);
+            } else {
+                manager.noteOff(event.note, at);
+            }
+        }
+
+        result.samples.resize((frame + count) * static_cast<size_t>(channels));
+        float* output = result.samples.data() + frame * static_cast<size_t>(channels);
+
+        const auto start = std::chrono::steady_clock::now();
+        manager.mix(output, static_cast<int>(count));
+        busy += std::chrono::steady_clock::now() - start;
+
+        frame += count;
+    }
+
+    result.frames = frame;
+    result.renderSeconds = std::chrono::duration<double>(busy).count();
+    result.audioSeconds = static_cast<double>(frame) / rate;
+    return result;
+}
+
+OnsetReport compareOnsets(const RenderResult& rendered,
+                          const RenderResult& reference,
+                          const std::vector<NoteEvent>& events,
+                          int sampleRate,
+                          int channels,
+                          size_t window,
+                          float threshold) {
+    OnsetReport report;
+    double totalError = 0.0;
+    for (const NoteEvent& event : events) {
+        const size_t frame = frameOf(event.time, static_cast<double>(sampleRate));
+        if (!event.on || frame >= reference.frames) {
+            continue;
+        }
+        const size_t from = frame > window ? frame - window : 0;
+        const size_t to = frame + window;
+        if (firstAudible(reference, from, frame, channels, threshold) < frame) {
+            continue; // something still sounds; the onset cannot be isolated
+        }
+        const size_t expected = firstAudible(reference, frame, to, channels, threshold);
+        if (expected >= std::min(to, reference.frames)) {
+            continue;
+        }
+        const size_t actual = firstAudible(rendered, from, to, channels, threshold);
+        const long error = std::abs(static_cast<long>(actual) - static_cast<long>(expected));
+        ++report.checked;
+        report.exact += error == 0 ? 1 : 0;
+        report.maxError = std::max(report.maxError, error);
+        totalError += static_cast<double>(error);
+    }
+    report.meanError = report.checked > 0 ? totalError / static_cast<double>(report.checked) : 0.0;
+    return report;
+}
@@ -0,0 +1,332 @@
+#include "PitchCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+
+namespace {
+
+// Pitch steps become the rational rate pair step * kPitchScale : kPitchScale,
+// which is within a hundredth of a cent of the voice's own step.
+constexpr double kPitchScale = 1 << 20;
+constexpr float kInt16Scale = 1.0f / 32768.0f;
+
+} // namespace
+
+PitchCache::PitchCache(int sampleRate, const PitchCacheSettings& settings)
+    : sampleRate_(sampleRate),
+      budgetBytes_(settings.budgetBytes),
+      quality_(settings.quality),
+      background_(settings.background),
+      entries_(kMaxEntries),
+      buffers_(kMaxEntries) {
+    index_.fill(-1);
+    freeEntries_.reserve(kMaxEntries);
+    for (int i = kMaxEntries - 1; i >= 0; --i) {
+        freeEntries_.push_back(i);
+    }
+    if (background_) {
+        thread_ = std::thread(&PitchCache::run, this);
+    }
+}
+
+PitchCache::~PitchCache() {
+    running_.store(false, std::memory_order_relaxed);
+    wakeup_.post();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+size_t PitchCache::hashKey(const SampleZone* source, uint64_t epoch, int note) {
+    uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(source));
+    hash ^= epoch * 0x9e3779b97f4a7c15ULL;
+    hash ^= static_cast<uint64_t>(note) << 56;
+    hash *= 0xff51afd7ed558ccdULL;
+    return static_cast<size_t>(hash ^ (hash >> 32)) & (kIndexSize - 1);
+}
+
+int PitchCache::find(const SampleZone* source, uint64_t epoch, int note) const {
+    for (size_t slot = hashKey(source, epoch, note);; slot = (slot + 1) & (kIndexSize - 1)) {
+        const int entry = index_[slot];
+        if (entry < 0) {
+            return -1;
+        }
+        const Entry& candidate = entries_[static_cast<size_t>(entry)];
+        if (candidate.source == source && candidate.epoch == epoch && candidate.note == note) {
+            return entry;
+        }
+    }
+}
+
+void PitchCache::insertIndex(int entry) {
+    const Entry& inserted = entries_[static_cast<size_t>(entry)];
+    size_t slot = hashKey(inserted.source, inserted.epoch, inserted.note);
+    while (index_[slot] >= 0) {
+        slot = (slot + 1) & (kIndexSize - 1);
+    }
+    index_[slot] = entry;
+}
+
+// Backward-shift deletion: later members of the probe run move up into the
+// hole when their home slot allows it, so lookups never need tombstones.
+void PitchCache::eraseIndex(int entry) {
+    const Entry& erased = entries_[static_cast<size_t>(entry)];
+    size_t hole = hashKey(erased.source, erased.epoch, erased.note);
+    while (index_[hole] != entry) {
+        hole = (hole + 1) & (kIndexSize - 1);
+    }
+    for (size_t slot = (hole + 1) & (kIndexSize - 1); index_[slot] >= 0; slot = (slot + 1) & (kIndexSize - 1)) {
+        const Entry& moved = entries_[static_cast<size_t>(index_[slot])];
+        const size_t home = hashKey(moved.source, moved.epoch, moved.note);
+        // Moves when its home is not in the cyclic range (hole, slot].
+        if (((slot - home) & (kIndexSize - 1)) >= ((slot - hole) & (kIndexSize - 1))) {
+            index_[hole] = index_[slot];
+            hole = slot;
+        }
+    }
+    index_[hole] = -1;
+}
+
+void PitchCache::pushRecent(int index) {
+    Entry& entry = entries_[static_cast<size_t>(index)];
+    entry.previous = recentTail_;
+    entry.next = -1;
+    if (recentTail_ >= 0) {
+        entries_[static_cast<size_t>(recentTail_)].next = index;
+    } else {
+        recentHead_ = index;
+    }
+    recentTail_ = index;
+}
+
+void PitchCache::unlinkRecent(int index) {
+    Entry& entry = entries_[static_cast<size_t>(index)];
+    if (entry.previous >= 0) {
+        entries_[static_cast<size_t>(entry.previous)].next = entry.next;
+    } else {
+        recentHead_ = entry.next;
+    }
+    if (entry.next >= 0) {
+        entries_[static_cast<size_t>(entry.next)].previous = entry.previous;
+    } else {
+        recentTail_ = entry.previous;
+    }
+    entry.previous = -1;
+    entry.next = -1;
+}
+
+void PitchCache::addPending(int entry) {
+    pendingEntries_[static_cast<size_t>(pending_++)] = entry;
+    oldestPending_ = std::min(oldestPending_, entries_[static_cast<size_t>(entry)].epoch);
+}
+
+void PitchCache::removePending(int entry) {
+    const auto end = pendingEntries_.begin() + pending_;
+    std::iter_swap(std::find(pendingEntries_.begin(), end, entry), end - 1);
+    --pending_;
+    oldestPending_ = std::numeric_limits<uint64_t>::max();
+    for (int i = 0; i < pending_; ++i) {
+        oldestPending_ =
+            std::min(oldestPending_, entries_[static_cast<size_t>(pendingEntries_[static_cast<size_t>(i)])].epoch);
+    }
+}
+
+// Drops an entry that is out of recent_ from the index and frees its slot.
+void PitchCache::freeEntry(int entry) {
+    eraseIndex(entry);
+    entries_[static_cast<size_t>(entry)] = Entry{};
+    freeEntries_.push_back(entry);
+}
+
+// Queues a job and wakes the worker for it, or without a worker does it
+// here; false when the queue is full.
+bool PitchCache::postJob(const Job& job) {
+    if (!background_) {
+        doJob(job);
+        return true;
+    }
+    if (!jobs_.push(job)) {
+        return false;
+    }
+    wakeup_.post();
+    return true;
+}
+
+const SampleZone* PitchCache::acquire(const SampleZone& zone, uint64_t epoch, int note, double step, int& entry) {
+    entry = -1;
+    if (zone.looped() || zone.stream || zone.residentFrames() < zone.frames) {
+        return nullptr;
+    }
+    const int found = find(&zone, epoch, note);
+    if (found >= 0) {
+        Entry& candidate = entries_[static_cast<size_t>(found)];
+        if (candidate.state == State::Pending) {
+            misses_.store(misses_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return nullptr; // still rendering
+        }
+        ++candidate.voices;
+        unlinkRecent(found);
+        pushRecent(found);
+        hits_.store(hits_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        entry = found;
+        return &candidate.zone;
+    }
+    misses_.store(misses_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (pending_ >= kMaxPending) {
+        return nullptr;
+    }
+
+    int fresh = -1;
+    if (!freeEntries_.empty()) {
+        fresh = freeEntries_.back();
+        freeEntries_.pop_back();
+    } else {
+        fresh = evictOne();
+        if (fresh < 0) {
+            return nullptr;
+        }
+    }
+    Entry& pending = entries_[static_cast<size_t>(fresh)];
+    pending = Entry{};
+    pending.state = State::Pending;
+    pending.source = &zone;
+    pending.epoch = epoch;
+    pending.note = note;
+    pending.zone.channels = zone.channels;
+    insertIndex(fresh);
+    if (postJob(Job{fresh, true, zone, step})) {
+        addPending(fresh);
+    } else {
+        freeEntry(fresh);
+    }
+    return nullptr;
+}
+
+void PitchCache::release(int entry) {
+    --entries_[static_cast<size_t>(entry)].voices;
+}
+
+void PitchCache::update() {
+    Done done;
+    while (done_.pop(done)) {
+        Entry& entry = entries_[static_cast<size_t>(done.entry)];
+        removePending(done.entry);
+        if (!done.data) {
+            freeEntry(done.entry);
+            continue;
+        }
+        entry.zone.rootNote = entry.note;
+        entry.zone.sampleRate = sampleRate_;
+        entry.zone.format = SampleFormat::Float32;
+        entry.zone.data = done.data;
+        entry.zone.frames = done.frames;
+        entry.bytes = done.frames * static_cast<size_t>(entry.zone.channels) * sizeof(float);
+        entry.state = State::Ready;
+        pushRecent(done.entry);
+        readyBytes_ += entry.bytes;
+        readyEntries_.store(readyEntries_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        renders_.store(renders_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    while (readyBytes_ > budgetBytes_) {
+        const int evicted = evictOne();
+        if (evicted < 0) {
+            break;
+        }
+        freeEntries_.push_back(evicted);
+    }
+    bytes_.store(readyBytes_, std::memory_order_relaxed);
+}
+
+// Evicts the least recently used entry no voice is playing and returns it,
+// emptied but not on the free list; -1 when there is none. Only entries
+// pinned by sounding voices are skipped, so the walk is bounded by the
+// polyphony. The worker releases the buffer.
+int PitchCache::evictOne() {
+    int victim = recentHead_;
+    while (victim >= 0 && entries_[static_cast<size_t>(victim)].voices > 0) {
+        victim = entries_[static_cast<size_t>(victim)].next;
+    }
+    if (victim < 0) {
+        return -1;
+    }
+    Entry& entry = entries_[static_cast<size_t>(victim)];
+    readyBytes_ -= entry.bytes;
+    unlinkRecent(victim);
+    eraseIndex(victim);
+    entry = Entry{};
+    // The queue holds a slot for every entry besides the pending renders.
+    postJob(Job{victim, false, SampleZone{}, 1.0});
+    readyEntries_.store(readyEntries_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    evictions_.store(evictions_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return victim;
+}
+
+PitchCache::Stats PitchCache::stats() const {
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.renders = renders_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.bytes = bytes_.load(std::memory_order_relaxed);
+    stats.entries = readyEntries_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PitchCache::run() {
+    Job job;
+    for (;;) {
+        wakeup_.wait();
+        if (!running_.load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (jobs_.pop(job)) {
+            doJob(job);
+        }
+    }
+}
+
+void PitchCache::doJob(const Job& job) {
+    if (!job.render) {
+        std::vector<float>().swap(buffers_[static_cast<size_t>(job.entry)]);
+    } else {
+        renderJob(job);
+    }
+}
+
+// Renders output frame k from source position k * step. Copies that would not
+// fit the budget on their own are refused, as are steps beyond the rate range.
+void PitchCache::renderJob(const Job& job) {
+    const SampleZone& zone = job.source;
+    const size_t channels = static_cast<size_t>(zone.channels);
+    std::vector<float>& buffer = buffers_[static_cast<size_t>(job.entry)];
+    Done done;
+    done.entry = job.entry;
+    const double fromRate = std::round(job.step * kPitchScale);
+    const int toRate = static_cast<int>(kPitchScale);
+    if (fromRate >= 1.0 && fromRate <= static_cast<double>(std::numeric_limits<int>::max()) &&
+        resampledFrames(zone.frames, static_cast<int>(fromRate), toRate) * channels * sizeof(float) <=
+            budgetBytes_) {
+        try {
+            std::vector<float> interleaved;
+            const float* input = zone.data;
+            if (zone.format == SampleFormat::Int16Planar) {
+                interleaved.resize(zone.frames * channels);
+                for (size_t frame = 0; frame < zone.frames; ++frame) {
+                    for (size_t channel = 0; channel < channels; ++channel) {
+                        interleaved[frame * channels + channel] =
+                            static_cast<float>(zone.pcm[channel * zone.planeStride + frame]) * kInt16Scale;
+                    }
+                }
+                input = interleaved.data();
+            }
+            buffer = resample(input, zone.frames, zone.channels, static_cast<int>(fromRate), toRate, quality_);
+            done.data = buffer.data();
+            done.frames = buffer.size() / channels;
+        } catch (const std::exception&) {
+            std::vector<float>().swap(buffer);
+        }
+    }
+    done_.push(done);
+}
@@ -0,0 +1,82 @@
+#include "ProgressiveSample.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+ProgressiveSample::ProgressiveSample(const std::string& path, int rootNote)
+    : file_(path),
+      format_(readWavFormat(path)) {
+    const size_t frames = format_.frames();
+    if (frames == 0) {
+        throw std::runtime_error("WAV filen indeholder ingen samples");
+    }
+    if (format_.dataOffset + frames * format_.bytesPerFrame() > file_.size()) {
+        throw std::runtime_error("Kunne ikke læse WAV data: " + path);
+    }
+    const size_t channels = static_cast<size_t>(format_.channels);
+    samples_.reset(new float[frames * channels]);
+
+    const size_t loopStart = static_cast<size_t>(format_.loopStart);
+    const size_t loopEnd = static_cast<size_t>(format_.loopEnd);
+    const bool looped = loopStart < loopEnd && loopEnd <= frames;
+    zone_.rootNote = rootNote;
+    zone_.sampleRate = format_.sampleRate;
+    zone_.channels = format_.channels;
+    zone_.data = samples_.get();
+    zone_.frames = frames;
+    zone_.loopStart = looped ? loopStart : 0;
+    zone_.loopEnd = looped ? loopEnd : 0;
+    zone_.decoded = &decoded_;
+
+    decode(0, std::min(kFirstChunkFrames, frames));
+    if (!complete()) {
+        thread_ = std::thread(&ProgressiveSample::run, this);
+    }
+}
+
+ProgressiveSample::~ProgressiveSample() {
+    running_.store(false, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+WavData ProgressiveSample::waitForData() const {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        completed_.wait(lock, [&] { return complete(); });
+    }
+    WavData wav;
+    wav.sampleRate = zone_.sampleRate;
+    wav.channels = zone_.channels;
+    wav.loopStart = zone_.loopStart;
+    wav.loopEnd = zone_.loopEnd;
+    wav.samples.assign(samples_.get(), samples_.get() + zone_.frames * static_cast<size_t>(zone_.channels));
+    return wav;
+}
+
+void ProgressiveSample::run() {
+    while (running_.load(std::memory_order_relaxed) && !complete()) {
+        const size_t first = decodedFrames();
+        decode(first, std::min(kChunkFrames, zone_.frames - first));
+    }
+    // Taking the lock orders the notification after a waiter's check.
+    { const std::lock_guard<std::mutex> lock(mutex_); }
+    completed_.notify_all();
+}
+
+// Decodes [first, first + count) and publishes it, then drops the source
+// pages, which are not read again. The next chunk is prefetched meanwhile.
+void ProgressiveSample::decode(size_t first, size_t count) {
+    const size_t bytesPerFrame = format_.bytesPerFrame();
+    const size_t offset = static_cast<size_t>(format_.dataOffset) + first * bytesPerFrame;
+    const size_t bytes = count * bytesPerFrame;
+    file_.prefetch(offset + bytes, kChunkFrames * bytesPerFrame);
+    decodeWavSamples(file_.data() + offset,
+                     count * static_cast<size_t>(format_.channels),
+                     format_,
+                     samples_.get() + first * static_cast<size_t>(format_.channels));
+    decoded_.store(first + count, std::memory_order_release);
+    const size_t pageStart = offset - offset % MappedFile::pageSize();
+    file_.evict(pageStart, offset + bytes - pageStart);
+}
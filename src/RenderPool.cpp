@@ -0,0 +1,176 @@
+#include "RenderPool.h"
+
+#include "Denormals.h"
+
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+constexpr auto kSpinTime = std::chrono::microseconds(200);
+constexpr int kCallerSpins = 4096;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+uint64_t packRange(uint32_t front, uint32_t back) {
+    return static_cast<uint64_t>(front) | (static_cast<uint64_t>(back) << 32);
+}
+
+// Best effort; without the privilege the worker simply keeps normal priority.
+void requestRealtimePriority(std::thread& thread) {
+#if defined(__linux__) || defined(__APPLE__)
+    sched_param param{};
+    param.sched_priority = std::max(1, sched_get_priority_max(SCHED_FIFO) - 1);
+    pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+#else
+    (void)thread;
+#endif
+}
+
+} // namespace
+
+RenderPool::RenderPool(int threads)
+    : ranges_(static_cast<size_t>(std::max(1, threads))), wakeups_(new Semaphore[ranges_.size()]) {
+    for (int participant = 1; participant < threadCount(); ++participant) {
+        workers_.emplace_back([this, participant] { workerLoop(participant); });
+        requestRealtimePriority(workers_.back());
+    }
+}
+
+RenderPool::~RenderPool() {
+    running_.store(false, std::memory_order_relaxed);
+    for (int participant = 1; participant < threadCount(); ++participant) {
+        wakeups_[static_cast<size_t>(participant)].post();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void RenderPool::run(int count, Task task, void* context) {
+    if (count <= 0) {
+        return;
+    }
+    task_.store(task, std::memory_order_relaxed);
+    context_.store(context, std::memory_order_relaxed);
+    pending_.store(count, std::memory_order_relaxed);
+
+    const int participants = threadCount();
+    for (int participant = 0; participant < participants; ++participant) {
+        const uint32_t front = static_cast<uint32_t>(static_cast<int64_t>(count) * participant / participants);
+        const uint32_t back = static_cast<uint32_t>(static_cast<int64_t>(count) * (participant + 1) / participants);
+        ranges_[static_cast<size_t>(participant)].bounds.store(packRange(front, back), std::memory_order_release);
+    }
+
+    if (!workers_.empty()) {
+        epoch_.fetch_add(1, std::memory_order_release);
+        // Posting never blocks. A worker still spinning from the last job
+        // picks this one up without the post, which then only wakes it once
+        // for nothing.
+        for (int participant = 1; participant < participants; ++participant) {
+            wakeups_[static_cast<size_t>(participant)].post();
+        }
+    }
+
+    work(0);
+    // Only tasks already claimed by a worker remain; they are short, but a
+    // worker preempted mid-task must get the CPU back, hence the yield.
+    for (int spins = 0; pending_.load(std::memory_order_acquire) > 0; ++spins) {
+        if (spins < kCallerSpins) {
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void RenderPool::workerLoop(int participant) {
+    // Workers only ever run audio jobs; callers set their own mode (see
+    // VoiceManager::mix).
+    const ScopedFlushDenormals flushDenormals;
+    uint64_t seen = 0;
+    bool spin = false;
+    while (true) {
+        bool haveJob = false;
+        if (spin) {
+            const auto spinUntil = std::chrono::steady_clock::now() + kSpinTime;
+            while (!haveJob && std::chrono::steady_clock::now() < spinUntil) {
+                for (int i = 0; i < 64 && !haveJob; ++i) {
+                    haveJob = epoch_.load(std::memory_order_acquire) != seen;
+                    cpuRelax();
+                }
+            }
+        }
+        if (!haveJob) {
+            wakeups_[static_cast<size_t>(participant)].wait();
+            if (!running_.load(std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        spin = epoch != seen;
+        if (spin) {
+            seen = epoch;
+            work(participant);
+        }
+    }
+}
+
+void RenderPool::work(int participant) {
+    const int participants = threadCount();
+    int index = 0;
+    while (popFront(ranges_[static_cast<size_t>(participant)], index)) {
+        task_.load(std::memory_order_relaxed)(context_.load(std::memory_order_relaxed), index);
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    for (int offset = 1; offset < participants; ++offset) {
+        Range& victim = ranges_[static_cast<size_t>((participant + offset) % participants)];
+        while (popBack(victim, index)) {
+            task_.load(std::memory_order_relaxed)(context_.load(std::memory_order_relaxed), index);
+            pending_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+bool RenderPool::popFront(Range& range, int& index) {
+    uint64_t bounds = range.bounds.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t front = static_cast<uint32_t>(bounds);
+        const uint32_t back = static_cast<uint32_t>(bounds >> 32);
+        if (front >= back) {
+            return false;
+        }
+        if (range.bounds.compare_exchange_weak(
+                bounds, packRange(front + 1, back), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            index = static_cast<int>(front);
+            return true;
+        }
+    }
+}
+
+bool RenderPool::popBack(Range& range, int& index) {
+    uint64_t bounds = range.bounds.load(std::memory_order_acquire);
+    while (true) {
+        const uint32_t front = static_cast<uint32_t>(bounds);
+        const uint32_t back = static_cast<uint32_t>(bounds >> 32);
+        if (front >= back) {
+            return false;
+        }
+        if (range.bounds.compare_exchange_weak(
+                bounds, packRange(front, back - 1), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            index = static_cast<int>(back - 1);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,210 @@
+#include "Resampler.h"
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr size_t kMinFramesPerThread = 16384;
+
+double besselI0(double x) {
+    double term = 1.0;
+    double result = 1.0;
+    for (int k = 1; k < 64; ++k) {
+        const double factor = x / (2.0 * static_cast<double>(k));
+        term *= factor * factor;
+        result += term;
+        if (term < result * 1e-17) {
+            break;
+        }
+    }
+    return result;
+}
+
+struct Kernel {
+    int taps = 0;   // multiple of simd::kLanes
+    int before = 0; // taps ahead of floor(position)
+    uint64_t step = 0; // input frames per output frame is step / denominator
+    uint64_t denominator = 0;
+    size_t phases = 0;
+    bool exact = false; // one row per output phase, no interpolation
+    std::vector<float> coefficients; // (phases + 1) rows of `taps`
+};
+
+Kernel makeKernel(int fromRate, int toRate, const ResampleOptions& options) {
+    Kernel kernel;
+    const uint64_t divisor = std::gcd(static_cast<uint64_t>(fromRate), static_cast<uint64_t>(toRate));
+    kernel.step = static_cast<uint64_t>(fromRate) / divisor;
+    kernel.denominator = static_cast<uint64_t>(toRate) / divisor;
+    kernel.exact = kernel.denominator <= kMaxPhases;
+    kernel.phases = kernel.exact ? static_cast<size_t>(kernel.denominator) : kMaxPhases;
+
+    const double ratio = static_cast<double>(toRate) / static_cast<double>(fromRate);
+    const double cutoff = options.passband * std::min(1.0, ratio); // cycles per input frame
+    const int halfTaps = static_cast<int>(std::ceil(std::max(1, options.halfTaps) * std::max(1.0, 1.0 / ratio)));
+    kernel.taps = (2 * halfTaps + simd::kLanes - 1) / simd::kLanes * simd::kLanes;
+    kernel.before = halfTaps - 1;
+
+    const double halfWidth = static_cast<double>(halfTaps);
+    const double windowScale = 1.0 / besselI0(options.kaiserBeta);
+    const size_t taps = static_cast<size_t>(kernel.taps);
+    kernel.coefficients.assign((kernel.phases + 1) * taps, 0.0f);
+    std::vector<double> row(taps);
+    for (size_t phase = 0; phase <= kernel.phases; ++phase) {
+        const double fraction = static_cast<double>(phase) / static_cast<double>(kernel.phases);
+        double total = 0.0;
+        for (size_t tap = 0; tap < taps; ++tap) {
+            const double x = static_cast<double>(static_cast<int>(tap) - kernel.before) - fraction;
+            const double ratioToEdge = x / halfWidth;
+            double value = 0.0;
+            if (std::fabs(ratioToEdge) < 1.0) {
+                const double arg = 2.0 * cutoff * x;
+                const double sinc = arg == 0.0 ? 1.0 : std::sin(kPi * arg) / (kPi * arg);
+                const double window =
+                    besselI0(options.kaiserBeta * std::sqrt(1.0 - ratioToEdge * ratioToEdge)) * windowScale;
+                value = 2.0 * cutoff * sinc * window;
+            }
+            row[tap] = value;
+            total += value;
+        }
+        // Unity gain at DC for every phase.
+        for (size_t tap = 0; tap < taps; ++tap) {
+            kernel.coefficients[phase * taps + tap] = static_cast<float>(row[tap] / total);
+        }
+    }
+    return kernel;
+}
+
+float dot(const float* x, const float* c, int taps) {
+    simd::Float4 acc = simd::broadcast(0.0f);
+    for (int tap = 0; tap < taps; tap += simd::kLanes) {
+        acc = simd::madd(acc, simd::load(x + tap), simd::load(c + tap));
+    }
+    return simd::sum(acc);
+}
+
+// Output frames [begin, end) of one channel. `padded` holds the channel with
+// kernel.taps zero frames either side.
+void convolve(const Kernel& kernel,
+              const float* padded,
+              size_t begin,
+              size_t end,
+              int channels,
+              int channel,
+              float* output) {
+    const size_t taps = static_cast<size_t>(kernel.taps);
+    const size_t offset = taps - static_cast<size_t>(kernel.before);
+    for (size_t n = begin; n < end; ++n) {
+        const uint64_t numerator = static_cast<uint64_t>(n) * kernel.step;
+        const size_t index = static_cast<size_t>(numerator / kernel.denominator);
+        const uint64_t remainder = numerator % kernel.denominator;
+        const float* x = padded + index + offset;
+        float value = 0.0f;
+        if (kernel.exact) {
+            value = dot(x, kernel.coefficients.data() + static_cast<size_t>(remainder) * taps, kernel.taps);
+        } else {
+            const double phase = static_cast<double>(remainder) * static_cast<double>(kernel.phases) /
+                                 static_cast<double>(kernel.denominator);
+            const size_t row = std::min(static_cast<size_t>(phase), kernel.phases - 1);
+            const float t = static_cast<float>(phase - static_cast<double>(row));
+            const float a = dot(x, kernel.coefficients.data() + row * taps, kernel.taps);
+            const float b = dot(x, kernel.coefficients.data() + (row + 1) * taps, kernel.taps);
+            value = a + (b - a) * t;
+        }
+        output[n * static_cast<size_t>(channels) + static_cast<size_t>(channel)] = value;
+    }
+}
+
+} // namespace
+
+size_t resampledFrames(size_t frames, int fromRate, int toRate) {
+    const uint64_t scaled = static_cast<uint64_t>(frames) * static_cast<uint64_t>(toRate);
+    return static_cast<size_t>((scaled + static_cast<uint64_t>(fromRate) - 1) / static_cast<uint64_t>(fromRate));
+}
+
+void resampleLoop(size_t& loopStart, size_t& loopEnd, size_t frames, int fromRate, int toRate) {
+    if (loopEnd <= loopStart) {
+        return;
+    }
+    auto convert = [&](size_t frame) {
+        const uint64_t scaled = static_cast<uint64_t>(frame) * static_cast<uint64_t>(toRate);
+        return static_cast<size_t>((scaled + static_cast<uint64_t>(fromRate) / 2) / static_cast<uint64_t>(fromRate));
+    };
+    loopStart = convert(loopStart);
+    loopEnd = std::min(frames, convert(loopEnd));
+    if (loopEnd <= loopStart) {
+        loopStart = 0;
+        loopEnd = 0;
+    }
+}
+
+std::vector<float> resample(const float* input,
+                            size_t frames,
+                            int channels,
+                            int fromRate,
+                            int toRate,
+                            const ResampleOptions& options) {
+    const size_t stride = static_cast<size_t>(channels);
+    if (fromRate == toRate || fromRate <= 0 || toRate <= 0) {
+        return std::vector<float>(input, input + frames * stride);
+    }
+
+    const Kernel kernel = makeKernel(fromRate, toRate, options);
+    const size_t outputFrames = resampledFrames(frames, fromRate, toRate);
+    std::vector<float> output(outputFrames * stride);
+
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threads = std::clamp<size_t>(options.threads > 0 ? static_cast<size_t>(options.threads) : hardware,
+                                              1,
+                                              std::max<size_t>(1, outputFrames / kMinFramesPerThread));
+
+    const size_t pad = static_cast<size_t>(kernel.taps);
+    std::vector<float> padded(frames + 2 * pad, 0.0f);
+    for (int channel = 0; channel < channels; ++channel) {
+        for (size_t i = 0; i < frames; ++i) {
+            padded[pad + i] = input[i * stride + static_cast<size_t>(channel)];
+        }
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                convolve(kernel,
+                         padded.data(),
+                         outputFrames * t / threads,
+                         outputFrames * (t + 1) / threads,
+                         channels,
+                         channel,
+                         output.data());
+            });
+        }
+        convolve(kernel, padded.data(), 0, outputFrames / threads, channels, channel, output.data());
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    return output;
+}
+
+SampleBank resampleBank(const SampleBank& bank,
+                        int sampleRate,
+                        std::vector<std::vector<float>>& storage,
+                        const ResampleOptions& options) {
+    std::vector<SampleZone> zones = bank.zones();
+    for (SampleZone& zone : zones) {
+        if (zone.stream || zone.format != SampleFormat::Float32 || zone.sampleRate == sampleRate) {
+            continue;
+        }
+        storage.push_back(resample(zone.data, zone.frames, zone.channels, zone.sampleRate, sampleRate, options));
+        zone.data = storage.back().data();
+        zone.frames = storage.back().size() / static_cast<size_t>(zone.channels);
+        zone.headFrames = zone.frames;
+        resampleLoop(zone.loopStart, zone.loopEnd, zone.frames, zone.sampleRate, sampleRate);
+        zone.sampleRate = sampleRate;
+    }
+    return SampleBank::fromZones(std::move(zones));
+}
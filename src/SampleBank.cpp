@@ -0,0 +1,293 @@
+#include "SampleBank.h"
+
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr char kMagic[4] = {'W', 'V', 'B', 'K'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kZoneRecordSize = 48;
+
+uint32_t readU32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t readU64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+void putU64(unsigned char* p, uint64_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+SampleBank SampleBank::open(const std::string& path) {
+    SampleBank bank;
+    bank.file_ = MappedFile(path);
+    const unsigned char* bytes = bank.file_.data();
+    const size_t size = bank.file_.size();
+
+    if (size < kHeaderSize || std::memcmp(bytes, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Ikke en sample bank: " + path);
+    }
+    if (readU32(bytes + 4) != kVersion) {
+        throw std::runtime_error("Ukendt sample bank version: " + path);
+    }
+
+    const uint32_t zoneCount = readU32(bytes + 8);
+    const uint64_t poolOffset = readU64(bytes + 16);
+    const uint64_t poolBytes = readU64(bytes + 24);
+    if (kHeaderSize + static_cast<size_t>(zoneCount) * kZoneRecordSize > size || poolOffset > size ||
+        poolBytes > size - poolOffset || poolOffset % sizeof(float) != 0) {
+        throw std::runtime_error("Beskadiget sample bank: " + path);
+    }
+
+    bank.zones_.reserve(zoneCount);
+    for (uint32_t i = 0; i < zoneCount; ++i) {
+        const unsigned char* record = bytes + kHeaderSize + i * kZoneRecordSize;
+        SampleZone zone;
+        zone.lowKey = record[0];
+        zone.highKey = record[1];
+        zone.lowVelocity = record[2];
+        zone.highVelocity = record[3];
+        zone.rootNote = record[4];
+        zone.sampleRate = static_cast<int>(readU32(record + 8));
+        zone.channels = static_cast<int>(readU32(record + 12));
+        zone.frames = static_cast<size_t>(readU64(record + 16));
+        const uint64_t offset = readU64(record + 24);
+        zone.loopStart = static_cast<size_t>(readU64(record + 32));
+        zone.loopEnd = static_cast<size_t>(readU64(record + 40));
+
+        const uint64_t byteCount = zone.frames * static_cast<uint64_t>(zone.channels) * sizeof(float);
+        if (zone.channels <= 0 || zone.frames == 0 || zone.sampleRate <= 0 || offset % sizeof(float) != 0 ||
+            offset > poolBytes || byteCount > poolBytes - offset || zone.loopEnd > zone.frames ||
+            (zone.loopEnd > 0 && zone.loopStart >= zone.loopEnd)) {
+            throw std::runtime_error("Beskadiget zone i sample bank: " + path);
+        }
+        zone.data = reinterpret_cast<const float*>(bytes + poolOffset + offset);
+
+        // Fault in the head of each sample so note onsets do not wait on disk.
+        bank.file_.prefetch(poolOffset + offset, std::min<uint64_t>(byteCount, SampleBank::kPoolAlignment * 4));
+        bank.zones_.push_back(zone);
+    }
+
+    bank.indexZones();
+    return bank;
+}
+
+SampleBank SampleBank::fromSample(const float* data,
+                                  size_t frames,
+                                  int channels,
+                                  int sampleRate,
+                                  int rootNote,
+                                  size_t loopStart,
+                                  size_t loopEnd) {
+    SampleBank bank;
+    SampleZone zone;
+    zone.rootNote = rootNote;
+    zone.sampleRate = sampleRate;
+    zone.channels = channels;
+    zone.data = data;
+    zone.frames = frames;
+    if (loopStart < loopEnd && loopEnd <= frames) {
+        zone.loopStart = loopStart;
+        zone.loopEnd = loopEnd;
+    }
+    bank.zones_.push_back(zone);
+    bank.indexZones();
+    return bank;
+}
+
+SampleBank SampleBank::fromZones(std::vector<SampleZone> zones) {
+    SampleBank bank;
+    bank.zones_ = std::move(zones);
+    bank.indexZones();
+    return bank;
+}
+
+SampleBank SampleBank::fromZones(std::vector<SampleZone> zones, MappedFile file) {
+    SampleBank bank = fromZones(std::move(zones));
+    bank.file_ = std::move(file);
+    return bank;
+}
+
+SampleBank compactBank(const SampleBank& bank, std::vector<std::vector<int16_t>>& storage) {
+    constexpr size_t kAlignSamples = kPlaneAlignment / sizeof(int16_t);
+    std::vector<SampleZone> zones = bank.zones();
+    for (SampleZone& zone : zones) {
+        if (zone.stream || zone.format != SampleFormat::Float32) {
+            continue;
+        }
+        const size_t channels = static_cast<size_t>(zone.channels);
+        const size_t planeStride = (zone.frames + kPlanePadding + kAlignSamples - 1) / kAlignSamples * kAlignSamples;
+        std::vector<int16_t> samples(channels * planeStride + kAlignSamples, 0);
+        const size_t misalignment = reinterpret_cast<uintptr_t>(samples.data()) % kPlaneAlignment;
+        int16_t* planes = samples.data() + (misalignment ? (kPlaneAlignment - misalignment) / sizeof(int16_t) : 0);
+        for (size_t channel = 0; channel < channels; ++channel) {
+            int16_t* plane = planes + channel * planeStride;
+            for (size_t frame = 0; frame < zone.frames; ++frame) {
+                const float scaled = std::round(zone.data[frame * channels + channel] * 32768.0f);
+                plane[frame] = static_cast<int16_t>(std::clamp(scaled, -32768.0f, 32767.0f));
+            }
+        }
+        storage.push_back(std::move(samples));
+        zone.format = SampleFormat::Int16Planar;
+        zone.data = nullptr;
+        zone.pcm = planes;
+        zone.planeStride = planeStride;
+    }
+    return SampleBank::fromZones(std::move(zones));
+}
+
+bool SampleBank::hasStreamedZones() const {
+    return std::any_of(zones_.begin(), zones_.end(), [](const SampleZone& zone) { return zone.stream != nullptr; });
+}
+
+const SampleZone* SampleBank::findZone(int midiNote, int velocity) const {
+    if (midiNote < 0 || midiNote > 127) {
+        return nullptr;
+    }
+    for (uint32_t index : zonesByKey_[static_cast<size_t>(midiNote)]) {
+        const SampleZone& zone = zones_[index];
+        if (velocity >= zone.lowVelocity && velocity <= zone.highVelocity) {
+            return &zone;
+        }
+    }
+    return nullptr;
+}
+
+void SampleBank::indexZones() {
+    for (auto& list : zonesByKey_) {
+        list.clear();
+    }
+    for (uint32_t i = 0; i < zones_.size(); ++i) {
+        const SampleZone& zone = zones_[i];
+        for (int key = std::max(0, zone.lowKey); key <= std::min(127, zone.highKey); ++key) {
+            zonesByKey_[static_cast<size_t>(key)].push_back(i);
+        }
+    }
+}
+
+void writeSampleBank(const std::string& path, const std::vector<BankZoneSpec>& zones) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Kunne ikke skrive sample bank: " + path);
+    }
+
+    const size_t poolOffset = alignUp(kHeaderSize + zones.size() * kZoneRecordSize, SampleBank::kPoolAlignment);
+    std::vector<unsigned char> table(poolOffset, 0);
+    std::memcpy(table.data(), kMagic, sizeof(kMagic));
+    putU32(table.data() + 4, kVersion);
+    putU32(table.data() + 8, static_cast<uint32_t>(zones.size()));
+    putU32(table.data() + 12, static_cast<uint32_t>(SampleBank::kPoolAlignment));
+    putU64(table.data() + 16, poolOffset);
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size()));
+
+    // Samples are decoded one at a time so building large banks stays cheap.
+    const std::vector<char> padding(SampleBank::kPoolAlignment, 0);
+    size_t poolBytes = 0;
+    for (size_t i = 0; i < zones.size(); ++i) {
+        const BankZoneSpec& spec = zones[i];
+        WavData wav = readWav(spec.samplePath);
+        if (spec.explicitLoop) {
+            wav.setLoop(spec.loopStart, spec.loopEnd);
+        }
+        crossfadeLoop(wav, spec.crossfadeFrames);
+        const size_t byteCount = wav.samples.size() * sizeof(float);
+
+        unsigned char* record = table.data() + kHeaderSize + i * kZoneRecordSize;
+        record[0] = static_cast<unsigned char>(std::clamp(spec.lowKey, 0, 127));
+        record[1] = static_cast<unsigned char>(std::clamp(spec.highKey, 0, 127));
+        record[2] = static_cast<unsigned char>(std::clamp(spec.lowVelocity, 0, 127));
+        record[3] = static_cast<unsigned char>(std::clamp(spec.highVelocity, 0, 127));
+        record[4] = static_cast<unsigned char>(std::clamp(spec.rootNote, 0, 127));
+        putU32(record + 8, static_cast<uint32_t>(wav.sampleRate));
+        putU32(record + 12, static_cast<uint32_t>(wav.channels));
+        putU64(record + 16, wav.frames());
+        putU64(record + 24, poolBytes);
+        putU64(record + 32, wav.loopStart);
+        putU64(record + 40, wav.loopEnd);
+
+        out.write(reinterpret_cast<const char*>(wav.samples.data()), static_cast<std::streamsize>(byteCount));
+        const size_t padded = alignUp(byteCount, SampleBank::kPoolAlignment);
+        out.write(padding.data(), static_cast<std::streamsize>(padded - byteCount));
+        poolBytes += padded;
+    }
+
+    putU64(table.data() + 24, poolBytes);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size()));
+    if (!out) {
+        throw std::runtime_error("Fejl under skrivning af sample bank: " + path);
+    }
+}
+
+std::vector<BankZoneSpec> readBankManifest(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Kunne ikke åbne manifest: " + path);
+    }
+
+    std::vector<BankZoneSpec> zones;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        BankZoneSpec zone;
+        if (!(fields >> zone.samplePath >> zone.lowKey >> zone.highKey >> zone.lowVelocity >> zone.highVelocity >>
+              zone.rootNote)) {
+            throw std::runtime_error("Ugyldig linje " + std::to_string(lineNumber) + " i " + path);
+        }
+        std::string loopStart;
+        std::string loopEnd;
+        if (fields >> loopStart) {
+            if (!(fields >> loopEnd) || (loopStart == "-") != (loopEnd == "-")) {
+                throw std::runtime_error("Ugyldig loop på linje " + std::to_string(lineNumber) + " i " + path);
+            }
+            if (loopStart != "-") {
+                zone.explicitLoop = true;
+                zone.loopStart = static_cast<size_t>(std::max(0LL, std::atoll(loopStart.c_str())));
+                zone.loopEnd = static_cast<size_t>(std::max(0LL, std::atoll(loopEnd.c_str())));
+            }
+            long long crossfade = 0;
+            if (fields >> crossfade) {
+                zone.crossfadeFrames = static_cast<size_t>(std::max(0LL, crossfade));
+            }
+        }
+        const std::filesystem::path samplePath(zone.samplePath);
+        if (samplePath.is_relative()) {
+            zone.samplePath = (std::filesystem::path(path).parent_path() / samplePath).string();
+        }
+        zones.push_back(zone);
+    }
+    return zones;
+}
@@ -0,0 +1,392 @@
+#include "SampleCache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kEntryMagic[4] = {'W', 'V', 'S', 'C'};
+constexpr char kSourceMagic[4] = {'W', 'V', 'S', 'R'};
+// Bump whenever decoding, conversion or the entry layout changes.
+constexpr uint32_t kVersion = 2;
+constexpr size_t kEntryHeaderSize = 2 * kPlaneAlignment; // data starts on a plane boundary
+constexpr size_t kSourceRecordSize = 32;
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint32_t readU32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t readU64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void putU32(unsigned char* p, uint32_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+void putU64(unsigned char* p, uint64_t value) {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t hashRound(uint64_t accumulator, uint64_t input) {
+    return rotateLeft(accumulator + input * kPrime2, 31) * kPrime1;
+}
+
+std::string hex(uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+uint64_t settingsHash(const SampleCacheSettings& settings) {
+    unsigned char key[64] = {};
+    putU32(key, kVersion);
+    putU32(key + 4, static_cast<uint32_t>(settings.sampleRate));
+    putU32(key + 8, static_cast<uint32_t>(settings.format));
+    putU32(key + 12, static_cast<uint32_t>(settings.resample.halfTaps));
+    std::memcpy(key + 16, &settings.resample.passband, sizeof(double));
+    std::memcpy(key + 24, &settings.resample.kaiserBeta, sizeof(double));
+    putU32(key + 32, settings.explicitLoop ? 1 : 0);
+    putU64(key + 40, settings.explicitLoop ? settings.loopStart : 0);
+    putU64(key + 48, settings.explicitLoop ? settings.loopEnd : 0);
+    putU64(key + 56, settings.crossfadeFrames);
+    return hashBytes(key, sizeof(key));
+}
+
+size_t zoneDataBytes(const SampleZone& zone) {
+    const size_t channels = static_cast<size_t>(zone.channels);
+    return zone.format == SampleFormat::Int16Planar ? channels * zone.planeStride * sizeof(int16_t)
+                                                    : channels * zone.frames * sizeof(float);
+}
+
+// Writes `header` and `payload` next to `path`, then renames the result into
+// place. Returns false (leaving nothing behind) on any failure.
+bool writeAtomically(const fs::path& path, const void* header, size_t headerBytes, const void* payload, size_t payloadBytes) {
+    fs::path temporary = path;
+    temporary += ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(static_cast<const char*>(header), static_cast<std::streamsize>(headerBytes));
+        out.write(static_cast<const char*>(payload), static_cast<std::streamsize>(payloadBytes));
+        if (!out) {
+            std::error_code ignored;
+            fs::remove(temporary, ignored);
+            return false;
+        }
+    }
+    std::error_code error;
+    fs::rename(temporary, path, error);
+    if (error) {
+        fs::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+// Content hash of `path`. The per-path record lets unchanged files skip
+// hashing; when a file has changed, entries made from its old contents are
+// removed. nullopt when the file cannot be read, or with `recordedOnly` when
+// the record does not match the file (which is then left alone).
+std::optional<uint64_t> sourceHash(const fs::path& directory, const std::string& path, bool recordedOnly = false) {
+    std::error_code error;
+    const uint64_t size = fs::file_size(path, error);
+    if (error) {
+        return std::nullopt;
+    }
+    const int64_t modified = static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+    if (error) {
+        return std::nullopt;
+    }
+    const std::string absolute = fs::absolute(path, error).lexically_normal().string();
+    const fs::path recordPath = directory / (hex(hashBytes(absolute.data(), absolute.size())) + ".src");
+
+    unsigned char record[kSourceRecordSize] = {};
+    std::optional<uint64_t> previous;
+    {
+        std::ifstream in(recordPath, std::ios::binary);
+        if (in.read(reinterpret_cast<char*>(record), sizeof(record)) &&
+            std::memcmp(record, kSourceMagic, sizeof(kSourceMagic)) == 0 && readU32(record + 4) == kVersion) {
+            if (readU64(record + 8) == size && static_cast<int64_t>(readU64(record + 16)) == modified) {
+                return readU64(record + 24);
+            }
+            previous = readU64(record + 24);
+        }
+    }
+    if (recordedOnly) {
+        return std::nullopt;
+    }
+
+    uint64_t hash = 0;
+    try {
+        const MappedFile source(path);
+        hash = hashBytes(source.data(), source.size());
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+
+    if (previous && *previous != hash) {
+        const std::string stalePrefix = hex(*previous) + "-";
+        for (const auto& entry : fs::directory_iterator(directory, error)) {
+            const std::string name = entry.path().filename().string();
+            if (name.compare(0, stalePrefix.size(), stalePrefix) == 0) {
+                std::error_code ignored;
+                fs::remove(entry.path(), ignored);
+            }
+        }
+    }
+
+    std::memcpy(record, kSourceMagic, sizeof(kSourceMagic));
+    putU32(record + 4, kVersion);
+    putU64(record + 8, size);
+    putU64(record + 16, static_cast<uint64_t>(modified));
+    putU64(record + 24, hash);
+    writeAtomically(recordPath, record, sizeof(record), nullptr, 0);
+    return hash;
+}
+
+fs::path entryPathFor(const fs::path& directory, uint64_t contentHash, uint64_t settingsKey) {
+    return directory / (hex(contentHash) + "-" + hex(settingsKey) + ".wsc");
+}
+
+// Maps an entry and checks it against the key and settings it should hold.
+std::optional<SampleBank> openEntry(const fs::path& path,
+                                    uint64_t contentHash,
+                                    uint64_t settingsKey,
+                                    const SampleCacheSettings& settings,
+                                    int rootNote) {
+    std::error_code error;
+    if (!fs::is_regular_file(path, error)) {
+        return std::nullopt;
+    }
+    MappedFile file;
+    try {
+        file = MappedFile(path.string());
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+
+    const unsigned char* bytes = file.data();
+    if (file.size() < kEntryHeaderSize || std::memcmp(bytes, kEntryMagic, sizeof(kEntryMagic)) != 0 ||
+        readU32(bytes + 4) != kVersion || readU64(bytes + 8) != contentHash || readU64(bytes + 16) != settingsKey) {
+        return std::nullopt;
+    }
+
+    SampleZone zone;
+    zone.rootNote = rootNote;
+    zone.sampleRate = static_cast<int>(readU32(bytes + 24));
+    zone.channels = static_cast<int>(readU32(bytes + 28));
+    zone.format = readU32(bytes + 32) == static_cast<uint32_t>(SampleFormat::Int16Planar) ? SampleFormat::Int16Planar
+                                                                                          : SampleFormat::Float32;
+    zone.frames = static_cast<size_t>(readU64(bytes + 40));
+    zone.planeStride = static_cast<size_t>(readU64(bytes + 48));
+    zone.loopStart = static_cast<size_t>(readU64(bytes + 64));
+    zone.loopEnd = static_cast<size_t>(readU64(bytes + 72));
+    if (zone.sampleRate != settings.sampleRate || zone.format != settings.format || zone.channels <= 0 ||
+        zone.frames == 0 || (zone.format == SampleFormat::Int16Planar && zone.planeStride < zone.frames + kPlanePadding) ||
+        zone.loopEnd > zone.frames || (zone.loopEnd > 0 && zone.loopStart >= zone.loopEnd) ||
+        readU64(bytes + 56) != zoneDataBytes(zone) || file.size() != kEntryHeaderSize + zoneDataBytes(zone)) {
+        return std::nullopt;
+    }
+
+    if (zone.format == SampleFormat::Int16Planar) {
+        zone.pcm = reinterpret_cast<const int16_t*>(bytes + kEntryHeaderSize);
+    } else {
+        zone.data = reinterpret_cast<const float*>(bytes + kEntryHeaderSize);
+    }
+    // Start reading the whole sample in now rather than on the audio thread.
+    file.prefetch(kEntryHeaderSize, zoneDataBytes(zone));
+    return SampleBank::fromZones({zone}, std::move(file));
+}
+
+bool writeEntry(const fs::path& path, uint64_t contentHash, uint64_t settingsKey, const SampleZone& zone) {
+    unsigned char header[kEntryHeaderSize] = {};
+    std::memcpy(header, kEntryMagic, sizeof(kEntryMagic));
+    putU32(header + 4, kVersion);
+    putU64(header + 8, contentHash);
+    putU64(header + 16, settingsKey);
+    putU32(header + 24, static_cast<uint32_t>(zone.sampleRate));
+    putU32(header + 28, static_cast<uint32_t>(zone.channels));
+    putU32(header + 32, static_cast<uint32_t>(zone.format));
+    putU64(header + 40, zone.frames);
+    putU64(header + 48, zone.planeStride);
+    putU64(header + 56, zoneDataBytes(zone));
+    putU64(header + 64, zone.loopStart);
+    putU64(header + 72, zone.loopEnd);
+    const void* payload = zone.format == SampleFormat::Int16Planar ? static_cast<const void*>(zone.pcm)
+                                                                   : static_cast<const void*>(zone.data);
+    return writeAtomically(path, header, sizeof(header), payload, zoneDataBytes(zone));
+}
+
+void decodeSample(CachedSample& result,
+                  const std::string& path,
+                  const SampleCacheSettings& settings,
+                  int rootNote,
+                  const SampleCache::Decoder& decode) {
+    WavData wav = decode(path);
+    if (wav.channels <= 0 || wav.frames() == 0) {
+        throw std::runtime_error("WAV filen indeholder ingen samples");
+    }
+    if (settings.explicitLoop) {
+        wav.setLoop(settings.loopStart, settings.loopEnd);
+    }
+    crossfadeLoop(wav, settings.crossfadeFrames);
+    if (wav.sampleRate != settings.sampleRate) {
+        wav.samples = resample(
+            wav.samples.data(), wav.frames(), wav.channels, wav.sampleRate, settings.sampleRate, settings.resample);
+        resampleLoop(wav.loopStart, wav.loopEnd, wav.frames(), wav.sampleRate, settings.sampleRate);
+    }
+    result.samples = std::move(wav.samples);
+    result.bank = SampleBank::fromSample(result.samples.data(),
+                                         result.samples.size() / static_cast<size_t>(wav.channels),
+                                         wav.channels,
+                                         settings.sampleRate,
+                                         rootNote,
+                                         wav.loopStart,
+                                         wav.loopEnd);
+    if (settings.format == SampleFormat::Int16Planar) {
+        result.bank = compactBank(result.bank, result.compactStorage);
+        result.samples = std::vector<float>();
+    }
+}
+
+} // namespace
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    // xxHash64-style: four independent lanes over 32-byte stripes.
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + size;
+    uint64_t hash = 0;
+    if (size >= 32) {
+        uint64_t lanes[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+        for (; end - p >= 32; p += 32) {
+            for (int lane = 0; lane < 4; ++lane) {
+                lanes[lane] = hashRound(lanes[lane], readU64(p + lane * 8));
+            }
+        }
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (uint64_t lane : lanes) {
+            hash = (hash ^ hashRound(0, lane)) * kPrime1 + kPrime4;
+        }
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += size;
+    for (; end - p >= 8; p += 8) {
+        hash = rotateLeft(hash ^ hashRound(0, readU64(p)), 27) * kPrime1 + kPrime4;
+    }
+    if (end - p >= 4) {
+        hash = rotateLeft(hash ^ (readU32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash = rotateLeft(hash ^ (*p * kPrime5), 11) * kPrime1;
+    }
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+SampleCache::SampleCache(std::string directory) : directory_(std::move(directory)) {}
+
+std::string SampleCache::defaultDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return (fs::path(xdg) / "wave-player").string();
+    }
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) {
+        return {};
+    }
+#ifdef __APPLE__
+    return (fs::path(home) / "Library" / "Caches" / "wave-player").string();
+#else
+    return (fs::path(home) / ".cache" / "wave-player").string();
+#endif
+}
+
+std::optional<CachedSample> SampleCache::find(const std::string& path,
+                                             const SampleCacheSettings& settings,
+                                             int rootNote) const {
+    if (directory_.empty()) {
+        return std::nullopt;
+    }
+    const fs::path directory(directory_);
+    const std::optional<uint64_t> contentHash = sourceHash(directory, path, true);
+    if (!contentHash) {
+        return std::nullopt;
+    }
+    const uint64_t settingsKey = settingsHash(settings);
+    std::optional<SampleBank> bank =
+        openEntry(entryPathFor(directory, *contentHash, settingsKey), *contentHash, settingsKey, settings, rootNote);
+    if (!bank) {
+        return std::nullopt;
+    }
+    CachedSample result;
+    result.bank = std::move(*bank);
+    result.hit = true;
+    return result;
+}
+
+CachedSample SampleCache::load(const std::string& path,
+                               const SampleCacheSettings& settings,
+                               int rootNote,
+                               const Decoder& decode) const {
+    CachedSample result;
+    std::error_code error;
+    if (directory_.empty() || (fs::create_directories(directory_, error), error)) {
+        decodeSample(result, path, settings, rootNote, decode);
+        return result;
+    }
+
+    const fs::path directory(directory_);
+    const std::optional<uint64_t> contentHash = sourceHash(directory, path);
+    if (!contentHash) {
+        decodeSample(result, path, settings, rootNote, decode);
+        return result;
+    }
+    const uint64_t settingsKey = settingsHash(settings);
+    const fs::path entryPath = entryPathFor(directory, *contentHash, settingsKey);
+
+    if (std::optional<SampleBank> bank = openEntry(entryPath, *contentHash, settingsKey, settings, rootNote)) {
+        result.bank = std::move(*bank);
+        result.hit = true;
+        return result;
+    }
+
+    decodeSample(result, path, settings, rootNote, decode);
+    // Serve the fresh entry from its mapping too, so the decoded copy can go.
+    if (writeEntry(entryPath, *contentHash, settingsKey, result.bank.zones().front())) {
+        if (std::optional<SampleBank> bank = openEntry(entryPath, *contentHash, settingsKey, settings, rootNote)) {
+            result.bank = std::move(*bank);
+            result.samples = std::vector<float>();
+            result.compactStorage.clear();
+        }
+    }
+    return result;
+}
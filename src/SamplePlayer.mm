@@ -79,8 +79,8 @@
         return NO;
     }
 
-    [self stopAllVoices];
-
+    // Sounding voices play their own faded copy of the old buffer and are
+    // left to finish; only new notes pick up this one.
     self.sampleBuffer = buffer;
     self.sampleFormat = buffer.format;
 
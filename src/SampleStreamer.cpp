@@ -0,0 +1,260 @@
+#include "SampleStreamer.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint64_t kFrameMask = (uint64_t{1} << 48) - 1;
+
+uint64_t packFilled(uint32_t generation, uint64_t frames) {
+    return (static_cast<uint64_t>(generation & 0xffff) << 48) | (frames & kFrameMask);
+}
+
+} // namespace
+
+StreamingSample::StreamingSample(const std::string& path, size_t headFrames, int rootNote)
+    : format_(readWavFormat(path)) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error("Kunne ikke åbne WAV fil: " + path);
+    }
+
+    const size_t frames = format_.frames();
+    if (frames == 0) {
+        ::close(fd_);
+        throw std::runtime_error("WAV filen indeholder ingen samples");
+    }
+    // A looped voice never reads past its loop, so the loop stays resident
+    // and such voices are never streamed.
+    const size_t loopEnd = static_cast<size_t>(format_.loopEnd);
+    const size_t resident = std::min(std::max({headFrames, kMinHeadFrames, loopEnd}), frames);
+    head_.resize(resident * static_cast<size_t>(format_.channels));
+    std::vector<unsigned char> scratch;
+    if (read(0, resident, head_.data(), scratch) != resident) {
+        ::close(fd_);
+        throw std::runtime_error("Kunne ikke læse WAV data: " + path);
+    }
+
+    lastFrame_.resize(static_cast<size_t>(format_.channels));
+    if (read(frames - 1, 1, lastFrame_.data(), scratch) != 1) {
+        ::close(fd_);
+        throw std::runtime_error("Kunne ikke læse WAV data: " + path);
+    }
+
+    zone_.rootNote = rootNote;
+    zone_.sampleRate = format_.sampleRate;
+    zone_.channels = format_.channels;
+    zone_.data = head_.data();
+    zone_.frames = frames;
+    zone_.headFrames = resident;
+    zone_.loopStart = static_cast<size_t>(format_.loopStart);
+    zone_.loopEnd = loopEnd;
+    zone_.stream = resident < frames ? this : nullptr;
+}
+
+StreamingSample::~StreamingSample() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+size_t StreamingSample::read(size_t first, size_t count, float* out, std::vector<unsigned char>& scratch) const {
+    const size_t frames = format_.frames();
+    if (first >= frames) {
+        return 0;
+    }
+    count = std::min(count, frames - first);
+
+    const size_t bytes = count * format_.bytesPerFrame();
+    scratch.resize(bytes);
+    size_t done = 0;
+    const off_t offset = static_cast<off_t>(format_.dataOffset + first * format_.bytesPerFrame());
+    while (done < bytes) {
+        const ssize_t got = ::pread(fd_, scratch.data() + done, bytes - done, offset + static_cast<off_t>(done));
+        if (got <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(got);
+    }
+
+    const size_t framesRead = done / format_.bytesPerFrame();
+    decodeWavSamples(scratch.data(), framesRead * static_cast<size_t>(format_.channels), format_, out);
+    return framesRead;
+}
+
+SampleStreamer::SampleStreamer(int slotCount, int maxChannels, Config config)
+    : config_(config), maxChannels_(std::max(1, maxChannels)) {
+    size_t ringFrames = 1;
+    while (ringFrames < config_.ringFrames) {
+        ringFrames <<= 1;
+    }
+    config_.ringFrames = ringFrames;
+    config_.chunkFrames = std::clamp<size_t>(config_.chunkFrames, 1, ringFrames / 2);
+
+    slots_.reserve(static_cast<size_t>(slotCount));
+    for (int i = 0; i < slotCount; ++i) {
+        auto slot = std::make_unique<Slot>();
+        slot->ring.resize((ringFrames + 2 * kGuardFrames) * static_cast<size_t>(maxChannels_));
+        slots_.push_back(std::move(slot));
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+SampleStreamer::~SampleStreamer() {
+    running_.store(false, std::memory_order_relaxed);
+    wake();
+    thread_.join();
+}
+
+void SampleStreamer::wake() {
+    if (!wakePending_.exchange(true, std::memory_order_acq_rel)) {
+        wakeup_.post();
+    }
+}
+
+void SampleStreamer::start(int slotIndex, const SampleZone& zone, size_t firstFrame, double step) {
+    Slot& slot = *slots_[static_cast<size_t>(slotIndex)];
+    const uint32_t generation = slot.generation.load(std::memory_order_relaxed);
+    slot.generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.zone.store(&zone, std::memory_order_relaxed);
+    slot.firstFrame.store(firstFrame, std::memory_order_relaxed);
+    slot.step.store(step, std::memory_order_relaxed);
+    slot.readFrame.store(firstFrame, std::memory_order_relaxed);
+    slot.generation.store(generation + 2, std::memory_order_release);
+    wake();
+}
+
+void SampleStreamer::stop(int slotIndex) {
+    Slot& slot = *slots_[static_cast<size_t>(slotIndex)];
+    const uint32_t generation = slot.generation.load(std::memory_order_relaxed);
+    slot.generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.zone.store(nullptr, std::memory_order_relaxed);
+    slot.generation.store(generation + 2, std::memory_order_release);
+}
+
+// The reader tops rings up a chunk at a time, so it is woken once per chunk
+// a voice moves into.
+void SampleStreamer::setReadPosition(int slotIndex, size_t frame) {
+    Slot& slot = *slots_[static_cast<size_t>(slotIndex)];
+    const uint64_t previous = slot.readFrame.load(std::memory_order_relaxed);
+    slot.readFrame.store(frame, std::memory_order_release);
+    if (frame / config_.chunkFrames != previous / config_.chunkFrames) {
+        wake();
+    }
+}
+
+bool SampleStreamer::window(int slotIndex, size_t frame, Window& out) const {
+    const Slot& slot = *slots_[static_cast<size_t>(slotIndex)];
+    const uint32_t generation = slot.generation.load(std::memory_order_relaxed);
+    const uint64_t filled = slot.filled.load(std::memory_order_acquire);
+    if ((filled >> 48) != (generation & 0xffff)) {
+        return false;
+    }
+
+    const size_t end = static_cast<size_t>(filled & kFrameMask);
+    const size_t ringFrames = config_.ringFrames;
+    const size_t first = frame - frame % ringFrames;
+    const SampleZone* zone = slot.zone.load(std::memory_order_relaxed);
+    const size_t begin = std::max({static_cast<size_t>(slot.firstFrame.load(std::memory_order_relaxed)),
+                                   first >= kGuardFrames ? first - kGuardFrames : size_t{0},
+                                   end >= ringFrames ? end - ringFrames : size_t{0}});
+    if (!zone || frame >= end || frame < begin) {
+        return false;
+    }
+
+    out.data = slot.ring.data() + kGuardFrames * static_cast<size_t>(zone->channels);
+    out.first = first;
+    out.begin = begin;
+    out.end = std::min(end, first + ringFrames + kGuardFrames);
+    return true;
+}
+
+bool SampleStreamer::service(Slot& slot, std::vector<float>& decoded, std::vector<unsigned char>& scratch) {
+    const uint32_t generation = slot.generation.load(std::memory_order_acquire);
+    if (generation & 1) {
+        return false;
+    }
+    const SampleZone* zone = slot.zone.load(std::memory_order_relaxed);
+    const uint64_t firstFrame = slot.firstFrame.load(std::memory_order_relaxed);
+    const double step = slot.step.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.generation.load(std::memory_order_relaxed) != generation || !zone || !zone->stream) {
+        return false;
+    }
+
+    if (slot.seenGeneration != generation) {
+        slot.seenGeneration = generation;
+        slot.writeFrame = firstFrame;
+    }
+
+    // Keep a lead proportional to the pitch step, bounded by the ring size
+    // (the writer may never overtake the oldest frame the voice can still read,
+    // including its interpolation history).
+    const uint64_t readFrame = std::max<uint64_t>(slot.readFrame.load(std::memory_order_acquire), firstFrame);
+    const double lead = static_cast<double>(config_.prefetchFrames) * std::max(1.0, step);
+    const uint64_t ringLimit = readFrame + config_.ringFrames - kGuardFrames;
+    const uint64_t target = std::min<uint64_t>({readFrame + static_cast<uint64_t>(lead), ringLimit, zone->frames});
+    if (slot.writeFrame >= target) {
+        return false;
+    }
+
+    const size_t channels = static_cast<size_t>(zone->channels);
+    const size_t count = std::min<size_t>(config_.chunkFrames, static_cast<size_t>(target - slot.writeFrame));
+    decoded.resize(count * channels);
+    const size_t got = zone->stream->read(static_cast<size_t>(slot.writeFrame), count, decoded.data(), scratch);
+    if (got == 0) {
+        return false;
+    }
+
+    const size_t ringFrames = config_.ringFrames;
+    float* ring = slot.ring.data() + kGuardFrames * channels;
+    for (size_t i = 0; i < got;) {
+        const size_t index = static_cast<size_t>((slot.writeFrame + i) % ringFrames);
+        const size_t run = std::min(got - i, ringFrames - index);
+        const float* source = decoded.data() + i * channels;
+        std::memcpy(ring + index * channels, source, run * channels * sizeof(float));
+        if (index < kGuardFrames) {
+            const size_t mirrored = std::min(run, kGuardFrames - index);
+            std::memcpy(ring + (ringFrames + index) * channels, source, mirrored * channels * sizeof(float));
+        }
+        if (index + run > ringFrames - kGuardFrames) {
+            const size_t from = std::max(index, ringFrames - kGuardFrames);
+            std::memcpy(ring - (ringFrames - from) * channels,
+                        source + (from - index) * channels,
+                        (index + run - from) * channels * sizeof(float));
+        }
+        i += run;
+    }
+
+    // A restart while we were reading makes this data stale; drop it.
+    if (slot.generation.load(std::memory_order_acquire) != generation) {
+        return false;
+    }
+    slot.writeFrame += got;
+    slot.filled.store(packFilled(generation, slot.writeFrame), std::memory_order_release);
+    return true;
+}
+
+void SampleStreamer::run() {
+    std::vector<float> decoded;
+    std::vector<unsigned char> scratch;
+    while (running_.load(std::memory_order_relaxed)) {
+        // Cleared before the pass, so a wake() during it is not lost; the
+        // exchange also makes the positions stored before that wake() visible.
+        wakePending_.exchange(false, std::memory_order_acq_rel);
+        bool busy = false;
+        for (auto& slot : slots_) {
+            busy = service(*slot, decoded, scratch) || busy;
+        }
+        if (!busy) {
+            wakeup_.wait();
+        }
+    }
+}
@@ -1,199 +1,1023 @@
 #include "VoiceManager.h"
 
+#include "Denormals.h"
+#include "MixKernels.h"
+
 #include <algorithm>
 #include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace {
 constexpr float kMinimumGain = 0.0001f;
+// Exponential stages aim this fraction of their range past their end level:
+// a gentle knee for attacks, close to a pure decay for the falling stages.
+constexpr float kAttackOvershoot = 0.3f;
+constexpr float kFallOvershoot = 0.001f;
+constexpr size_t kStreamRingBudgetFrames = size_t{1} << 21; // across all voices
+constexpr size_t kMinStreamRingFrames = size_t{1} << 14;
+
+// ceil(frames), at least one and saturating at INT_MAX (also for NaN).
+int wholeFrames(double frames) {
+    frames = std::ceil(frames);
+    return frames < static_cast<double>(std::numeric_limits<int>::max())
+               ? std::max(1, static_cast<int>(frames))
+               : std::numeric_limits<int>::max();
+}
+
+// Number of steps, at least one, before `position` reaches `limit`.
+int stepsUntil(double position, double step, double limit) {
+    return wholeFrames((limit - position) / step);
+}
+
+// Playhead arithmetic for the two phase formats, with frames as sample
+// indices. The double versions are the original floating-point tests; the
+// fixed-point ones are exact.
+size_t frameIndex(const mix::DoublePhase& phase) {
+    return static_cast<size_t>(phase.position);
+}
+
+size_t frameIndex(const mix::FixedPhase& phase) {
+    return static_cast<size_t>(phase.position >> 32);
+}
+
+bool reached(const mix::DoublePhase& phase, size_t frame) {
+    return phase.position >= static_cast<double>(frame);
+}
+
+bool reached(const mix::FixedPhase& phase, size_t frame) {
+    return phase.position >= static_cast<uint64_t>(frame) << 32;
+}
+
+int stepsUntil(const mix::DoublePhase& phase, size_t frame) {
+    return stepsUntil(phase.position, phase.step, static_cast<double>(frame));
 }
 
+int stepsUntil(const mix::FixedPhase& phase, size_t frame) {
+    const uint64_t limit = static_cast<uint64_t>(frame) << 32;
+    if (phase.position >= limit) {
+        return 1;
+    }
+    const uint64_t steps = (limit - phase.position + phase.step - 1) / phase.step;
+    return static_cast<int>(std::min<uint64_t>(steps, std::numeric_limits<int>::max()));
+}
+
+// At most `count` steps, all of which stay below `frame` (but at least one).
+int stepsBefore(const mix::DoublePhase& phase, size_t frame, int count) {
+    const double limit = static_cast<double>(frame);
+    count = std::min(count, stepsUntil(phase, frame));
+    while (count > 1 && phase.position + static_cast<double>(count - 1) * phase.step >= limit) {
+        --count;
+    }
+    return count;
+}
+
+int stepsBefore(const mix::FixedPhase& phase, size_t frame, int count) {
+    return std::min(count, stepsUntil(phase, frame));
+}
+
+mix::DoublePhase relativeTo(const mix::DoublePhase& phase, size_t origin) {
+    return {phase.position - static_cast<double>(origin), phase.step};
+}
+
+mix::FixedPhase relativeTo(const mix::FixedPhase& phase, size_t origin) {
+    return {phase.position - (static_cast<uint64_t>(origin) << 32), phase.step};
+}
+
+void advance(mix::DoublePhase& phase, int count) {
+    phase.position += static_cast<double>(count) * phase.step;
+}
+
+void advance(mix::FixedPhase& phase, int count) {
+    phase.position += static_cast<uint64_t>(count) * phase.step;
+}
+
+// Moves a playhead at or past `end` back by whole loop lengths into [start, end).
+void wrapInto(mix::DoublePhase& phase, size_t start, size_t end) {
+    phase.position = static_cast<double>(start) +
+                     std::fmod(phase.position - static_cast<double>(start), static_cast<double>(end - start));
+}
+
+void wrapInto(mix::FixedPhase& phase, size_t start, size_t end) {
+    const uint64_t origin = static_cast<uint64_t>(start) << 32;
+    phase.position = origin + (phase.position - origin) % (static_cast<uint64_t>(end - start) << 32);
+}
+} // namespace
+
 VoiceManager::VoiceManager(const std::vector<float>& sampleData,
                            int sampleRate,
                            int channels,
                            int outputChannels,
-                           int baseNote)
-    : sampleData_(sampleData),
+                           int baseNote,
+                           int maxVoices,
+                           int renderThreads)
+    : ownedBank_(SampleBank::fromSample(sampleData.data(),
+                                        sampleData.size() / static_cast<size_t>(channels),
+                                        channels,
+                                        sampleRate,
+                                        baseNote)),
       sampleRate_(sampleRate),
-      channels_(channels),
-      outputChannels_(outputChannels),
-      baseNote_(baseNote),
-      sampleFrames_(static_cast<int>(sampleData.size() / static_cast<size_t>(channels))) {
-    if (sampleFrames_ <= 0) {
-        sampleFrames_ = 1;
+      outputChannels_(outputChannels) {
+    initialise(ownedBank_, maxVoices, renderThreads);
+}
+
+VoiceManager::VoiceManager(
+    const SampleBank& bank, int sampleRate, int outputChannels, int maxVoices, int renderThreads)
+    : sampleRate_(sampleRate),
+      outputChannels_(outputChannels) {
+    initialise(bank, maxVoices, renderThreads);
+}
+
+void VoiceManager::setEnvelope(const EnvelopeSettings& envelope) {
+    envelope_ = envelope;
+    sustainLevel_ = static_cast<float>(std::clamp(envelope.sustainLevel, 0.0, 1.0));
+    const bool exponential = envelope.curve == EnvelopeCurve::Exponential;
+    // A stage from `from` to `to` lasting `seconds`; shorter than a frame
+    // becomes a one-frame linear step.
+    auto makeSegment = [&](float from, float to, double seconds, float overshoot) {
+        const double frames = seconds * static_cast<double>(sampleRate_);
+        Segment segment;
+        segment.end = to;
+        if (exponential && frames >= 1.0) {
+            segment.exponential = true;
+            segment.target = to + (to - from) * overshoot;
+            segment.logRatio = static_cast<float>(std::log(overshoot / (1.0 + overshoot)) / frames);
+            segment.ratio = std::exp(segment.logRatio);
+        } else {
+            segment.slope = static_cast<float>(static_cast<double>(to - from) / std::max(1.0, frames));
+        }
+        return segment;
+    };
+    attack_ = makeSegment(0.0f, 1.0f, envelope.attackSeconds, kAttackOvershoot);
+    decay_ = makeSegment(1.0f, sustainLevel_, envelope.decaySeconds, kFallOvershoot);
+    release_ = makeSegment(1.0f, 0.0f, envelope.releaseSeconds, kFallOvershoot);
+    release_.end = kMinimumGain;
+}
+
+void VoiceManager::setVirtualization(const VirtualizationSettings& settings) {
+    auto gainFor = [&](double decibels) {
+        return settings.enabled ? static_cast<float>(std::pow(10.0, decibels / 20.0)) : 0.0f;
+    };
+    maskRatio_.store(gainFor(settings.maskDb), std::memory_order_relaxed);
+    floorGain_.store(gainFor(settings.floorDb), std::memory_order_relaxed);
+}
+
+void VoiceManager::setPitchCache(const PitchCacheSettings& settings) {
+    pitchCache_.reset();
+    if (settings.budgetBytes > 0) {
+        pitchCache_ = std::make_unique<PitchCache>(sampleRate_, settings);
+    }
+}
+
+void VoiceManager::setReverb(const ImpulseResponse& impulse, const ReverbSettings& settings) {
+    reverb_.reset();
+    if (impulse.frames() > 0) {
+        reverb_ = std::make_unique<Convolver>(impulse, settings);
+    }
+}
+
+void VoiceManager::initialise(const SampleBank& bank, int maxVoices, int renderThreads) {
+    // The first bank is owned by the caller (or by ownedBank_), so its
+    // shared_ptr owns nothing.
+    const std::shared_ptr<const SampleBank> unowned(std::shared_ptr<const SampleBank>(), &bank);
+    publishedBanks_.push_back(std::make_unique<PublishedBank>(PublishedBank{unowned, 0}));
+    currentBank_.store(publishedBanks_.back().get(), std::memory_order_release);
+    bank_ = &bank;
+
+    setEnvelope(envelope_);
+    setVirtualization(VirtualizationSettings{});
+
+    maxVoices = std::max(1, maxVoices);
+    voices_.resize(static_cast<size_t>(maxVoices));
+    activeVoices_.reserve(voices_.size());
+    freeVoices_.reserve(voices_.size());
+    for (int i = maxVoices - 1; i >= 0; --i) {
+        freeVoices_.push_back(i);
+    }
+    heldVoiceForNote_.fill(-1);
+    scheduled_.reserve(kCommandQueueSize);
+
+    if (bank.hasStreamedZones()) {
+        int maxChannels = 1;
+        for (const auto& zone : bank.zones()) {
+            maxChannels = std::max(maxChannels, zone.channels);
+        }
+        // One ring per voice; shrink them at high polyphony to bound memory.
+        SampleStreamer::Config config;
+        config.ringFrames = std::max(kMinStreamRingFrames, kStreamRingBudgetFrames / voices_.size());
+        streamer_ = std::make_unique<SampleStreamer>(maxVoices, maxChannels, config);
+    }
+
+    if (renderThreads > 1) {
+        renderPool_ = std::make_unique<RenderPool>(renderThreads);
+        partialBuses_.resize(kMaxRenderChunks * 3 * kBlockSize);
+    }
+}
+
+void VoiceManager::publishBank(std::shared_ptr<const SampleBank> bank) {
+    if (!bank || bank->empty()) {
+        throw std::runtime_error("Sample banken indeholder ingen zoner");
     }
-    const double attackSeconds = 0.01;  // 10 ms ramp-in.
-    const double releaseSeconds = 0.05; // 50 ms ramp-out.
-    attackIncrement_ = attackSeconds <= 0.0
-                           ? 1.0f
-                           : static_cast<float>(1.0 / (attackSeconds * static_cast<double>(sampleRate_)));
-    releaseIncrement_ = releaseSeconds <= 0.0
-                            ? 1.0f
-                            : static_cast<float>(1.0 / (releaseSeconds * static_cast<double>(sampleRate_)));
-    attackIncrement_ = std::clamp(attackIncrement_, 0.0f, 1.0f);
-    releaseIncrement_ = std::clamp(releaseIncrement_, 0.0f, 1.0f);
+    if (bank->hasStreamedZones()) {
+        throw std::runtime_error("Streamede samples kan ikke skiftes ind mens der spilles");
+    }
+    const std::lock_guard<std::mutex> lock(publishMutex_);
+    const uint64_t epoch = publishedBanks_.back()->epoch + 1;
+    publishedBanks_.push_back(std::make_unique<PublishedBank>(PublishedBank{std::move(bank), epoch}));
+    currentBank_.store(publishedBanks_.back().get(), std::memory_order_release);
+    reclaimBanksLocked();
+}
+
+void VoiceManager::publishSample(
+    std::vector<float> samples, int sampleRate, int channels, int rootNote, size_t loopStart, size_t loopEnd) {
+    struct OwnedSample {
+        std::vector<float> samples;
+        SampleBank bank;
+    };
+    channels = std::max(1, channels);
+    auto owned = std::make_shared<OwnedSample>();
+    owned->samples = std::move(samples);
+    owned->bank = SampleBank::fromSample(owned->samples.data(),
+                                         owned->samples.size() / static_cast<size_t>(channels),
+                                         channels,
+                                         sampleRate,
+                                         rootNote,
+                                         loopStart,
+                                         loopEnd);
+    publishBank(std::shared_ptr<const SampleBank>(owned, &owned->bank));
 }
 
-void VoiceManager::noteOn(int midiNote) {
-    std::lock_guard<std::mutex> lock(mutex_);
+size_t VoiceManager::reclaimBanks() {
+    const std::lock_guard<std::mutex> lock(publishMutex_);
+    return reclaimBanksLocked();
+}
 
-    int index = findFreeVoice();
-    if (index < 0) {
-        index = stealVoice();
+// Epochs only grow, both in publishedBanks_ and in what the audio thread
+// reports, so the banks to release are always a prefix. The current bank is
+// never released: the audio thread may have loaded it without reporting yet.
+size_t VoiceManager::reclaimBanksLocked() {
+    const uint64_t oldest = oldestEpochInUse_.load(std::memory_order_acquire);
+    const auto keep = std::find_if(publishedBanks_.begin(), publishedBanks_.end() - 1, [&](const auto& published) {
+        return published->epoch >= oldest;
+    });
+    publishedBanks_.erase(publishedBanks_.begin(), keep);
+    return publishedBanks_.size() - 1;
+}
+
+void VoiceManager::noteOn(int midiNote, int velocity, uint64_t frame) {
+    postCommand(CommandType::NoteOn, midiNote, velocity, frame);
+}
+
+void VoiceManager::noteOff(int midiNote, uint64_t frame) {
+    postCommand(CommandType::NoteOff, midiNote, 0, frame);
+}
+
+void VoiceManager::stopAll(uint64_t frame) {
+    postCommand(CommandType::StopAll, 0, 0, frame);
+}
+
+void VoiceManager::postCommand(CommandType type, int midiNote, int velocity, uint64_t frame) {
+    if (!commands_.push(Command{type, midiNote, velocity, frame})) {
+        droppedEvents_.fetch_add(1, std::memory_order_relaxed);
     }
+}
 
-    int existing = findVoiceFor(midiNote);
-    if (existing >= 0 && existing != index) {
-        beginRelease(voices_[existing]);
+// Moves queued commands into scheduled_, keeping it sorted by frame. Late
+// events are pulled forward to the current frame but still queue behind
+// anything already due there. The reserve makes the inserts allocation-free.
+void VoiceManager::drainCommands() {
+    Command command;
+    while (commands_.pop(command)) {
+        if (scheduled_.size() == scheduled_.capacity()) {
+            droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        command.frame = std::max(command.frame, clock_);
+        const auto position = std::upper_bound(
+            scheduled_.begin(), scheduled_.end(), command.frame, [](uint64_t frame, const Command& scheduled) {
+                return frame < scheduled.frame;
+            });
+        scheduled_.insert(position, command);
+    }
+}
+
+void VoiceManager::applyCommand(const Command& command) {
+    switch (command.type) {
+    case CommandType::NoteOn:
+        startNote(command.note, command.velocity);
+        break;
+    case CommandType::NoteOff:
+        releaseNote(command.note);
+        break;
+    case CommandType::StopAll:
+        silenceAll();
+        break;
+    }
+}
+
+void VoiceManager::startNote(int midiNote, int velocity) {
+    const SampleZone* zone = bank_->findZone(midiNote, velocity);
+    if (!zone || zone->frames == 0) {
+        return;
+    }
+
+    const int index = acquireVoice();
+    if (heldVoiceForNote_[midiNote] >= 0) {
+        beginRelease(heldVoiceForNote_[midiNote]);
     }
 
     Voice& voice = voices_[index];
+    if (voice.pitchEntry >= 0) {
+        pitchCache_->release(voice.pitchEntry); // stolen
+    }
     voice.stage = Stage::Attack;
     voice.note = midiNote;
+    voice.zone = zone;
     voice.position = 0.0;
-    voice.step = computeStepFor(midiNote);
+    voice.step = computeStepFor(midiNote, *zone);
+    voice.fixedPosition = 0;
+    voice.fixedStep = std::max<uint64_t>(1, mix::FixedPhase::fromFrames(voice.step));
+    voice.fixedPhase = phaseFormat_.load(std::memory_order_relaxed) == mix::PhaseFormat::Fixed;
     voice.gain = 0.0f;
+    voice.bankEpoch = bankEpoch_;
+    voice.pitchEntry = -1;
+    if (pitchCache_) {
+        const SampleZone* prepitched =
+            pitchCache_->acquire(*zone, bankEpoch_, midiNote, voice.step, voice.pitchEntry);
+        if (prepitched) {
+            voice.zone = prepitched;
+            voice.step = 1.0;
+        }
+    }
+    pushBack(heldVoices_, index);
+    heldVoiceForNote_[midiNote] = index;
+
+    if (zone->stream && !zone->looped()) {
+        streamer_->start(index, *zone, zone->headFrames - SampleStreamer::kHistoryFrames, voice.step);
+    } else if (streamer_) {
+        streamer_->stop(index);
+    }
 }
 
-void VoiceManager::noteOff(int midiNote) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& voice : voices_) {
-        if (voice.stage != Stage::Idle && voice.note == midiNote) {
-            beginRelease(voice);
-        }
+void VoiceManager::releaseNote(int midiNote) {
+    if (midiNote >= 0 && midiNote < kMidiNotes && heldVoiceForNote_[midiNote] >= 0) {
+        beginRelease(heldVoiceForNote_[midiNote]);
     }
 }
 
-void VoiceManager::stopAll() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto& voice : voices_) {
-        voice.stage = Stage::Idle;
-        voice.position = 0.0;
-        voice.gain = 0.0f;
-        voice.note = 0;
+void VoiceManager::silenceAll() {
+    for (int index : activeVoices_) {
+        Voice& voice = voices_[index];
+        if (voice.zone->stream) {
+            streamer_->stop(index);
+        }
+        if (voice.pitchEntry >= 0) {
+            pitchCache_->release(voice.pitchEntry);
+        }
+        voice = Voice{};
+    }
+    activeVoices_.clear();
+    freeVoices_.clear();
+    for (int i = static_cast<int>(voices_.size()) - 1; i >= 0; --i) {
+        freeVoices_.push_back(i);
     }
+    heldVoiceForNote_.fill(-1);
+    heldVoices_ = VoiceList{};
+    releasingVoices_ = VoiceList{};
 }
 
 void VoiceManager::mix(float* output, int frameCount) {
-    std::fill(output, output + frameCount * outputChannels_, 0.0f);
+    const ScopedFlushDenormals flushDenormals;
+    adoptPublishedBank();
+    if (pitchCache_) {
+        pitchCache_->update();
+    }
+    drainCommands();
 
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (int frame = 0; frame < frameCount; ++frame) {
-        float left = 0.0f;
-        float right = 0.0f;
+    size_t applied = 0;
+    int offset = 0;
+    while (offset < frameCount) {
+        while (applied < scheduled_.size() && scheduled_[applied].frame <= clock_) {
+            applyCommand(scheduled_[applied++]);
+        }
+        int frames = std::min(kBlockSize, frameCount - offset);
+        if (applied < scheduled_.size()) {
+            frames = static_cast<int>(std::min<uint64_t>(frames, scheduled_[applied].frame - clock_));
+        }
+        renderBlock(output + static_cast<size_t>(offset) * static_cast<size_t>(outputChannels_), frames);
+        offset += frames;
+        clock_ += static_cast<uint64_t>(frames);
+    }
+    scheduled_.erase(scheduled_.begin(), scheduled_.begin() + static_cast<std::ptrdiff_t>(applied));
+    publishOldestEpoch();
+    renderedFrames_.store(clock_, std::memory_order_release);
+}
 
-        for (auto& voice : voices_) {
-            if (voice.stage == Stage::Idle) {
-                continue;
-            }
+// Reclamation never frees the bank the audio thread last reported or
+// anything newer, so the record loaded here stays valid until the next
+// publishOldestEpoch().
+void VoiceManager::adoptPublishedBank() {
+    const PublishedBank* published = currentBank_.load(std::memory_order_acquire);
+    bank_ = published->bank.get();
+    bankEpoch_ = published->epoch;
+}
 
-            size_t index0 = static_cast<size_t>(voice.position);
-            if (index0 >= static_cast<size_t>(sampleFrames_)) {
-                index0 = static_cast<size_t>(sampleFrames_ - 1);
-                voice.position = static_cast<double>(sampleFrames_ - 1);
-                beginRelease(voice);
-            }
+// Releases every bank older than the current one and all sounding voices'.
+void VoiceManager::publishOldestEpoch() {
+    uint64_t oldest = bankEpoch_;
+    for (int index : activeVoices_) {
+        oldest = std::min(oldest, voices_[index].bankEpoch);
+    }
+    if (pitchCache_) {
+        oldest = pitchCache_->oldestPendingEpoch(oldest);
+    }
+    oldestEpochInUse_.store(oldest, std::memory_order_release);
+}
 
-            size_t index1 = std::min(index0 + 1, static_cast<size_t>(sampleFrames_ - 1));
-            const float frac = static_cast<float>(voice.position - static_cast<double>(index0));
+void VoiceManager::renderBlock(float* output, int frames) {
+    const mix::Interpolation mode = interpolation_.load(std::memory_order_relaxed);
+    virtualizeVoices();
+    if (renderPool_ && activeVoices_.size() >= kMinParallelVoices) {
+        renderParallel(mode, frames);
+    } else {
+        std::fill_n(busLeft_.data(), frames, 0.0f);
+        std::fill_n(busRight_.data(), frames, 0.0f);
+        std::fill_n(busMono_.data(), frames, 0.0f);
+        renderRange(mode, 0, activeVoices_.size(), frames, MixBus{busLeft_.data(), busRight_.data(), busMono_.data()});
+    }
+    settleVoices();
+    if (reverb_) {
+        reverb_->process(busLeft_.data(), busRight_.data(), busMono_.data(), frames);
+    }
 
-            const int sampleIndex0 = static_cast<int>(index0) * channels_;
-            const int sampleIndex1 = static_cast<int>(index1) * channels_;
+    if (outputChannels_ == 1) {
+        mix::writeOutput<mix::OutputLayout::Mono>(
+            busLeft_.data(), busRight_.data(), busMono_.data(), output, frames, outputChannels_);
+    } else if (outputChannels_ == 2) {
+        mix::writeOutput<mix::OutputLayout::Stereo>(
+            busLeft_.data(), busRight_.data(), busMono_.data(), output, frames, outputChannels_);
+    } else {
+        mix::writeOutput<mix::OutputLayout::Surround>(
+            busLeft_.data(), busRight_.data(), busMono_.data(), output, frames, outputChannels_);
+    }
+}
 
-            float sampleL0 = sampleData_[sampleIndex0];
-            float sampleL1 = sampleData_[sampleIndex1];
-            float sampleR0 = channels_ > 1 ? sampleData_[sampleIndex0 + 1] : sampleL0;
-            float sampleR1 = channels_ > 1 ? sampleData_[sampleIndex1 + 1] : sampleL1;
+// Picks the voices that skip interpolation in the coming block. Outside the
+// attack a voice's gain only falls, so its present gain bounds the block.
+// Culling below maskRatio times the mean gain keeps the culled voices'
+// summed gain below maskRatio times the total.
+void VoiceManager::virtualizeVoices() {
+    const float maskRatio = maskRatio_.load(std::memory_order_relaxed);
+    const float floorGain = floorGain_.load(std::memory_order_relaxed);
+    float total = 0.0f;
+    for (int index : activeVoices_) {
+        const Voice& voice = voices_[index];
+        total += voice.stage == Stage::Attack ? 1.0f : voice.gain;
+    }
+    const float mean = activeVoices_.empty() ? 0.0f : total / static_cast<float>(activeVoices_.size());
+    const float threshold = std::max(floorGain, maskRatio * mean);
+    virtualVoices_ = 0;
+    for (int index : activeVoices_) {
+        Voice& voice = voices_[index];
+        voice.virtualized = voice.stage != Stage::Attack && voice.gain < threshold;
+        virtualVoices_ += voice.virtualized ? 1 : 0;
+    }
+}
 
-            const float leftSample = sampleL0 + (sampleL1 - sampleL0) * frac;
-            const float rightSample = sampleR0 + (sampleR1 - sampleR0) * frac;
+// Splits the active list into a fixed number of chunks, renders each into
+// its own partial bus on whichever pool thread claims it, then sums the
+// partial buses in chunk order.
+void VoiceManager::renderParallel(mix::Interpolation mode, int frames) {
+    renderJob_.mode = mode;
+    renderJob_.frames = frames;
+    renderJob_.chunks = static_cast<int>(std::min(activeVoices_.size(), kMaxRenderChunks));
+    renderPool_->run(renderJob_.chunks, &VoiceManager::renderChunk, this);
 
-            left += leftSample * voice.gain;
-            right += rightSample * voice.gain;
+    const float* partial = partialBuses_.data();
+    std::copy_n(partial, frames, busLeft_.data());
+    std::copy_n(partial + kBlockSize, frames, busRight_.data());
+    std::copy_n(partial + 2 * kBlockSize, frames, busMono_.data());
+    for (int chunk = 1; chunk < renderJob_.chunks; ++chunk) {
+        partial += 3 * kBlockSize;
+        mix::accumulate(busLeft_.data(), partial, frames);
+        mix::accumulate(busRight_.data(), partial + kBlockSize, frames);
+        mix::accumulate(busMono_.data(), partial + 2 * kBlockSize, frames);
+    }
+}
 
-            voice.position += voice.step;
-            advanceEnvelope(voice);
-        }
+void VoiceManager::renderChunk(void* context, int chunk) {
+    auto* self = static_cast<VoiceManager*>(context);
+    const RenderJob& job = self->renderJob_;
+    const size_t active = self->activeVoices_.size();
+    const size_t chunks = static_cast<size_t>(job.chunks);
+    const size_t begin = active * static_cast<size_t>(chunk) / chunks;
+    const size_t end = active * static_cast<size_t>(chunk + 1) / chunks;
 
-        left = std::clamp(left, -1.0f, 1.0f);
-        right = std::clamp(right, -1.0f, 1.0f);
+    float* partial = self->partialBuses_.data() + static_cast<size_t>(chunk) * 3 * kBlockSize;
+    const MixBus bus{partial, partial + kBlockSize, partial + 2 * kBlockSize};
+    std::fill_n(partial, 3 * kBlockSize, 0.0f);
+    self->renderRange(job.mode, begin, end, job.frames, bus);
+}
 
-        if (outputChannels_ == 1) {
-            output[frame] = left;
+void VoiceManager::renderRange(mix::Interpolation mode, size_t begin, size_t end, int frames, const MixBus& bus) {
+    switch (mode) {
+    case mix::Interpolation::Hermite:
+        renderVoices<mix::Interpolation::Hermite>(begin, end, frames, bus);
+        break;
+    case mix::Interpolation::Sinc:
+        renderVoices<mix::Interpolation::Sinc>(begin, end, frames, bus);
+        break;
+    default:
+        renderVoices<mix::Interpolation::Linear>(begin, end, frames, bus);
+        break;
+    }
+}
+
+// Renders activeVoices_[begin, end). Only touches the voices themselves and
+// their stream slots, so disjoint ranges can render concurrently; list
+// updates wait for settleVoices().
+template <mix::Interpolation Mode>
+void VoiceManager::renderVoices(size_t begin, size_t end, int frames, const MixBus& bus) {
+    const bool wantRight = outputChannels_ > 1;
+    for (size_t n = end; n-- > begin;) {
+        const int i = activeVoices_[n];
+        Voice& voice = voices_[i];
+        const bool stereoInput = voice.zone->channels > 1;
+        if (stereoInput && wantRight) {
+            renderVoiceAs<Mode, 2, true>(voice, i, frames, bus);
+        } else if (stereoInput) {
+            renderVoiceAs<Mode, 2, false>(voice, i, frames, bus);
+        } else if (wantRight) {
+            renderVoiceAs<Mode, 1, true>(voice, i, frames, bus);
         } else {
-            output[frame * outputChannels_] = left;
-            output[frame * outputChannels_ + 1] = right;
-            for (int channel = 2; channel < outputChannels_; ++channel) {
-                output[frame * outputChannels_ + channel] = (left + right) * 0.5f;
-            }
+            renderVoiceAs<Mode, 1, false>(voice, i, frames, bus);
         }
     }
 }
 
-double VoiceManager::computeStepFor(int midiNote) const {
-    const double semitoneOffset = static_cast<double>(midiNote - baseNote_);
-    return std::pow(2.0, semitoneOffset / 12.0);
+template <mix::Interpolation Mode, int InputChannels, bool WantRight>
+void VoiceManager::renderVoiceAs(Voice& voice, int slot, int frames, const MixBus& bus) {
+    if (voice.pitchEntry >= 0) {
+        renderPrepitched<InputChannels, WantRight>(voice, frames, bus);
+    } else if (voice.zone->format == SampleFormat::Int16Planar) {
+        renderVoiceWith<Mode, InputChannels, WantRight, SampleFormat::Int16Planar>(voice, slot, frames, bus);
+    } else {
+        renderVoiceWith<Mode, InputChannels, WantRight, SampleFormat::Float32>(voice, slot, frames, bus);
+    }
+}
+
+template <mix::Interpolation Mode, int InputChannels, bool WantRight, SampleFormat Format>
+void VoiceManager::renderVoiceWith(Voice& voice, int slot, int frames, const MixBus& bus) {
+    if (voice.fixedPhase) {
+        renderVoice<Mode, InputChannels, WantRight, Format, mix::FixedPhase>(voice, slot, frames, bus);
+    } else {
+        renderVoice<Mode, InputChannels, WantRight, Format, mix::DoublePhase>(voice, slot, frames, bus);
+    }
 }
 
-int VoiceManager::findVoiceFor(int midiNote) {
-    for (int i = 0; i < kMaxVoices; ++i) {
-        if (voices_[i].stage != Stage::Idle && voices_[i].note == midiNote) {
-            return i;
+// Compact zones are always fully resident, so only float zones take the
+// stream paths.
+template <mix::Interpolation Mode, int InputChannels, bool WantRight, SampleFormat Format, typename Phase>
+void VoiceManager::renderVoice(Voice& voice, int slot, int frames, const MixBus& bus) {
+    constexpr size_t kBefore = mix::Reach<Mode>::kBefore;
+    constexpr size_t kAfter = mix::Reach<Mode>::kAfter;
+    static_assert(kBefore <= SampleStreamer::kGuardFrames && kAfter <= SampleStreamer::kGuardFrames,
+                  "stream rings must cover the interpolation taps");
+
+    const SampleZone& zone = *voice.zone;
+    const size_t lastIndex = zone.frames - 1;
+    // Frames in memory; fewer than zone.frames for streamed zones and zones
+    // still being decoded.
+    const size_t resident = zone.residentFrames();
+    // Looped voices never get past the loop end; from loopTail on, the later
+    // taps wrap to the loop start.
+    const bool looped = zone.looped();
+    const size_t loopTail = zone.loopEnd - std::min(zone.loopEnd, kAfter);
+    float* left = InputChannels > 1 ? bus.left : bus.mono;
+    float* right = bus.right;
+    constexpr bool kCompact = Format == SampleFormat::Int16Planar;
+    const float gainScale = kCompact ? mix::kInt16Scale : 1.0f;
+    const mix::Int16Planes planes{zone.pcm, zone.pcm + (InputChannels > 1 ? zone.planeStride : 0)};
+    constexpr bool kFixed = std::is_same_v<Phase, mix::FixedPhase>;
+    Phase phase;
+    if constexpr (kFixed) {
+        phase = {voice.fixedPosition, voice.fixedStep};
+    } else {
+        phase = {voice.position, voice.step};
+    }
+
+    int done = 0;
+    while (done < frames && voice.stage != Stage::Idle) {
+        const int envelopeFrames = framesUntilStageEnd(voice);
+        const mix::GainRamp ramp = rampFor(voice);
+        const mix::GainRamp scaledRamp = ramp.scaled(gainScale);
+        int count = std::min(frames - done, envelopeFrames);
+
+        if (looped && reached(phase, zone.loopEnd)) {
+            wrapInto(phase, zone.loopStart, zone.loopEnd);
+        }
+        if (voice.virtualized) {
+            // Keep time with the rendered path without reading the sample.
+            if (looped) {
+                count = std::min(count, stepsUntil(phase, zone.loopEnd));
+            } else if (voice.stage != Stage::Release) {
+                if (reached(phase, zone.frames)) {
+                    voice.stage = Stage::Release;
+                    voice.releaseQueued = true;
+                    continue;
+                }
+                count = std::min(count, stepsUntil(phase, zone.frames));
+            }
+        } else if (looped && reached(phase, loopTail) && resident >= zone.loopEnd) {
+            count = std::min(count, stepsUntil(phase, zone.loopEnd));
+            if constexpr (kCompact) {
+                mix::renderLooped<Mode, InputChannels, WantRight>(planes,
+                                                                  static_cast<ptrdiff_t>(zone.loopStart),
+                                                                  static_cast<ptrdiff_t>(zone.loopEnd),
+                                                                  phase,
+                                                                  scaledRamp,
+                                                                  count,
+                                                                  left + done,
+                                                                  right + done);
+            } else {
+                mix::renderLooped<Mode, InputChannels, WantRight>(zone.data,
+                                                                  zone.channels,
+                                                                  static_cast<ptrdiff_t>(zone.loopStart),
+                                                                  static_cast<ptrdiff_t>(zone.loopEnd),
+                                                                  phase,
+                                                                  ramp,
+                                                                  count,
+                                                                  left + done,
+                                                                  right + done);
+            }
+        } else if (!reached(phase, lastIndex)) {
+            // Readable frames [low, high] at data + (f - origin) * channels:
+            // the resident frames, or once the taps run past those, the
+            // voice's stream window.
+            const size_t index = frameIndex(phase);
+            const float* data = zone.data;
+            size_t origin = 0;
+            size_t low = 0;
+            size_t high = resident - 1;
+            bool available = true;
+            if (zone.stream && index + kAfter > high) {
+                SampleStreamer::Window window;
+                available = streamer_->window(slot, index, window);
+                data = window.data;
+                origin = window.first;
+                low = window.begin;
+                high = window.end - 1;
+            }
+            // Taps may only run off the real ends of the sample, never off the
+            // edges of what has been streamed so far.
+            const bool clampLow = index < low + kBefore;
+            const bool clampHigh = index + kAfter > high;
+            available = available && (!clampLow || low == 0) && (!clampHigh || high == lastIndex);
+
+            if (!available) {
+                if (zone.stream) {
+                    // The disk reader is behind: hold the playhead silently for
+                    // the rest of this segment instead of waiting on it.
+                    streamer_->countUnderrun();
+                } else if constexpr (!kCompact) {
+                    // The decoder is behind (see ProgressiveSample): wait on the
+                    // newest frame the voice may read, so it resumes from there
+                    // without a jump.
+                    decodeWaits_.fetch_add(1, std::memory_order_relaxed);
+                    const float* frame = data + std::min(index, high) * static_cast<size_t>(zone.channels);
+                    mix::renderHeld<InputChannels, WantRight>(frame[0],
+                                                              InputChannels > 1 ? frame[1] : frame[0],
+                                                              ramp,
+                                                              count,
+                                                              left + done,
+                                                              right + done);
+                }
+                voice.gain = ramp.at(count);
+                done += count;
+                if (count == envelopeFrames) {
+                    finishStage(voice);
+                }
+                continue;
+            }
+
+            const Phase relative = relativeTo(phase, origin);
+            if (looped) {
+                count = stepsBefore(phase, loopTail, count);
+            }
+            if (clampLow || clampHigh) {
+                count = std::min(count, stepsUntil(phase, clampLow ? std::min(kBefore, lastIndex) : lastIndex));
+                if constexpr (kCompact) {
+                    mix::renderClamped<Mode, InputChannels, WantRight>(planes,
+                                                                       0,
+                                                                       static_cast<ptrdiff_t>(lastIndex),
+                                                                       phase,
+                                                                       scaledRamp,
+                                                                       count,
+                                                                       left + done,
+                                                                       right + done);
+                } else {
+                    mix::renderClamped<Mode, InputChannels, WantRight>(data,
+                                                                       zone.channels,
+                                                                       static_cast<ptrdiff_t>(low) - static_cast<ptrdiff_t>(origin),
+                                                                       static_cast<ptrdiff_t>(high) - static_cast<ptrdiff_t>(origin),
+                                                                       relative,
+                                                                       ramp,
+                                                                       count,
+                                                                       left + done,
+                                                                       right + done);
+                }
+            } else {
+                count = stepsBefore(phase, high - kAfter + 1, count);
+                if constexpr (kCompact) {
+                    mix::renderInterpolated<Mode, InputChannels, WantRight>(planes,
+                                                                            phase,
+                                                                            scaledRamp,
+                                                                            count,
+                                                                            left + done,
+                                                                            right + done);
+                } else {
+                    mix::renderInterpolated<Mode, InputChannels, WantRight>(data,
+                                                                            zone.channels,
+                                                                            relative,
+                                                                            ramp,
+                                                                            count,
+                                                                            left + done,
+                                                                            right + done);
+                }
+            }
+        } else {
+            if (voice.stage != Stage::Release) {
+                if (reached(phase, zone.frames)) {
+                    voice.stage = Stage::Release;
+                    voice.releaseQueued = true;
+                    continue;
+                }
+                count = std::min(count, stepsUntil(phase, zone.frames));
+            }
+            if constexpr (kCompact) {
+                mix::renderHeld<InputChannels, WantRight>(planes.left[lastIndex],
+                                                          planes.right[lastIndex],
+                                                          scaledRamp,
+                                                          count,
+                                                          left + done,
+                                                          right + done);
+            } else {
+                const float* frame =
+                    zone.stream ? zone.stream->lastFrame()
+                                : zone.data + std::min(lastIndex, resident - 1) * static_cast<size_t>(zone.channels);
+                mix::renderHeld<InputChannels, WantRight>(frame[0],
+                                                          InputChannels > 1 ? frame[1] : frame[0],
+                                                          ramp,
+                                                          count,
+                                                          left + done,
+                                                          right + done);
+            }
+        }
+
+        advance(phase, count);
+        voice.gain = ramp.at(count);
+        done += count;
+        if (count == envelopeFrames) {
+            finishStage(voice);
         }
     }
-    return -1;
+
+    if constexpr (kFixed) {
+        voice.fixedPosition = voice.stage == Stage::Idle ? 0 : phase.position;
+    } else {
+        voice.position = voice.stage == Stage::Idle ? 0.0 : phase.position;
+    }
+    if (zone.stream && !looped && voice.stage != Stage::Idle) {
+        streamer_->setReadPosition(slot, frameIndex(phase));
+    }
 }
 
-int VoiceManager::findFreeVoice() {
-    for (int i = 0; i < kMaxVoices; ++i) {
-        if (voices_[i].stage == Stage::Idle) {
-            return i;
+// renderVoice() for a pre-pitched copy: it plays at unit step and is never
+// looped or streamed, so the playhead is a whole frame index.
+template <int InputChannels, bool WantRight>
+void VoiceManager::renderPrepitched(Voice& voice, int frames, const MixBus& bus) {
+    const SampleZone& zone = *voice.zone;
+    const float* last = zone.data + (zone.frames - 1) * static_cast<size_t>(zone.channels);
+    float* left = InputChannels > 1 ? bus.left : bus.mono;
+    float* right = bus.right;
+    size_t index = static_cast<size_t>(voice.position);
+
+    int done = 0;
+    while (done < frames && voice.stage != Stage::Idle) {
+        const int envelopeFrames = framesUntilStageEnd(voice);
+        const mix::GainRamp ramp = rampFor(voice);
+        int count = std::min(frames - done, envelopeFrames);
+
+        if (index < zone.frames) {
+            count = static_cast<int>(std::min<size_t>(static_cast<size_t>(count), zone.frames - index));
+            if (!voice.virtualized) {
+                mix::renderUnitStep<InputChannels, WantRight>(zone.data + index * static_cast<size_t>(zone.channels),
+                                                              zone.channels,
+                                                              ramp,
+                                                              count,
+                                                              left + done,
+                                                              right + done);
+            }
+            index += static_cast<size_t>(count);
+        } else if (voice.stage != Stage::Release) {
+            voice.stage = Stage::Release;
+            voice.releaseQueued = true;
+            continue;
+        } else if (!voice.virtualized) {
+            mix::renderHeld<InputChannels, WantRight>(
+                last[0], InputChannels > 1 ? last[1] : last[0], ramp, count, left + done, right + done);
+        }
+
+        voice.gain = ramp.at(count);
+        done += count;
+        if (count == envelopeFrames) {
+            finishStage(voice);
         }
     }
-    return -1;
+    voice.position = voice.stage == Stage::Idle ? 0.0 : static_cast<double>(index);
 }
 
-int VoiceManager::stealVoice() {
-    int target = 0;
-    float minGain = std::numeric_limits<float>::max();
-    for (int i = 0; i < kMaxVoices; ++i) {
-        if (voices_[i].gain < minGain) {
-            minGain = voices_[i].gain;
-            target = i;
+int VoiceManager::activeVoiceCount() const {
+    return static_cast<int>(activeVoices_.size());
+}
+
+double VoiceManager::computeStepFor(int midiNote, const SampleZone& zone) const {
+    const double semitoneOffset = static_cast<double>(midiNote - zone.rootNote);
+    const double rateRatio = static_cast<double>(zone.sampleRate) / static_cast<double>(sampleRate_);
+    return std::pow(2.0, semitoneOffset / 12.0) * rateRatio;
+}
+
+// Takes a voice off the free stack, or steals one: the longest-releasing
+// voice first (releases share one rate, so it is normally the quietest), else
+// the oldest held voice.
+int VoiceManager::acquireVoice() {
+    if (!freeVoices_.empty()) {
+        const int index = freeVoices_.back();
+        freeVoices_.pop_back();
+        voices_[index].activeSlot = static_cast<int>(activeVoices_.size());
+        activeVoices_.push_back(index);
+        return index;
+    }
+    const int index = releasingVoices_.head >= 0 ? releasingVoices_.head : heldVoices_.head;
+    detachVoice(index);
+    voiceSteals_.store(voiceSteals_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return index;
+}
+
+// Removes an active voice from the held/releasing lists and the note index.
+void VoiceManager::detachVoice(int index) {
+    Voice& voice = voices_[index];
+    if (voice.stage == Stage::Release) {
+        unlink(releasingVoices_, index);
+    } else {
+        unlink(heldVoices_, index);
+        heldVoiceForNote_[voice.note] = -1;
+    }
+}
+
+// Applies the list changes for voices that ran out of sample or finished
+// their release during the last block. Walks backwards so retiring (which
+// swaps in the last active voice) never skips an entry.
+void VoiceManager::settleVoices() {
+    for (size_t n = activeVoices_.size(); n-- > 0;) {
+        const int index = activeVoices_[n];
+        Voice& voice = voices_[index];
+        if (voice.releaseQueued) {
+            voice.releaseQueued = false;
+            unlink(heldVoices_, index);
+            heldVoiceForNote_[voice.note] = -1;
+            if (voice.stage == Stage::Release) {
+                pushBack(releasingVoices_, index);
+            }
+        } else if (voice.stage == Stage::Idle) {
+            unlink(releasingVoices_, index);
+        }
+        if (voice.stage == Stage::Idle) {
+            retireVoice(index);
         }
     }
-    return target;
 }
 
-void VoiceManager::beginRelease(Voice& voice) {
-    if (voice.stage != Stage::Idle) {
+void VoiceManager::retireVoice(int index) {
+    Voice& voice = voices_[index];
+    if (voice.zone->stream) {
+        streamer_->stop(index);
+    }
+    if (voice.pitchEntry >= 0) {
+        pitchCache_->release(voice.pitchEntry);
+        voice.pitchEntry = -1;
+    }
+
+    const int last = activeVoices_.back();
+    activeVoices_[static_cast<size_t>(voice.activeSlot)] = last;
+    voices_[last].activeSlot = voice.activeSlot;
+    activeVoices_.pop_back();
+    voice.activeSlot = -1;
+    freeVoices_.push_back(index);
+}
+
+void VoiceManager::beginRelease(int index) {
+    Voice& voice = voices_[index];
+    if (voice.stage == Stage::Attack || voice.stage == Stage::Decay || voice.stage == Stage::Sustain) {
+        detachVoice(index);
         voice.stage = Stage::Release;
+        pushBack(releasingVoices_, index);
     }
 }
 
-void VoiceManager::advanceEnvelope(Voice& voice) {
+void VoiceManager::pushBack(VoiceList& list, int index) {
+    Voice& voice = voices_[index];
+    voice.previous = list.tail;
+    voice.next = -1;
+    if (list.tail >= 0) {
+        voices_[list.tail].next = index;
+    } else {
+        list.head = index;
+    }
+    list.tail = index;
+}
+
+void VoiceManager::unlink(VoiceList& list, int index) {
+    Voice& voice = voices_[index];
+    if (voice.previous >= 0) {
+        voices_[voice.previous].next = voice.next;
+    } else {
+        list.head = voice.next;
+    }
+    if (voice.next >= 0) {
+        voices_[voice.next].previous = voice.previous;
+    } else {
+        list.tail = voice.previous;
+    }
+    voice.previous = -1;
+    voice.next = -1;
+}
+
+const VoiceManager::Segment* VoiceManager::segmentFor(Stage stage) const {
+    switch (stage) {
+    case Stage::Attack:
+        return &attack_;
+    case Stage::Decay:
+        return &decay_;
+    case Stage::Release:
+        return &release_;
+    case Stage::Sustain:
+    case Stage::Idle:
+        break;
+    }
+    return nullptr;
+}
+
+// Gain across the voice's current stage, starting from its present level;
+// sustain holds it.
+mix::GainRamp VoiceManager::rampFor(const Voice& voice) const {
+    const Segment* segment = segmentFor(voice.stage);
+    if (!segment) {
+        return {voice.gain};
+    }
+    if (segment->exponential) {
+        return {segment->target, 0.0f, voice.gain - segment->target, segment->ratio};
+    }
+    return {voice.gain, segment->slope};
+}
+
+int VoiceManager::framesUntilStageEnd(const Voice& voice) const {
+    const Segment* segment = segmentFor(voice.stage);
+    if (!segment) {
+        return std::numeric_limits<int>::max();
+    }
+    if (segment->exponential) {
+        // target + (gain - target) * ratio^n crosses end.
+        const double remaining = static_cast<double>(segment->end - segment->target) /
+                                 static_cast<double>(voice.gain - segment->target);
+        return remaining >= 1.0 ? 1 : wholeFrames(std::log(remaining) / segment->logRatio);
+    }
+    return wholeFrames((segment->end - voice.gain) / segment->slope);
+}
+
+void VoiceManager::finishStage(Voice& voice) {
     switch (voice.stage) {
     case Stage::Attack:
-        voice.gain += attackIncrement_;
-        if (voice.gain >= 1.0f) {
-            voice.gain = 1.0f;
-            voice.stage = Stage::Sustain;
-        }
+        voice.gain = 1.0f;
+        voice.stage = sustainLevel_ < 1.0f ? Stage::Decay : Stage::Sustain;
         break;
-    case Stage::Sustain:
-        if (voice.position >= static_cast<double>(sampleFrames_)) {
+    case Stage::Decay:
+        voice.gain = sustainLevel_;
+        voice.stage = Stage::Sustain;
+        if (sustainLevel_ <= kMinimumGain) {
+            // Nothing left to hold; let settleVoices() move it to the releasing list.
             voice.stage = Stage::Release;
+            voice.releaseQueued = true;
         }
         break;
     case Stage::Release:
-        voice.gain -= releaseIncrement_;
-        if (voice.gain <= kMinimumGain) {
-            voice.stage = Stage::Idle;
-            voice.gain = 0.0f;
-            voice.position = 0.0;
-        }
+        voice.stage = Stage::Idle;
+        voice.gain = 0.0f;
+        voice.position = 0.0;
         break;
+    case Stage::Sustain:
     case Stage::Idle:
         break;
     }
 }
-
@@ -0,0 +1,295 @@
+#include "WavFile.h"
+
+#include "MappedFile.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint16_t kFormatPcm = 1;
+constexpr uint16_t kFormatFloat = 3;
+constexpr uint16_t kFormatExtensible = 0xfffe;
+constexpr uint32_t kLoopForward = 0;
+constexpr size_t kSmplHeaderSize = 36;
+constexpr size_t kSmplLoopSize = 24;
+constexpr size_t kDecodeChunkBytes = size_t{1} << 20;
+
+uint16_t readU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void writeU16(std::ofstream& out, uint16_t value) {
+    const uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+    out.write(reinterpret_cast<const char*>(bytes), 2);
+}
+
+void writeU32(std::ofstream& out, uint32_t value) {
+    const uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                              static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+    out.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+float decodeSample(const uint8_t* p, uint16_t format, int bytesPerSample) {
+    if (format == kFormatFloat) {
+        if (bytesPerSample == 4) {
+            float value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        double value;
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<float>(value);
+    }
+
+    switch (bytesPerSample) {
+    case 1:
+        return (static_cast<float>(p[0]) - 128.0f) / 128.0f;
+    case 2:
+        return static_cast<float>(static_cast<int16_t>(readU16(p))) / 32768.0f;
+    case 3: {
+        const uint32_t packed = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+                                (static_cast<uint32_t>(p[2]) << 24);
+        const int32_t value = static_cast<int32_t>(packed) >> 8;
+        return static_cast<float>(value) / 8388608.0f;
+    }
+    default:
+        return static_cast<float>(static_cast<int32_t>(readU32(p))) / 2147483648.0f;
+    }
+}
+
+WavFormat parseWavFormat(const uint8_t* file, uint64_t fileSize, const std::string& path) {
+    if (fileSize < 12 || std::memcmp(file, "RIFF", 4) != 0 || std::memcmp(file + 8, "WAVE", 4) != 0) {
+        throw std::runtime_error("Ikke en RIFF/WAVE fil: " + path);
+    }
+
+    WavFormat format;
+    bool haveFormat = false;
+    bool haveData = false;
+    uint64_t offset = 12;
+    while (offset + 8 <= fileSize) {
+        const uint8_t* header = file + offset;
+        const uint64_t chunkSize = readU32(header + 4);
+        const uint64_t available = std::min(chunkSize, fileSize - offset - 8);
+        if (std::memcmp(header, "fmt ", 4) == 0 && available >= 16) {
+            const uint8_t* fmt = header + 8;
+            format.encoding = readU16(fmt);
+            format.channels = readU16(fmt + 2);
+            format.sampleRate = static_cast<int>(readU32(fmt + 4));
+            format.bytesPerSample = readU16(fmt + 14) / 8;
+            // WAVE_FORMAT_EXTENSIBLE: the real encoding is the first two bytes
+            // of the sub-format GUID. Valid bits below the container size are
+            // left-justified, so decoding the full container scales correctly.
+            if (format.encoding == kFormatExtensible) {
+                format.encoding = available >= 40 ? readU16(fmt + 24) : 0;
+            }
+            haveFormat = true;
+        } else if (std::memcmp(header, "data", 4) == 0) {
+            format.dataOffset = offset + 8;
+            format.dataBytes = available;
+            haveData = true;
+        } else if (std::memcmp(header, "smpl", 4) == 0 && available >= kSmplHeaderSize) {
+            // Sampler chunk: the first forward loop becomes the sustain loop;
+            // its end frame is inclusive.
+            const uint8_t* smpl = header + 8;
+            const uint64_t loops = std::min<uint64_t>(readU32(smpl + 28), (available - kSmplHeaderSize) / kSmplLoopSize);
+            for (uint64_t i = 0; i < loops; ++i) {
+                const uint8_t* loop = smpl + kSmplHeaderSize + i * kSmplLoopSize;
+                if (readU32(loop + 4) == kLoopForward) {
+                    format.loopStart = readU32(loop + 8);
+                    format.loopEnd = static_cast<uint64_t>(readU32(loop + 12)) + 1;
+                    break;
+                }
+            }
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (!haveFormat || !haveData || format.channels == 0 || format.sampleRate <= 0) {
+        throw std::runtime_error("WAV filen mangler fmt eller data: " + path);
+    }
+    const bool supported =
+        (format.encoding == kFormatPcm && format.bytesPerSample >= 1 && format.bytesPerSample <= 4) ||
+        (format.encoding == kFormatFloat && (format.bytesPerSample == 4 || format.bytesPerSample == 8));
+    if (!supported) {
+        throw std::runtime_error("WAV formatet understøttes ikke: " + path);
+    }
+    // A loop must lie inside the data; anything else is ignored.
+    if (format.loopEnd > format.frames() || format.loopStart >= format.loopEnd) {
+        format.loopStart = 0;
+        format.loopEnd = 0;
+    }
+    return format;
+}
+
+// Vector paths for the common layouts; each produces exactly what
+// decodeSample would.
+void decodeInt16(const uint8_t* source, size_t count, float* destination) {
+    const simd::Float4 scale = simd::broadcast(1.0f / 32768.0f);
+    size_t i = 0;
+    for (; i + simd::kLanes <= count; i += simd::kLanes) {
+        simd::store(destination + i, simd::mul(simd::convertInt16(source + 2 * i), scale));
+    }
+    for (; i < count; ++i) {
+        destination[i] = decodeSample(source + 2 * i, kFormatPcm, 2);
+    }
+}
+
+// 24-bit samples are widened to the top of an int32 (exact in float), then
+// scaled like 32-bit ones.
+void decodeInt24(const uint8_t* source, size_t count, float* destination) {
+    const simd::Float4 scale = simd::broadcast(1.0f / 2147483648.0f);
+    size_t i = 0;
+    for (; i + simd::kLanes <= count; i += simd::kLanes) {
+        alignas(16) int32_t widened[simd::kLanes];
+        for (int lane = 0; lane < simd::kLanes; ++lane) {
+            const uint8_t* p = source + 3 * (i + static_cast<size_t>(lane));
+            widened[lane] = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8) |
+                                                 (static_cast<uint32_t>(p[1]) << 16) |
+                                                 (static_cast<uint32_t>(p[2]) << 24));
+        }
+        simd::store(destination + i, simd::mul(simd::convertInt32(widened), scale));
+    }
+    for (; i < count; ++i) {
+        destination[i] = decodeSample(source + 3 * i, kFormatPcm, 3);
+    }
+}
+
+void decodeInt32(const uint8_t* source, size_t count, float* destination) {
+    const simd::Float4 scale = simd::broadcast(1.0f / 2147483648.0f);
+    size_t i = 0;
+    for (; i + simd::kLanes <= count; i += simd::kLanes) {
+        simd::store(destination + i, simd::mul(simd::convertInt32(source + 4 * i), scale));
+    }
+    for (; i < count; ++i) {
+        destination[i] = decodeSample(source + 4 * i, kFormatPcm, 4);
+    }
+}
+
+} // namespace
+
+WavFormat readWavFormat(const std::string& path) {
+    const MappedFile file(path);
+    return parseWavFormat(file.data(), file.size(), path);
+}
+
+void decodeWavSamples(const unsigned char* source, size_t sampleCount, const WavFormat& format, float* destination) {
+    if (format.encoding == kFormatFloat && format.bytesPerSample == 4) {
+        std::memcpy(destination, source, sampleCount * sizeof(float));
+        return;
+    }
+    if (format.encoding == kFormatPcm) {
+        switch (format.bytesPerSample) {
+        case 2:
+            decodeInt16(source, sampleCount, destination);
+            return;
+        case 3:
+            decodeInt24(source, sampleCount, destination);
+            return;
+        case 4:
+            decodeInt32(source, sampleCount, destination);
+            return;
+        default:
+            break;
+        }
+    }
+    for (size_t i = 0; i < sampleCount; ++i) {
+        destination[i] = decodeSample(source + i * static_cast<size_t>(format.bytesPerSample),
+                                      format.encoding,
+                                      format.bytesPerSample);
+    }
+}
+
+// Maps the file and decodes straight into the final buffer, so the only
+// full-size allocation is the float data. Source pages are read ahead and
+// dropped again chunk by chunk, which keeps them out of the peak RSS.
+WavData readWav(const std::string& path) {
+    const MappedFile file(path);
+    const WavFormat format = parseWavFormat(file.data(), file.size(), path);
+
+    WavData wav;
+    wav.sampleRate = format.sampleRate;
+    wav.channels = format.channels;
+    wav.loopStart = static_cast<size_t>(format.loopStart);
+    wav.loopEnd = static_cast<size_t>(format.loopEnd);
+    const size_t sampleCount = format.frames() * static_cast<size_t>(format.channels);
+    if (sampleCount == 0) {
+        throw std::runtime_error("WAV filen indeholder ingen samples");
+    }
+    wav.samples.resize(sampleCount);
+
+    const size_t bytesPerSample = static_cast<size_t>(format.bytesPerSample);
+    const size_t chunkSamples = std::max<size_t>(1, kDecodeChunkBytes / format.bytesPerFrame()) *
+                                static_cast<size_t>(format.channels);
+    const size_t dataOffset = static_cast<size_t>(format.dataOffset);
+    file.prefetch(dataOffset, chunkSamples * bytesPerSample);
+    size_t evicted = dataOffset;
+    for (size_t done = 0; done < sampleCount;) {
+        const size_t count = std::min(chunkSamples, sampleCount - done);
+        const size_t offset = dataOffset + done * bytesPerSample;
+        file.prefetch(offset + count * bytesPerSample, chunkSamples * bytesPerSample);
+        decodeWavSamples(file.data() + offset, count, format, wav.samples.data() + done);
+        // Evict up from a page-aligned watermark so pages straddling two
+        // chunks are dropped too.
+        const size_t decodedEnd = offset + count * bytesPerSample;
+        file.evict(evicted, decodedEnd - evicted);
+        evicted = decodedEnd - decodedEnd % MappedFile::pageSize();
+        done += count;
+    }
+    return wav;
+}
+
+size_t crossfadeLoop(WavData& wav, size_t crossfadeFrames) {
+    if (wav.loopEnd <= wav.loopStart || wav.loopEnd > wav.frames()) {
+        return 0;
+    }
+    const size_t length = std::min({crossfadeFrames, wav.loopStart, wav.loopEnd - wav.loopStart});
+    const size_t channels = static_cast<size_t>(wav.channels);
+    float* fadeOut = wav.samples.data() + (wav.loopEnd - length) * channels;
+    const float* fadeIn = wav.samples.data() + (wav.loopStart - length) * channels;
+    for (size_t i = 0; i < length; ++i) {
+        // Reaches the pre-loop frames fully on the last frame before the end.
+        const float in = static_cast<float>(i + 1) / static_cast<float>(length);
+        for (size_t c = 0; c < channels; ++c) {
+            float& value = fadeOut[i * channels + c];
+            value += (fadeIn[i * channels + c] - value) * in;
+        }
+    }
+    return length;
+}
+
+void writeWav(const std::string& path, const float* samples, size_t frames, int channels, int sampleRate) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Kunne ikke skrive WAV fil: " + path);
+    }
+
+    const uint32_t dataSize = static_cast<uint32_t>(frames * static_cast<size_t>(channels) * sizeof(float));
+    out.write("RIFF", 4);
+    writeU32(out, 36 + dataSize);
+    out.write("WAVE", 4);
+    out.write("fmt ", 4);
+    writeU32(out, 16);
+    writeU16(out, kFormatFloat);
+    writeU16(out, static_cast<uint16_t>(channels));
+    writeU32(out, static_cast<uint32_t>(sampleRate));
+    writeU32(out, static_cast<uint32_t>(sampleRate * channels * static_cast<int>(sizeof(float))));
+    writeU16(out, static_cast<uint16_t>(channels * static_cast<int>(sizeof(float))));
+    writeU16(out, 32);
+    out.write("data", 4);
+    writeU32(out, dataSize);
+    out.write(reinterpret_cast<const char*>(samples), dataSize);
+
+    if (!out) {
+        throw std::runtime_error("Fejl under skrivning af WAV fil: " + path);
+    }
+}
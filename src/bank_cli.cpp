@@ -0,0 +1,28 @@
+#include "SampleBank.h"
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Brug: " << argv[0] << " <manifest.txt> <output.wbk>\n"
+                  << "  manifest linjer: <wav> <lav tangent> <høj tangent> <lav velocity> <høj velocity> <grundtone>\n"
+                  << "                  [<loop start> <loop slut> [<krydsfade>]], loop som - - beholder WAV filens smpl loop\n";
+        return 1;
+    }
+
+    try {
+        const std::vector<BankZoneSpec> zones = readBankManifest(argv[1]);
+        writeSampleBank(argv[2], zones);
+
+        const SampleBank bank = SampleBank::open(argv[2]);
+        std::cout << "zones: " << bank.zones().size() << "\n"
+                  << "bytes: " << bank.mappedBytes() << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,16 +1,31 @@
+#include "AudioClock.h"
+#include "AudioStats.h"
+#include "MidiInput.h"
+#include "ProgressiveSample.h"
+#include "Resampler.h"
+#include "SampleBank.h"
+#include "SampleCache.h"
+#include "SampleStreamer.h"
 #include "VoiceManager.h"
+#include "WavFile.h"
 
 #include <SDL.h>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -18,6 +33,17 @@ namespace {
 constexpr int kFirstMidiNote = 21;  // A0
 constexpr int kLastMidiNote = 108;  // C8
 constexpr int kTotalKeys = kLastMidiNote - kFirstMidiNote + 1;
+constexpr int kPolyphony = 256;
+constexpr int kMaxRenderThreads = 4;
+// Asked of the device; whatever it grants, samples are converted to it once
+// at load so the mixer never resamples for rate alone.
+constexpr int kPreferredDeviceRate = 48000;
+
+// Samples that would decode to more than this are played from disk instead.
+constexpr uint64_t kStreamThresholdBytes = 64ull << 20;
+constexpr size_t kStreamHeadFrames = 1 << 16;
+
+constexpr Uint32 kStatsIntervalMs = 2000;
 
 struct PianoKey {
     SDL_Rect bounds{};
@@ -26,6 +52,11 @@ struct PianoKey {
     bool pressed = false;
 };
 
+bool hasExtension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
 bool isBlackKey(int midiNote) {
     const int mod = midiNote % 12;
     return mod == 1 || mod == 3 || mod == 6 || mod == 8 || mod == 10;
@@ -39,23 +70,57 @@ std::string midiNoteName(int midiNote) {
     return std::string(names[mod]) + std::to_string(octave);
 }
 
-std::optional<int> findKeyAtPosition(int x,
-                                     int y,
-                                     const std::array<PianoKey, kTotalKeys>& keys,
-                                     const std::vector<int>& blackIndices,
-                                     const std::vector<int>& whiteIndices) {
-    SDL_Point point{x, y};
-    for (int index : blackIndices) {
-        if (SDL_PointInRect(&point, &keys[index].bounds)) {
-            return index;
+// Key under each window column, so hit testing costs two lookups instead of
+// a scan over every key. Black keys win over the white key beneath them.
+class KeyLookup {
+public:
+    KeyLookup(const std::array<PianoKey, kTotalKeys>& keys, int width)
+        : keys_(&keys), white_(static_cast<size_t>(width), -1), black_(static_cast<size_t>(width), -1) {
+        for (int index = 0; index < kTotalKeys; ++index) {
+            const SDL_Rect& bounds = keys[index].bounds;
+            std::vector<int8_t>& column = keys[index].isBlack ? black_ : white_;
+            for (int x = std::max(bounds.x, 0); x < std::min(bounds.x + bounds.w, width); ++x) {
+                column[static_cast<size_t>(x)] = static_cast<int8_t>(index);
+            }
         }
     }
-    for (int index : whiteIndices) {
-        if (SDL_PointInRect(&point, &keys[index].bounds)) {
-            return index;
+
+    std::optional<int> keyAt(int x, int y) const {
+        if (x < 0 || x >= static_cast<int>(white_.size())) {
+            return std::nullopt;
         }
+        const SDL_Point point{x, y};
+        for (int8_t index : {black_[static_cast<size_t>(x)], white_[static_cast<size_t>(x)]}) {
+            if (index >= 0 && SDL_PointInRect(&point, &(*keys_)[index].bounds)) {
+                return index;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    const std::array<PianoKey, kTotalKeys>* keys_;
+    std::vector<int8_t> white_; // key index per column, -1 for none
+    std::vector<int8_t> black_;
+};
+
+void drawKey(SDL_Renderer* renderer, const PianoKey& key, int baseMidiNote) {
+    const bool isBase = key.midiNote == baseMidiNote;
+    if (key.isBlack) {
+        const SDL_Color fill = key.pressed ? SDL_Color{80, 80, 140, 255}
+                               : isBase    ? SDL_Color{40, 40, 120, 255}
+                                           : SDL_Color{25, 25, 25, 255};
+        SDL_SetRenderDrawColor(renderer, fill.r, fill.g, fill.b, fill.a);
+        SDL_RenderFillRect(renderer, &key.bounds);
+        return;
     }
-    return std::nullopt;
+    const SDL_Color fill = key.pressed ? SDL_Color{220, 220, 255, 255}
+                           : isBase    ? SDL_Color{220, 240, 255, 255}
+                                       : SDL_Color{245, 245, 245, 255};
+    SDL_SetRenderDrawColor(renderer, fill.r, fill.g, fill.b, fill.a);
+    SDL_RenderFillRect(renderer, &key.bounds);
+    SDL_SetRenderDrawColor(renderer, 40, 40, 40, 255);
+    SDL_RenderDrawRect(renderer, &key.bounds);
 }
 
 void renderKeyboard(SDL_Renderer* renderer,
@@ -64,32 +129,33 @@ void renderKeyboard(SDL_Renderer* renderer,
                     const std::vector<int>& blackIndices,
                     int baseMidiNote) {
     for (int index : whiteIndices) {
-        const auto& key = keys[index];
-        const bool isBase = key.midiNote == baseMidiNote;
-        const SDL_Color fill = key.pressed ? SDL_Color{220, 220, 255, 255}
-                                           : isBase        ? SDL_Color{220, 240, 255, 255}
-                                                           : SDL_Color{245, 245, 245, 255};
-        SDL_SetRenderDrawColor(renderer, fill.r, fill.g, fill.b, fill.a);
-        SDL_RenderFillRect(renderer, &key.bounds);
-        SDL_SetRenderDrawColor(renderer, 40, 40, 40, 255);
-        SDL_RenderDrawRect(renderer, &key.bounds);
+        drawKey(renderer, keys[index], baseMidiNote);
     }
-
     for (int index : blackIndices) {
-        const auto& key = keys[index];
-        const bool isBase = key.midiNote == baseMidiNote;
-        SDL_Color fill = key.pressed ? SDL_Color{80, 80, 140, 255}
-                                     : isBase        ? SDL_Color{40, 40, 120, 255}
-                                                    : SDL_Color{25, 25, 25, 255};
-        SDL_SetRenderDrawColor(renderer, fill.r, fill.g, fill.b, fill.a);
-        SDL_RenderFillRect(renderer, &key.bounds);
+        drawKey(renderer, keys[index], baseMidiNote);
+    }
+}
+
+// Redraws one key in place. A white key is painted over the edges of its
+// black neighbours (the adjacent notes), so those are drawn again on top,
+// leaving the same pixels as a full renderKeyboard.
+void redrawKey(SDL_Renderer* renderer, const std::array<PianoKey, kTotalKeys>& keys, int index, int baseMidiNote) {
+    drawKey(renderer, keys[index], baseMidiNote);
+    if (keys[index].isBlack) {
+        return;
+    }
+    for (int neighbour : {index - 1, index + 1}) {
+        if (neighbour >= 0 && neighbour < kTotalKeys && keys[neighbour].isBlack) {
+            drawKey(renderer, keys[neighbour], baseMidiNote);
+        }
     }
 }
 
-std::vector<float> loadSample(const std::string& path,
-                              int& sampleRate,
-                              int& channels,
-                              int desiredChannels) {
+// Fallback for WAV encodings readWav does not handle (ADPCM, mu-law, ...).
+std::vector<float> loadSampleWithSdl(const std::string& path,
+                                     int& sampleRate,
+                                     int& channels,
+                                     int desiredChannels) {
     SDL_AudioSpec wavSpec;
     Uint8* wavBuffer = nullptr;
     Uint32 wavLength = 0;
@@ -141,18 +207,194 @@ std::vector<float> loadSample(const std::string& path,
     return data;
 }
 
+// The native reader decodes straight from a memory mapping into the returned
+// buffer and keeps the file's channel count (voices play mono and stereo
+// samples directly) and loop; SDL is only used for formats it does not
+// understand.
+WavData loadSample(const std::string& path, int desiredChannels) {
+    try {
+        return readWav(path);
+    } catch (const std::exception&) {
+        WavData wav;
+        wav.samples = loadSampleWithSdl(path, wav.sampleRate, wav.channels, desiredChannels);
+        return wav;
+    }
+}
+
+// Large plain PCM/float files are streamed; anything our reader does not
+// understand falls through to the SDL loader.
+std::optional<WavFormat> streamableFormat(const std::string& path) {
+    WavFormat format;
+    try {
+        format = readWavFormat(path);
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+    const uint64_t decodedBytes = format.frames() * static_cast<uint64_t>(format.channels) * sizeof(float);
+    if (decodedBytes <= kStreamThresholdBytes) {
+        return std::nullopt;
+    }
+    return format;
+}
+
+// A bank together with everything its zones point into.
+struct LoadedInstrument {
+    SampleBank source;
+    std::vector<std::vector<float>> storage;
+    std::vector<std::vector<int16_t>> compactStorage;
+    CachedSample cached;
+    SampleBank bank;
+};
+
+SampleCacheSettings cacheSettings(int sampleRate, SampleFormat format) {
+    SampleCacheSettings settings;
+    settings.sampleRate = sampleRate;
+    settings.format = format;
+    return settings;
+}
+
+// Loads a .wbk bank, converted to `sampleRate`, or a WAV file through the
+// sample cache, decoded by `progressive` when it is already decoding the
+// file. The returned pointer owns the sample data, so it can be handed to
+// VoiceManager::publishBank. Files to be streamed are not handled here.
+std::shared_ptr<const SampleBank> loadInstrument(const std::string& path,
+                                                 int sampleRate,
+                                                 SampleFormat format,
+                                                 int baseNote,
+                                                 int desiredChannels,
+                                                 const ProgressiveSample* progressive = nullptr) {
+    auto instrument = std::make_shared<LoadedInstrument>();
+    if (hasExtension(path, ".wbk")) {
+        instrument->source = SampleBank::open(path);
+        if (instrument->source.empty()) {
+            throw std::runtime_error("Sample banken indeholder ingen zoner");
+        }
+        instrument->bank = resampleBank(instrument->source, sampleRate, instrument->storage);
+        if (format == SampleFormat::Int16Planar) {
+            instrument->bank = compactBank(instrument->bank, instrument->compactStorage);
+            instrument->storage.clear();
+        }
+        return std::shared_ptr<const SampleBank>(instrument, &instrument->bank);
+    }
+    // Decoded, converted samples are cached on disk; a warm start only maps
+    // the entry.
+    instrument->cached =
+        SampleCache().load(path, cacheSettings(sampleRate, format), baseNote, [&](const std::string& file) {
+            return progressive ? progressive->waitForData() : loadSample(file, desiredChannels);
+        });
+    return std::shared_ptr<const SampleBank>(instrument, &instrument->cached.bank);
+}
+
+// The cached WAV file as loadInstrument() would return it, if the cache
+// already holds it; nullptr otherwise, without decoding or hashing the file.
+std::shared_ptr<const SampleBank> findCachedInstrument(const std::string& path,
+                                                       int sampleRate,
+                                                       SampleFormat format,
+                                                       int baseNote) {
+    if (hasExtension(path, ".wbk")) {
+        return nullptr;
+    }
+    std::optional<CachedSample> cached = SampleCache().find(path, cacheSettings(sampleRate, format), baseNote);
+    if (!cached) {
+        return nullptr;
+    }
+    auto instrument = std::make_shared<LoadedInstrument>();
+    instrument->cached = std::move(*cached);
+    return std::shared_ptr<const SampleBank>(instrument, &instrument->cached.bank);
+}
+
+// WAV files the native reader understands start playing after their first
+// chunk and finish decoding in the background; nullptr for anything else.
+std::unique_ptr<ProgressiveSample> openProgressive(const std::string& path, int baseNote) {
+    if (hasExtension(path, ".wbk")) {
+        return nullptr;
+    }
+    try {
+        return std::make_unique<ProgressiveSample>(path, baseNote);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+struct AudioContext {
+    AudioContext(VoiceManager& voiceManager, int sampleRate) : manager(&voiceManager), stats(sampleRate) {}
+
+    VoiceManager* manager;
+    AudioClock clock;
+    AudioStats stats;
+};
+
 void audioCallback(void* userdata, Uint8* stream, int len) {
-    auto* manager = static_cast<VoiceManager*>(userdata);
+    const auto start = AudioStats::Clock::now();
+    // The device is opened before the sample is loaded; it stays paused
+    // until the context exists.
+    auto* context = static_cast<std::unique_ptr<AudioContext>*>(userdata)->get();
+    VoiceManager* manager = context->manager;
+    context->clock.publish(manager->renderedFrames(), AudioClock::Clock::now());
     float* output = reinterpret_cast<float*>(stream);
     const int frameCount = len / (sizeof(float) * manager->outputChannels());
     manager->mix(output, frameCount);
+    context->stats.recordCallback(
+        start, AudioStats::Clock::now(), frameCount, manager->activeVoiceCount(), manager->voiceSteals());
+}
+
+// Load meter, voice meter and callback-duration histogram in the top margin.
+// `recent` covers the last stats interval, so the bars follow the current
+// playing rather than the whole session.
+void renderStatsOverlay(SDL_Renderer* renderer, const AudioStats::Snapshot& recent, int maxVoices, int x, int y) {
+    constexpr int kMeterWidth = 160;
+    constexpr int kMeterHeight = 6;
+    constexpr int kBarWidth = 6;
+    constexpr int kHistogramHeight = 16;
+
+    auto meter = [&](int top, double fraction, double peak, SDL_Color color) {
+        const SDL_Rect frame{x, top, kMeterWidth, kMeterHeight};
+        SDL_SetRenderDrawColor(renderer, 50, 50, 65, 255);
+        SDL_RenderFillRect(renderer, &frame);
+        const SDL_Rect fill{x, top, static_cast<int>(kMeterWidth * std::clamp(fraction, 0.0, 1.0)), kMeterHeight};
+        SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+        SDL_RenderFillRect(renderer, &fill);
+        const SDL_Rect mark{x + static_cast<int>((kMeterWidth - 1) * std::clamp(peak, 0.0, 1.0)), top, 1, kMeterHeight};
+        SDL_SetRenderDrawColor(renderer, 240, 240, 240, 255);
+        SDL_RenderFillRect(renderer, &mark);
+    };
+
+    const double load = recent.meanLoad();
+    const SDL_Color loadColor = recent.overruns > 0 || load > 0.8 ? SDL_Color{220, 60, 60, 255}
+                                : load > 0.5                      ? SDL_Color{230, 190, 60, 255}
+                                                                  : SDL_Color{80, 200, 110, 255};
+    meter(y, load, recent.peakLoad, loadColor);
+    meter(y + kMeterHeight + 2,
+          static_cast<double>(recent.activeVoices) / maxVoices,
+          static_cast<double>(recent.peakVoices) / maxVoices,
+          SDL_Color{90, 140, 230, 255});
+
+    uint64_t tallest = 1;
+    for (uint64_t count : recent.histogram) {
+        tallest = std::max(tallest, count);
+    }
+    const int histogramX = x + kMeterWidth + 12;
+    for (int bucket = 0; bucket < AudioStats::kHistogramBuckets; ++bucket) {
+        const uint64_t count = recent.histogram[static_cast<size_t>(bucket)];
+        const int height = count == 0 ? 0 : std::max(1, static_cast<int>(kHistogramHeight * count / tallest));
+        const SDL_Rect bar{histogramX + bucket * (kBarWidth + 1), y + kHistogramHeight - height, kBarWidth, height};
+        SDL_SetRenderDrawColor(renderer, 150, 150, 190, 255);
+        SDL_RenderFillRect(renderer, &bar);
+    }
 }
 
 } // namespace
 
 int main(int argc, char** argv) {
+    const auto launchTime = std::chrono::steady_clock::now();
+    auto millisecondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    };
     if (argc < 2) {
-        std::cerr << "Brug: " << argv[0] << " <sti til wav> [basis midi note (21-108)]\n";
+        std::cerr << "Brug: " << argv[0]
+                  << " <sti til wav eller .wbk bank> [basis midi note (21-108)] [linear|hermite|sinc]"
+                     " [statistik.json|-] [float|int16] [A,D,S,R[,linear|exp]|-] [midi fifo/socket|-]"
+                     " [impulssvar.wav]\n";
         return 1;
     }
 
@@ -166,6 +408,21 @@ int main(int argc, char** argv) {
             baseNote = 60;
         }
     }
+    mix::Interpolation interpolation = mix::Interpolation::Linear;
+    if (argc >= 4 && !mix::parseInterpolation(argv[3], interpolation)) {
+        std::cerr << "Ukendt interpolation, bruger linear." << std::endl;
+    }
+    const std::string statsPath = argc >= 5 && std::strcmp(argv[4], "-") != 0 ? argv[4] : "";
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    if (argc >= 6 && !parseSampleFormat(argv[5], sampleFormat)) {
+        std::cerr << "Ukendt sampleformat, bruger float." << std::endl;
+    }
+    EnvelopeSettings envelope;
+    if (argc >= 7 && std::strcmp(argv[6], "-") != 0 && !parseEnvelope(argv[6], envelope)) {
+        std::cerr << "Ugyldig envelope, bruger standarden 0.01,0,1,0.05." << std::endl;
+    }
+    const std::string midiPath = argc >= 8 && std::strcmp(argv[7], "-") != 0 ? argv[7] : "";
+    const std::string reverbPath = argc >= 9 ? argv[8] : "";
 
     if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) < 0) {
         std::cerr << "Kunne ikke initialisere SDL: " << SDL_GetError() << "\n";
@@ -175,30 +432,19 @@ int main(int argc, char** argv) {
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
 
     const int desiredChannels = 2;
-    int sampleRate = 0;
-    int channels = 0;
-    std::vector<float> sampleData;
-
-    try {
-        sampleData = loadSample(filePath, sampleRate, channels, desiredChannels);
-    } catch (const std::exception& e) {
-        std::cerr << e.what() << "\n";
-        SDL_Quit();
-        return 1;
-    }
-
-    VoiceManager voiceManager(sampleData, sampleRate, channels, desiredChannels, baseNote);
+    std::unique_ptr<AudioContext> audioContext;
 
     SDL_AudioSpec desired{};
-    desired.freq = sampleRate;
+    desired.freq = kPreferredDeviceRate;
     desired.format = AUDIO_F32;
     desired.channels = desiredChannels;
     desired.samples = 1024;
     desired.callback = audioCallback;
-    desired.userdata = &voiceManager;
+    desired.userdata = &audioContext;
 
     SDL_AudioSpec obtained{};
-    SDL_AudioDeviceID device = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+    SDL_AudioDeviceID device =
+        SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
     if (!device) {
         std::cerr << "Kunne ikke åbne lyd enhed: " << SDL_GetError() << "\n";
         SDL_Quit();
@@ -220,7 +466,61 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    const int sampleRate = obtained.freq;
+    // Leave half the cores to the UI and the rest of the system.
+    const int renderThreads =
+        std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, kMaxRenderThreads);
+    std::unique_ptr<StreamingSample> streamedSample;
+    SampleBank streamedBank;
+    std::unique_ptr<ProgressiveSample> progressiveSample;
+    SampleBank progressiveBank;
+    std::shared_ptr<const SampleBank> instrument;
+    std::unique_ptr<VoiceManager> voiceManager;
+
+    try {
+        if (!hasExtension(filePath, ".wbk") && streamableFormat(filePath)) {
+            // Too large to convert up front; the voice's pitch step absorbs
+            // the rate difference instead.
+            streamedSample = std::make_unique<StreamingSample>(filePath, kStreamHeadFrames, baseNote);
+            streamedBank = SampleBank::fromZones({streamedSample->zone()});
+            voiceManager =
+                std::make_unique<VoiceManager>(streamedBank, sampleRate, desiredChannels, kPolyphony, renderThreads);
+        } else if ((instrument = findCachedInstrument(filePath, sampleRate, sampleFormat, baseNote))) {
+            // A warm cache maps the converted sample at once, so there is
+            // nothing to decode progressively.
+            voiceManager =
+                std::make_unique<VoiceManager>(*instrument, sampleRate, desiredChannels, kPolyphony, renderThreads);
+        } else if ((progressiveSample = openProgressive(filePath, baseNote))) {
+            // Playable as soon as the first chunk is in; the converted sample
+            // replaces it once loaded (see below).
+            progressiveBank = SampleBank::fromZones({progressiveSample->zone()});
+            voiceManager = std::make_unique<VoiceManager>(
+                progressiveBank, sampleRate, desiredChannels, kPolyphony, renderThreads);
+        } else {
+            instrument = loadInstrument(filePath, sampleRate, sampleFormat, baseNote, desiredChannels);
+            voiceManager =
+                std::make_unique<VoiceManager>(*instrument, sampleRate, desiredChannels, kPolyphony, renderThreads);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        SDL_CloseAudioDevice(device);
+        SDL_Quit();
+        return 1;
+    }
+    voiceManager->setInterpolation(interpolation);
+    voiceManager->setEnvelope(envelope);
+    if (!reverbPath.empty()) {
+        try {
+            voiceManager->setReverb(loadImpulseResponse(reverbPath, sampleRate));
+            std::cout << "Efterklang: " << reverbPath << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    audioContext = std::make_unique<AudioContext>(*voiceManager, sampleRate);
+
     SDL_PauseAudioDevice(device, 0);
+    std::cout << "Spilbar efter " << millisecondsSince(launchTime) << " ms" << std::endl;
 
     const int whiteKeyWidth = 26;
     const int whiteKeyHeight = 220;
@@ -326,96 +626,292 @@ int main(int argc, char** argv) {
     bool mouseDown = false;
     std::optional<int> activeKeyIndex;
 
-    while (running) {
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-            case SDL_QUIT:
-                running = false;
-                break;
-            case SDL_KEYDOWN:
-                if (event.key.keysym.sym == SDLK_ESCAPE) {
-                    running = false;
-                } else if (event.key.keysym.sym == SDLK_SPACE && activeKeyIndex) {
-                    voiceManager.noteOff(keys[*activeKeyIndex].midiNote);
-                    keys[*activeKeyIndex].pressed = false;
-                    activeKeyIndex.reset();
-                } else if (event.key.keysym.sym == SDLK_BACKSPACE) {
-                    voiceManager.stopAll();
-                    for (auto& key : keys) {
-                        key.pressed = false;
+    bool showStats = false;
+    AudioStats::Snapshot previousStats = audioContext->stats.snapshot();
+    AudioStats::Snapshot recentStats = previousStats;
+    Uint32 nextStatsTick = SDL_GetTicks() + kStatsIntervalMs;
+
+    // Input is stamped one device buffer ahead of the time it happened, which
+    // the next callback always covers, so every event has the same latency
+    // instead of snapping to whichever callback comes first.
+    const uint64_t eventLatency = obtained.samples;
+    auto frameFor = [&](AudioClock::Clock::time_point time) {
+        const uint64_t frame = audioContext->clock.frameAt(time, sampleRate);
+        return frame == VoiceManager::kNow ? VoiceManager::kNow : frame + eventLatency;
+    };
+    auto eventFrame = [&](const SDL_Event& event) {
+        const Uint32 age = SDL_GetTicks() - event.common.timestamp;
+        return frameFor(AudioClock::Clock::now() - std::chrono::milliseconds(age));
+    };
+
+    // MIDI arrives on its own thread and goes straight to the engine's event
+    // queue, stamped with the time its bytes were read.
+    std::unique_ptr<MidiInput> midiInput;
+    if (!midiPath.empty()) {
+        try {
+            midiInput = std::make_unique<MidiInput>(
+                midiPath, [&](const MidiMessage& message, MidiInput::Clock::time_point received) {
+                    if (message.isNoteOn()) {
+                        voiceManager->noteOn(message.data1, message.data2, frameFor(received));
+                    } else if (message.isNoteOff()) {
+                        voiceManager->noteOff(message.data1, frameFor(received));
+                    } else if (message.isControlChange() && (message.data1 == 120 || message.data1 == 123)) {
+                        voiceManager->stopAll(frameFor(received)); // all sound off / all notes off
                     }
-                    activeKeyIndex.reset();
+                });
+            std::cout << "MIDI input: " << midiPath << (midiInput->isSocket() ? " (socket)" : " (FIFO)")
+                      << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    // R reloads the sample file and dropping a file on the window loads that
+    // one; either way it is read and converted on its own thread and swapped
+    // in while playing, with sounding notes finishing on the old sample.
+    std::thread loader;
+    std::atomic<bool> loading{false};
+    std::atomic<bool> progressiveReplaced{false};
+    // With `progressive` this is the first load, finishing what the
+    // progressive decode started, and is timed from launch.
+    auto loadInBackground = [&](const std::string& path, const ProgressiveSample* progressive = nullptr) {
+        if (loading.exchange(true)) {
+            std::cout << "Indlæser allerede en sample" << std::endl;
+            return;
+        }
+        if (loader.joinable()) {
+            loader.join();
+        }
+        const auto start = progressive ? launchTime : std::chrono::steady_clock::now();
+        loader = std::thread([&, path, progressive, start] {
+            try {
+                if (!hasExtension(path, ".wbk") && streamableFormat(path)) {
+                    throw std::runtime_error("Filen streames fra disk og kan ikke skiftes ind mens der spilles: " +
+                                             path);
                 }
-                break;
-            case SDL_MOUSEBUTTONDOWN:
-                if (event.button.button == SDL_BUTTON_LEFT) {
-                    mouseDown = true;
-                    const auto keyIndex =
-                        findKeyAtPosition(event.button.x, event.button.y, keys, blackIndices, whiteIndices);
-                    if (keyIndex) {
-                        activeKeyIndex = keyIndex;
-                        auto& key = keys[*keyIndex];
-                        key.pressed = true;
-                        voiceManager.noteOn(key.midiNote);
-                    }
+                voiceManager->publishBank(
+                    loadInstrument(path, sampleRate, sampleFormat, baseNote, desiredChannels, progressive));
+                if (progressive) {
+                    progressiveReplaced = true;
                 }
-                break;
-            case SDL_MOUSEBUTTONUP:
-                if (event.button.button == SDL_BUTTON_LEFT) {
-                    mouseDown = false;
-                    if (activeKeyIndex) {
-                        auto& key = keys[*activeKeyIndex];
-                        key.pressed = false;
-                        voiceManager.noteOff(key.midiNote);
-                        activeKeyIndex.reset();
-                    }
+                std::cout << "Indlæst: " << path << " efter " << millisecondsSince(start) << " ms" << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+            loading = false;
+        });
+    };
+
+    if (progressiveSample) {
+        loadInBackground(filePath, progressiveSample.get());
+    }
+
+    // Key state changes repaint only the affected keys into a cached
+    // keyboard texture; the window is presented only when something changed,
+    // and between events the loop sleeps until the next statistics tick.
+    SDL_Texture* keyboardTexture = nullptr;
+    auto createKeyboardTexture = [&] {
+        if (SDL_RenderTargetSupported(renderer)) {
+            keyboardTexture =
+                SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+        }
+        if (keyboardTexture) {
+            SDL_SetTextureBlendMode(keyboardTexture, SDL_BLENDMODE_NONE);
+        }
+    };
+    createKeyboardTexture();
+    const KeyLookup keyLookup(keys, width);
+    std::vector<int> dirtyKeys;
+    dirtyKeys.reserve(kTotalKeys);
+    bool repaintKeyboard = true;
+    bool present = true;
+
+    auto setPressed = [&](int index, bool pressed) {
+        if (keys[index].pressed != pressed) {
+            keys[index].pressed = pressed;
+            dirtyKeys.push_back(index);
+            present = true;
+        }
+    };
+
+    auto handleEvent = [&](const SDL_Event& event) {
+        switch (event.type) {
+        case SDL_QUIT:
+            running = false;
+            break;
+        case SDL_KEYDOWN:
+            if (event.key.keysym.sym == SDLK_ESCAPE) {
+                running = false;
+            } else if (event.key.keysym.sym == SDLK_i) {
+                showStats = !showStats;
+                present = true;
+                if (!showStats) {
+                    SDL_SetWindowTitle(window, title.c_str());
                 }
-                break;
-            case SDL_WINDOWEVENT:
-                if (event.window.event == SDL_WINDOWEVENT_LEAVE && mouseDown) {
-                    mouseDown = false;
-                    if (activeKeyIndex) {
-                        auto& key = keys[*activeKeyIndex];
-                        key.pressed = false;
-                        voiceManager.noteOff(key.midiNote);
-                        activeKeyIndex.reset();
-                    }
+            } else if (event.key.keysym.sym == SDLK_SPACE && activeKeyIndex) {
+                voiceManager->noteOff(keys[*activeKeyIndex].midiNote, eventFrame(event));
+                setPressed(*activeKeyIndex, false);
+                activeKeyIndex.reset();
+            } else if (event.key.keysym.sym == SDLK_r) {
+                loadInBackground(filePath);
+            } else if (event.key.keysym.sym == SDLK_BACKSPACE) {
+                voiceManager->stopAll(eventFrame(event));
+                for (int index = 0; index < kTotalKeys; ++index) {
+                    setPressed(index, false);
+                }
+                activeKeyIndex.reset();
+            }
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            if (event.button.button == SDL_BUTTON_LEFT) {
+                mouseDown = true;
+                const auto keyIndex = keyLookup.keyAt(event.button.x, event.button.y);
+                if (keyIndex) {
+                    activeKeyIndex = keyIndex;
+                    setPressed(*keyIndex, true);
+                    voiceManager->noteOn(keys[*keyIndex].midiNote, 127, eventFrame(event));
                 }
-                break;
-            case SDL_MOUSEMOTION:
-                if (mouseDown) {
-                    const auto keyIndex =
-                        findKeyAtPosition(event.motion.x, event.motion.y, keys, blackIndices, whiteIndices);
-                    if (keyIndex && (!activeKeyIndex || *keyIndex != *activeKeyIndex)) {
-                        if (activeKeyIndex) {
-                            auto& previous = keys[*activeKeyIndex];
-                            previous.pressed = false;
-                            voiceManager.noteOff(previous.midiNote);
-                        }
-                        activeKeyIndex = keyIndex;
-                        auto& key = keys[*keyIndex];
-                        key.pressed = true;
-                        voiceManager.noteOn(key.midiNote);
+            }
+            break;
+        case SDL_MOUSEBUTTONUP:
+            if (event.button.button == SDL_BUTTON_LEFT) {
+                mouseDown = false;
+                if (activeKeyIndex) {
+                    setPressed(*activeKeyIndex, false);
+                    voiceManager->noteOff(keys[*activeKeyIndex].midiNote, eventFrame(event));
+                    activeKeyIndex.reset();
+                }
+            }
+            break;
+        case SDL_WINDOWEVENT:
+            if (event.window.event == SDL_WINDOWEVENT_LEAVE && mouseDown) {
+                mouseDown = false;
+                if (activeKeyIndex) {
+                    setPressed(*activeKeyIndex, false);
+                    voiceManager->noteOff(keys[*activeKeyIndex].midiNote, eventFrame(event));
+                    activeKeyIndex.reset();
+                }
+            } else if (event.window.event == SDL_WINDOWEVENT_EXPOSED ||
+                       event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                present = true;
+            }
+            break;
+        case SDL_MOUSEMOTION:
+            if (mouseDown) {
+                const auto keyIndex = keyLookup.keyAt(event.motion.x, event.motion.y);
+                if (keyIndex && (!activeKeyIndex || *keyIndex != *activeKeyIndex)) {
+                    if (activeKeyIndex) {
+                        setPressed(*activeKeyIndex, false);
+                        voiceManager->noteOff(keys[*activeKeyIndex].midiNote, eventFrame(event));
                     }
+                    activeKeyIndex = keyIndex;
+                    setPressed(*keyIndex, true);
+                    voiceManager->noteOn(keys[*keyIndex].midiNote, 127, eventFrame(event));
                 }
-                break;
-            default:
-                break;
             }
+            break;
+        case SDL_DROPFILE:
+            loadInBackground(event.drop.file);
+            SDL_free(event.drop.file);
+            break;
+        case SDL_RENDER_TARGETS_RESET:
+            // Target texture contents were lost (e.g. Direct3D device change).
+            repaintKeyboard = true;
+            present = true;
+            break;
+        case SDL_RENDER_DEVICE_RESET:
+            if (keyboardTexture) {
+                SDL_DestroyTexture(keyboardTexture);
+                keyboardTexture = nullptr;
+            }
+            createKeyboardTexture();
+            repaintKeyboard = true;
+            present = true;
+            break;
+        default:
+            break;
         }
+    };
 
-        SDL_SetRenderDrawColor(renderer, 15, 15, 25, 255);
-        SDL_RenderClear(renderer);
+    while (running) {
+        SDL_Event event;
+        const Sint32 untilStats = static_cast<Sint32>(nextStatsTick - SDL_GetTicks());
+        if (SDL_WaitEventTimeout(&event, std::max<Sint32>(untilStats, 1))) {
+            handleEvent(event);
+            while (running && SDL_PollEvent(&event)) {
+                handleEvent(event);
+            }
+        }
 
-        renderKeyboard(renderer, keys, whiteIndices, blackIndices, baseNote);
+        // Statistics are read here on the UI thread; the audio callback only
+        // ever stores counters.
+        if (static_cast<Sint32>(SDL_GetTicks() - nextStatsTick) >= 0) {
+            nextStatsTick += kStatsIntervalMs;
+            // The progressively decoded copy goes once no voice reads it. The
+            // flag is read first so the reclaim below sees its publish.
+            const bool replaced = progressiveReplaced.load();
+            if (voiceManager->reclaimBanks() == 0 && replaced) {
+                progressiveReplaced = false;
+                progressiveSample.reset();
+            }
+            const AudioStats::Snapshot current = audioContext->stats.snapshot();
+            recentStats = current.since(previousStats);
+            previousStats = current;
+            if (showStats) {
+                std::cout << recentStats.toText() << std::endl;
+                const std::string statsTitle =
+                    title + " | load " + std::to_string(static_cast<int>(100.0 * recentStats.meanLoad())) +
+                    "% | stemmer " + std::to_string(recentStats.activeVoices) + "/" +
+                    std::to_string(voiceManager->maxVoices()) + " | xruns " +
+                    std::to_string(current.overruns + current.lateCallbacks);
+                SDL_SetWindowTitle(window, statsTitle.c_str());
+                present = true;
+            }
+            if (!statsPath.empty()) {
+                std::ofstream(statsPath, std::ios::trunc)
+                    << "{\"total\":" << current.toJson() << ",\"recent\":" << recentStats.toJson() << "}\n";
+            }
+        }
 
+        if (!present || !running) {
+            continue;
+        }
+        if (keyboardTexture) {
+            SDL_SetRenderTarget(renderer, keyboardTexture);
+            if (repaintKeyboard) {
+                SDL_SetRenderDrawColor(renderer, 15, 15, 25, 255);
+                SDL_RenderClear(renderer);
+                renderKeyboard(renderer, keys, whiteIndices, blackIndices, baseNote);
+            } else {
+                for (int index : dirtyKeys) {
+                    redrawKey(renderer, keys, index, baseNote);
+                }
+            }
+            SDL_SetRenderTarget(renderer, nullptr);
+            SDL_RenderCopy(renderer, keyboardTexture, nullptr, nullptr);
+        } else {
+            SDL_SetRenderDrawColor(renderer, 15, 15, 25, 255);
+            SDL_RenderClear(renderer);
+            renderKeyboard(renderer, keys, whiteIndices, blackIndices, baseNote);
+        }
+        if (showStats) {
+            renderStatsOverlay(renderer, recentStats, voiceManager->maxVoices(), margin, 4);
+        }
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
+        dirtyKeys.clear();
+        repaintKeyboard = false;
+        present = false;
     }
 
+    midiInput.reset();
+    if (loader.joinable()) {
+        loader.join();
+    }
     SDL_PauseAudioDevice(device, 1);
     SDL_CloseAudioDevice(device);
+    if (keyboardTexture) {
+        SDL_DestroyTexture(keyboardTexture);
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
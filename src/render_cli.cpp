@@ -0,0 +1,331 @@
+#include "NoteList.h"
+#include "OfflineRenderer.h"
+#include "Resampler.h"
+#include "SampleBank.h"
+#include "SampleCache.h"
+#include "SampleStreamer.h"
+#include "VoiceManager.h"
+#include "WavFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+constexpr int kFirstMidiNote = 21;  // A0
+constexpr int kLastMidiNote = 108;  // C8
+
+bool hasExtension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// "start,end" in frames.
+bool parseLoop(const std::string& text, size_t& start, size_t& end) {
+    char* rest = nullptr;
+    const unsigned long long first = std::strtoull(text.c_str(), &rest, 10);
+    if (rest == text.c_str() || *rest != ',') {
+        return false;
+    }
+    const char* second = rest + 1;
+    const unsigned long long last = std::strtoull(second, &rest, 10);
+    if (rest == second || *rest != '\0' || first >= last) {
+        return false;
+    }
+    start = static_cast<size_t>(first);
+    end = static_cast<size_t>(last);
+    return true;
+}
+
+// "off", or "mask[,floor]" in dB.
+bool parseVirtualization(const std::string& text, VirtualizationSettings& settings) {
+    if (text == "off") {
+        settings.enabled = false;
+        return true;
+    }
+    char* rest = nullptr;
+    settings.maskDb = std::strtod(text.c_str(), &rest);
+    if (rest == text.c_str() || (*rest != '\0' && *rest != ',')) {
+        return false;
+    }
+    if (*rest == ',') {
+        const char* floor = rest + 1;
+        settings.floorDb = std::strtod(floor, &rest);
+        if (rest == floor || *rest != '\0') {
+            return false;
+        }
+    }
+    settings.enabled = true;
+    return true;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Brug: " << program << " <sample.wav|bank.wbk> <noder.txt|noder.mid> <output.wav> [valg]\n"
+              << "  --base-note N   basis midi note for samplet (standard 60)\n"
+              << "  --rate N        motorens sample rate; samples konverteres ved indlæsning (standard samplets/bankens egen)\n"
+              << "  --channels N    antal output kanaler (standard 2)\n"
+              << "  --block N       frames per mix kald (standard 512)\n"
+              << "  --tail S        maks sekunder efter sidste event (standard 10)\n"
+              << "  --voices N      polyfoni (standard 32)\n"
+              << "  --threads N     render-tråde inkl. kaldende tråd (standard 1)\n"
+              << "  --interp M      linear, hermite eller sinc (standard linear)\n"
+              << "  --phase P       afspilningsposition som double eller fixed (32.32 fast komma, standard double)\n"
+              << "  --virtual V     off eller MASK[,GULV] i dB: stemmer under dem renderes ikke (standard -40,-70)\n"
+              << "  --pitch-cache MB afspil gentagne noder fra forud transponerede kopier inden for MB (standard 0 = fra)\n"
+              << "  --reverb IR     send mixet gennem en foldningsefterklang med impulssvaret i WAV filen IR\n"
+              << "  --reverb-send G andel af mixet der sendes til efterklangen (standard 0.25)\n"
+              << "  --envelope E    A,D,S,R[,linear|exp]: sekunder og sustain-niveau 0..1 (standard 0.01,0,1,0.05)\n"
+              << "  --format F      samples i hukommelsen som float eller int16 (planar, standard float)\n"
+              << "  --cache DIR     hent afkodede og konverterede samples fra/til cachen i DIR\n"
+              << "  --stream N      afspil WAV fra disk med N frames i hukommelsen (standard 0 = hele filen)\n"
+              << "  --loop A,B      loop frames A til B (eksklusiv) i stedet for WAV filens smpl loop\n"
+              << "  --crossfade N   krydsfade loopet over N frames (standard 0)\n"
+              << "  --check-onsets  mål nodernes ansatser mod en reference-rendering delt ved hver event\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::string samplePath = argv[1];
+    const std::string notesPath = argv[2];
+    const std::string outputPath = argv[3];
+
+    int baseNote = 60;
+    int outputChannels = 2;
+    int engineRate = 0;
+    size_t streamHeadFrames = 0;
+    int maxVoices = VoiceManager::kDefaultMaxVoices;
+    int renderThreads = 1;
+    mix::Interpolation interpolation = mix::Interpolation::Linear;
+    mix::PhaseFormat phaseFormat = mix::PhaseFormat::Double;
+    SampleFormat sampleFormat = SampleFormat::Float32;
+    EnvelopeSettings envelope;
+    VirtualizationSettings virtualization;
+    // Offline rendering outruns a background thread, so pitched copies and
+    // the reverb tail are computed inline.
+    PitchCacheSettings pitchCache;
+    pitchCache.budgetBytes = 0;
+    pitchCache.background = false;
+    std::string reverbPath;
+    ReverbSettings reverb;
+    reverb.backgroundTail = false;
+    RenderOptions options;
+    bool checkOnsets = false;
+    std::string cacheDirectory;
+    bool explicitLoop = false;
+    size_t loopStart = 0;
+    size_t loopEnd = 0;
+    size_t crossfadeFrames = 0;
+
+    for (int i = 4; i < argc; ++i) {
+        const std::string option = argv[i];
+        if (option == "--check-onsets") {
+            checkOnsets = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (option == "--base-note") {
+            baseNote = std::clamp(std::atoi(value), kFirstMidiNote, kLastMidiNote);
+        } else if (option == "--rate") {
+            engineRate = std::max(0, std::atoi(value));
+        } else if (option == "--channels") {
+            outputChannels = std::max(1, std::atoi(value));
+        } else if (option == "--block") {
+            options.blockSize = std::max(1, std::atoi(value));
+        } else if (option == "--tail") {
+            options.tailSeconds = std::max(0.0, std::atof(value));
+        } else if (option == "--voices") {
+            maxVoices = std::max(1, std::atoi(value));
+        } else if (option == "--threads") {
+            renderThreads = std::max(1, std::atoi(value));
+        } else if (option == "--interp") {
+            if (!mix::parseInterpolation(value, interpolation)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--phase") {
+            if (!mix::parsePhaseFormat(value, phaseFormat)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--virtual") {
+            if (!parseVirtualization(value, virtualization)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--pitch-cache") {
+            pitchCache.budgetBytes = static_cast<size_t>(std::max(0.0, std::atof(value)) * 1024.0 * 1024.0);
+        } else if (option == "--reverb") {
+            reverbPath = value;
+        } else if (option == "--reverb-send") {
+            reverb.send = static_cast<float>(std::max(0.0, std::atof(value)));
+        } else if (option == "--envelope") {
+            if (!parseEnvelope(value, envelope)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--format") {
+            if (!parseSampleFormat(value, sampleFormat)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (option == "--cache") {
+            cacheDirectory = value;
+        } else if (option == "--stream") {
+            streamHeadFrames = static_cast<size_t>(std::max(0L, std::atol(value)));
+        } else if (option == "--loop") {
+            if (!parseLoop(value, loopStart, loopEnd)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            explicitLoop = true;
+        } else if (option == "--crossfade") {
+            crossfadeFrames = static_cast<size_t>(std::max(0L, std::atol(value)));
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((explicitLoop || crossfadeFrames > 0) && (hasExtension(samplePath, ".wbk") || streamHeadFrames > 0)) {
+        std::cerr << "--loop og --crossfade gælder kun WAV filer uden --stream; banker har loops i manifestet\n";
+        return 1;
+    }
+
+    try {
+        const std::vector<NoteEvent> events = readNoteList(notesPath);
+
+        WavData sample;
+        std::unique_ptr<StreamingSample> streamed;
+        CachedSample cached;
+        SampleBank bank;
+        SampleBank engineBank;
+        std::vector<std::vector<float>> convertedStorage;
+        std::vector<std::vector<int16_t>> compactStorage;
+        const auto loadStart = std::chrono::steady_clock::now();
+        const bool useCache = !cacheDirectory.empty() && !hasExtension(samplePath, ".wbk") && streamHeadFrames == 0;
+        if (useCache) {
+            engineRate = engineRate > 0 ? engineRate : readWavFormat(samplePath).sampleRate;
+            SampleCacheSettings settings;
+            settings.sampleRate = engineRate;
+            settings.format = sampleFormat;
+            settings.explicitLoop = explicitLoop;
+            settings.loopStart = loopStart;
+            settings.loopEnd = loopEnd;
+            settings.crossfadeFrames = crossfadeFrames;
+            cached = SampleCache(cacheDirectory).load(samplePath, settings, baseNote);
+            engineBank = std::move(cached.bank);
+        } else {
+            if (hasExtension(samplePath, ".wbk")) {
+                bank = SampleBank::open(samplePath);
+            } else if (streamHeadFrames > 0) {
+                streamed = std::make_unique<StreamingSample>(samplePath, streamHeadFrames, baseNote);
+                bank = SampleBank::fromZones({streamed->zone()});
+            } else {
+                sample = readWav(samplePath);
+                if (explicitLoop) {
+                    sample.setLoop(loopStart, loopEnd);
+                }
+                crossfadeLoop(sample, crossfadeFrames);
+                bank = SampleBank::fromSample(sample.samples.data(),
+                                              sample.frames(),
+                                              sample.channels,
+                                              sample.sampleRate,
+                                              baseNote,
+                                              sample.loopStart,
+                                              sample.loopEnd);
+            }
+            if (bank.empty()) {
+                throw std::runtime_error("Sample banken indeholder ingen zoner");
+            }
+            engineRate = engineRate > 0 ? engineRate : bank.zones().front().sampleRate;
+        }
+        const double loadSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        // Convert once here, like the player does for its device rate.
+        const auto convertStart = std::chrono::steady_clock::now();
+        if (!useCache) {
+            engineBank = resampleBank(bank, engineRate, convertedStorage);
+            if (sampleFormat == SampleFormat::Int16Planar) {
+                engineBank = compactBank(engineBank, compactStorage);
+            }
+        }
+        const double convertSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - convertStart).count();
+
+        const ImpulseResponse impulse =
+            reverbPath.empty() ? ImpulseResponse{} : loadImpulseResponse(reverbPath, engineRate);
+
+        auto render = [&](EventTiming timing) {
+            VoiceManager manager(engineBank, engineRate, outputChannels, maxVoices, renderThreads);
+            manager.setInterpolation(interpolation);
+            manager.setPhaseFormat(phaseFormat);
+            manager.setEnvelope(envelope);
+            manager.setVirtualization(virtualization);
+            manager.setPitchCache(pitchCache);
+            manager.setReverb(impulse, reverb);
+            RenderOptions renderOptions = options;
+            renderOptions.timing = timing;
+            RenderResult result = renderOffline(manager, events, renderOptions);
+            return std::make_tuple(std::move(result), manager.streamUnderruns(), manager.pitchCacheStats());
+        };
+        const auto [result, underruns, pitchStats] = render(options.timing);
+        writeWav(outputPath, result.samples.data(), result.frames, outputChannels, engineRate);
+
+        std::cout << "events:          " << events.size() << "\n"
+                  << "frames:          " << result.frames << "\n"
+                  << "audio seconds:   " << result.audioSeconds << "\n"
+                  << "render seconds:  " << result.renderSeconds << "\n"
+                  << "real-time factor " << result.realTimeFactor() << "x\n";
+        if (useCache) {
+            std::cout << "load seconds:    " << loadSeconds << (cached.hit ? " (cache hit)" : " (cache miss)") << "\n";
+        } else if (!convertedStorage.empty() || !compactStorage.empty()) {
+            std::cout << "convert seconds: " << convertSeconds << "\n";
+        }
+        if (streamed) {
+            std::cout << "stream underruns " << underruns << "\n";
+        }
+        if (pitchCache.budgetBytes > 0) {
+            const uint64_t noteOns = pitchStats.hits + pitchStats.misses;
+            std::cout << "pitch cache:     " << pitchStats.hits << "/" << noteOns << " hits, " << pitchStats.renders
+                      << " kopier, " << pitchStats.evictions << " smidt ud, "
+                      << static_cast<double>(pitchStats.bytes) / (1024.0 * 1024.0) << " af "
+                      << static_cast<double>(pitchCache.budgetBytes) / (1024.0 * 1024.0) << " MB\n";
+        }
+
+        if (checkOnsets) {
+            const RenderResult reference = std::get<0>(render(EventTiming::SplitBlocks));
+            const RenderResult blockStart = std::get<0>(render(EventTiming::BlockStart));
+            auto report = [&](const char* label, const RenderResult& rendered) {
+                const OnsetReport onsets = compareOnsets(rendered, reference, events, engineRate, outputChannels);
+                std::cout << label << onsets.exact << "/" << onsets.checked << " exakte, maks fejl "
+                          << onsets.maxError << " frames, middel " << onsets.meanError << "\n";
+            };
+            std::cout << "onsets (blok " << options.blockSize << ")\n";
+            report("  tidsstemplet:  ", result);
+            report("  blokstart:     ", blockStart);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+// Note events from several producer threads against a headless mix() loop.
+// Each producer owns its own keys and sends note-on/note-off pairs in short
+// bursts, waiting for the mixer to drain each burst so the queue never fills,
+// with an occasional stopAll(). Afterwards no event may have been dropped,
+// exactly the note each producer left held may still sound, and every voice
+// must be back on the free list. Meant to run under -fsanitize=thread too.
+
+#include "VoiceManager.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int kProducers = 4;
+constexpr int kKeysPerProducer = 16;
+constexpr int kFirstKey = 24;
+constexpr int kRounds = 1000;
+constexpr int kPairsPerBurst = 4;
+constexpr int kStopAllEvery = 97;
+constexpr int kMaxVoices = 128;
+constexpr int kMixFrames = 256;
+
+int failures = 0;
+
+void check(bool condition, const char* what, long long actual, long long expected) {
+    if (!condition) {
+        std::fprintf(stderr, "FEJL: %s: %lld, forventet %lld\n", what, actual, expected);
+        ++failures;
+    }
+}
+
+// Renders until `frames` more frames are done; only from the mixing thread.
+void render(VoiceManager& voices, std::vector<float>& buffer, int frames) {
+    for (int done = 0; done < frames; done += kMixFrames) {
+        voices.mix(buffer.data(), kMixFrames);
+    }
+}
+
+// Blocks until a mix() call has started after this point, so everything
+// posted before has been drained.
+void waitForDrain(const VoiceManager& voices) {
+    const uint64_t posted = voices.renderedFrames();
+    while (voices.renderedFrames() < posted + 2 * kMixFrames) {
+        std::this_thread::yield();
+    }
+}
+
+void produce(VoiceManager& voices, int producer, std::atomic<int>& finished) {
+    const int firstKey = kFirstKey + producer * kKeysPerProducer;
+    int key = 0;
+    for (int round = 0; round < kRounds; ++round) {
+        for (int pair = 0; pair < kPairsPerBurst; ++pair) {
+            const int note = firstKey + key;
+            key = (key + 1) % kKeysPerProducer;
+            voices.noteOn(note, 1 + (round + pair) % 127);
+            voices.noteOff(note);
+        }
+        if ((round + producer) % kStopAllEvery == 0) {
+            voices.stopAll();
+        }
+        waitForDrain(voices);
+    }
+    // Hold one note once nobody can stopAll() any more.
+    finished.fetch_add(1, std::memory_order_acq_rel);
+    while (finished.load(std::memory_order_acquire) < kProducers) {
+        std::this_thread::yield();
+    }
+    voices.noteOn(firstKey);
+}
+
+} // namespace
+
+int main() {
+    // A looped sample never ends on its own, so a lost note-off would leave
+    // its voice sounding.
+    const size_t frames = kSampleRate / 10;
+    std::vector<float> sample(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        sample[i] = (i % 100 < 50) ? 0.1f : -0.1f;
+    }
+    const SampleBank bank = SampleBank::fromSample(sample.data(), frames, 1, kSampleRate, 60, 0, frames);
+    VoiceManager voices(bank, kSampleRate, 2, kMaxVoices);
+    EnvelopeSettings envelope;
+    envelope.releaseSeconds = 0.002;
+    voices.setEnvelope(envelope);
+
+    std::vector<float> buffer(static_cast<size_t>(kMixFrames) * 2);
+    std::atomic<bool> mixing{true};
+    std::thread mixer([&] {
+        while (mixing.load(std::memory_order_acquire)) {
+            voices.mix(buffer.data(), kMixFrames);
+        }
+    });
+    std::atomic<int> finished{0};
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < kProducers; ++producer) {
+        producers.emplace_back(produce, std::ref(voices), producer, std::ref(finished));
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    mixing.store(false, std::memory_order_release);
+    mixer.join();
+
+    // This thread mixes from here on. Let every release finish.
+    render(voices, buffer, kSampleRate / 10);
+    check(voices.droppedEvents() == 0, "tabte events", static_cast<long long>(voices.droppedEvents()), 0);
+    check(voices.activeVoiceCount() == kProducers, "stemmer efter sidste note-on", voices.activeVoiceCount(),
+          kProducers);
+
+    voices.stopAll();
+    render(voices, buffer, kMixFrames);
+    check(voices.activeVoiceCount() == 0, "stemmer efter stopAll", voices.activeVoiceCount(), 0);
+
+    // Every voice must be free again: a full keyboard fits without stealing.
+    const uint64_t steals = voices.voiceSteals();
+    for (int note = 0; note < kMaxVoices; ++note) {
+        voices.noteOn(note);
+    }
+    render(voices, buffer, kMixFrames);
+    check(voices.activeVoiceCount() == kMaxVoices, "stemmer efter fuldt klaviatur", voices.activeVoiceCount(),
+          kMaxVoices);
+    check(voices.voiceSteals() == steals, "stjålne stemmer", static_cast<long long>(voices.voiceSteals() - steals),
+          0);
+
+    if (failures > 0) {
+        return 1;
+    }
+    std::printf("OK: %d producenter, %d note-par hver\n", kProducers, kRounds * kPairsPerBurst);
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Multi-threaded rendering through renderOffline. Partial buses are summed in
+// a fixed chunk order, so a dense, polyphonic event list must render to the
+// same bytes for 2, 3 and 4 render threads, every time. One thread takes the
+// serial path: it must repeat itself exactly, match the pool bit for bit
+// while only one voice sounds at a time (there is nothing to sum then), and
+// stay within rounding of the pool otherwise.
+
+#include "OfflineRenderer.h"
+#include "VoiceManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr int kSampleRate = 48000;
+constexpr int kMaxVoices = 64;
+constexpr int kRuns = 2;
+constexpr int kThreadCounts[] = {2, 3, 4};
+constexpr double kMaxSerialDeviation = 1e-6;
+constexpr double kPi = 3.14159265358979323846;
+
+int failures = 0;
+
+void fail(const char* what, int threads) {
+    std::fprintf(stderr, "FEJL: %s (%d tråde)\n", what, threads);
+    ++failures;
+}
+
+// Stereo and looped, with a different waveform per channel so both buses
+// carry their own signal; quiet enough that the densest chord never clips.
+std::vector<float> makeSample(size_t frames) {
+    std::vector<float> sample(frames * 2);
+    for (size_t i = 0; i < frames; ++i) {
+        const double t = static_cast<double>(i) / kSampleRate;
+        const double fade = 1.0 - 0.5 * static_cast<double>(i) / static_cast<double>(frames);
+        sample[i * 2] =
+            static_cast<float>(0.03 * std::sin(2.0 * kPi * 261.63 * t) + 0.01 * std::sin(2.0 * kPi * 523.25 * t));
+        sample[i * 2 + 1] = static_cast<float>(0.03 * std::sin(2.0 * kPi * 261.63 * t + 1.0) * fade);
+    }
+    return sample;
+}
+
+// Chords of one to eight notes every 50 ms, each held 400 ms, so up to about
+// 50 voices overlap and the chunks come out uneven.
+std::vector<NoteEvent> chords() {
+    std::vector<NoteEvent> events;
+    for (int chord = 0; chord < 48; ++chord) {
+        const double start = 0.05 * chord;
+        const int size = 1 + chord % 8;
+        for (int i = 0; i < size; ++i) {
+            const int note = 36 + (chord * 5 + i * 7) % 48;
+            events.push_back({start, note, 20 + (chord * 13 + i * 29) % 108, true});
+            events.push_back({start + 0.4, note, 0, false});
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const NoteEvent& a, const NoteEvent& b) {
+        return a.time < b.time;
+    });
+    return events;
+}
+
+// One note at a time, each released well before the next starts.
+std::vector<NoteEvent> melody() {
+    std::vector<NoteEvent> events;
+    for (int i = 0; i < 12; ++i) {
+        const int note = 48 + (i * 5) % 24;
+        events.push_back({0.2 * i, note, 100, true});
+        events.push_back({0.2 * i + 0.1, note, 0, false});
+    }
+    return events;
+}
+
+RenderResult render(const SampleBank& bank, const std::vector<NoteEvent>& events, int threads) {
+    VoiceManager voices(bank, kSampleRate, 2, kMaxVoices, threads);
+    voices.setInterpolation(mix::Interpolation::Hermite);
+    EnvelopeSettings envelope;
+    envelope.releaseSeconds = 0.02;
+    voices.setEnvelope(envelope);
+    RenderOptions options;
+    options.blockSize = 256;
+    options.tailSeconds = 1.0;
+    return renderOffline(voices, events, options);
+}
+
+bool identical(const RenderResult& a, const RenderResult& b) {
+    return a.frames == b.frames && a.samples.size() == b.samples.size() &&
+           std::memcmp(a.samples.data(), b.samples.data(), a.samples.size() * sizeof(float)) == 0;
+}
+
+float peak(const RenderResult& result) {
+    float peak = 0.0f;
+    for (float value : result.samples) {
+        peak = std::max(peak, std::fabs(value));
+    }
+    return peak;
+}
+
+double maxDeviation(const RenderResult& a, const RenderResult& b) {
+    if (a.samples.size() != b.samples.size()) {
+        return HUGE_VAL;
+    }
+    double deviation = 0.0;
+    for (size_t i = 0; i < a.samples.size(); ++i) {
+        deviation = std::max(deviation, std::fabs(static_cast<double>(a.samples[i]) - b.samples[i]));
+    }
+    return deviation;
+}
+
+} // namespace
+
+int main() {
+    const size_t frames = kSampleRate / 2;
+    const std::vector<float> sample = makeSample(frames);
+    const SampleBank bank = SampleBank::fromSample(sample.data(), frames, 2, kSampleRate, 60, frames / 4, frames);
+    const std::vector<NoteEvent> dense = chords();
+    const std::vector<NoteEvent> single = melody();
+
+    const RenderResult serial = render(bank, dense, 1);
+    const RenderResult serialMelody = render(bank, single, 1);
+    if (peak(serial) == 0.0f || peak(serialMelody) == 0.0f) {
+        fail("ingen lyd", 1);
+    }
+    if (!identical(serial, render(bank, dense, 1))) {
+        fail("gentaget rendering afviger", 1);
+    }
+
+    RenderResult reference;
+    for (int threads : kThreadCounts) {
+        const RenderResult first = render(bank, dense, threads);
+        for (int run = 1; run < kRuns; ++run) {
+            if (!identical(first, render(bank, dense, threads))) {
+                fail("gentaget rendering afviger", threads);
+            }
+        }
+        if (threads == kThreadCounts[0]) {
+            reference = first;
+        } else if (!identical(first, reference)) {
+            fail("afviger fra 2 tråde", threads);
+        }
+        if (maxDeviation(first, serial) > kMaxSerialDeviation) {
+            fail("afviger mere end afrunding fra 1 tråd", threads);
+        }
+        if (!identical(render(bank, single, threads), serialMelody)) {
+            fail("én stemme ad gangen afviger fra 1 tråd", threads);
+        }
+    }
+
+    if (failures > 0) {
+        return 1;
+    }
+    std::printf("OK: %zu frames, bit-identisk for 2-4 tråde\n", serial.frames);
+    return 0;
+}